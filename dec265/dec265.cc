@@ -26,6 +26,7 @@
 #endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits>
 #include <getopt.h>
 #ifdef HAVE_MALLOC_H
@@ -69,6 +70,25 @@ int highestTID = 100;
 int verbosity=0;
 int disable_deblocking=0;
 int disable_sao=0;
+int decoupled_recon=0;
+int irap_only=0;
+int low_latency=0;
+int release_metadata=0;
+int tiled_references=0;
+int no_huge_pages=0;
+int probe=0;
+int parse_only=0;
+const char* ctb_statistics_filename=NULL;
+const char* trace_filename=NULL;
+int numa_node=-1;
+int roi[4] = { 0,0,0,0 };
+int worker_cpus[1024];
+int num_worker_cpus=0;
+int seek_target=-1;
+const char* index_filename=NULL;
+enum de265_output_format output_format=de265_output_format_I420;
+bool output_format_given=false; // otherwise, high bit-depth streams are written with 16 bit samples
+enum de265_color_matrix output_matrix=de265_color_matrix_BT601;
 
 static struct option long_options[] = {
   {"quiet",      no_argument,       0, 'q' },
@@ -88,6 +108,23 @@ static struct option long_options[] = {
   {"verbose",    no_argument,       0, 'v' },
   {"disable-deblocking", no_argument, &disable_deblocking, 1 },
   {"disable-sao",        no_argument, &disable_sao, 1 },
+  {"decoupled-recon",    no_argument, &decoupled_recon, 1 },
+  {"irap-only",          no_argument, &irap_only, 1 },
+  {"low-latency",        no_argument, &low_latency, 1 },
+  {"release-metadata",   no_argument, &release_metadata, 1 },
+  {"tiled-references",   no_argument, &tiled_references, 1 },
+  {"no-huge-pages",      no_argument, &no_huge_pages, 1 },
+  {"probe",              no_argument, &probe, 1 },
+  {"parse-only",         no_argument, &parse_only, 1 },
+  {"ctb-statistics",     required_argument, 0, 'Q' },
+  {"trace",              required_argument, 0, 'X' },
+  {"numa-node",          required_argument, 0, 'N' },
+  {"cpus",               required_argument, 0, 'C' },
+  {"roi",                required_argument, 0, 'R' },
+  {"seek",               required_argument, 0, 'S' },
+  {"index",              required_argument, 0, 'I' },
+  {"output-format",      required_argument, 0, 'F' },
+  {"bt709",              no_argument,       0, '7' },
   {0,         0,                 0,  0 }
 };
 
@@ -100,21 +137,112 @@ static void write_picture(const de265_image* img)
 
   
 
-  for (int c=0;c<3;c++) {
-    int stride;
-    const uint8_t* p = de265_get_image_plane(img, c, &stride);
-    int width = de265_get_image_width(img,c);
+  // write the whole frame at once if the library can convert it for us
 
-    for (int y=0;y<de265_get_image_height(img,c);y++) {
-      fwrite(p + y*stride, width, 1, fh);
+  int size = 0;
+  if (output_format_given || de265_get_bits_per_pixel(img,0) <= 8) {
+    size = de265_get_converted_image_size(img, output_format, 0);
+  }
+
+  if (size>0) {
+    static uint8_t* buffer = NULL;
+    static int buffer_size = 0;
+
+    if (size > buffer_size) {
+      free(buffer);
+      buffer = (uint8_t*)malloc(size);
+      buffer_size = size;
     }
+
+    de265_convert_image(img, output_format, output_matrix, buffer, 0);
+    fwrite(buffer, size, 1, fh);
   }
-  
+  else {
+    for (int c=0;c<3;c++) {
+      int stride;
+      const uint8_t* p = de265_get_image_plane(img, c, &stride);
+      int width = de265_get_image_width(img,c) * ((de265_get_bits_per_pixel(img,c)+7)/8);
+
+      for (int y=0;y<de265_get_image_height(img,c);y++) {
+        fwrite(p + y*stride, width, 1, fh);
+      }
+    }
+  }
+
   fflush(fh);
 }
 
 
 
+static void show_finished_rows(void* userdata, const de265_image* img,
+                               int first_line, int end_line)
+{
+  fprintf(stderr,"lines %d-%d finished\n", first_line, end_line-1);
+}
+
+
+/* One line per CTB: POC, position, bits, average QP_Y (by CB count), CB counts of
+   intra, inter and skip CBs, number of inter PBs. */
+static void write_ctb_statistics(void* userdata, const de265_ctb_statistics* stat)
+{
+  int nCBs[3] = { 0,0,0 };
+  int sumQP = 0;
+  for (int i=0;i<stat->num_cbs;i++) {
+    nCBs[stat->cbs[i].pred_mode]++;
+    sumQP += stat->cbs[i].QP_Y;
+  }
+
+  // a single fprintf per CTB, so that the lines of parallel threads are not mixed
+
+  fprintf((FILE*)userdata, "%d %d %d %u %.1f %d %d %d %d\n",
+          stat->POC, stat->x, stat->y, stat->bits,
+          stat->num_cbs ? sumQP/(float)stat->num_cbs : 0.0f,
+          nCBs[0], nCBs[1], nCBs[2], stat->num_pbs);
+}
+
+
+#if HAVE_VIDEOGFX || HAVE_SDL
+/* Get the 8 bit planes of the image for display. High bit-depth images are converted.
+   Returns false if the image cannot be converted. */
+static bool get_display_planes(const struct de265_image* img,
+                               const uint8_t* planes[3], int strides[3])
+{
+  if (de265_get_bits_per_pixel(img,0) <= 8) {
+    for (int c=0;c<3;c++) {
+      planes[c] = de265_get_image_plane(img,c,&strides[c]);
+    }
+    return true;
+  }
+
+  static uint8_t* buffer = NULL;
+  static int buffer_size = 0;
+
+  int size = de265_get_converted_image_size(img, de265_output_format_I420, 0);
+  if (size==0) {
+    return false;
+  }
+
+  if (size > buffer_size) {
+    free(buffer);
+    buffer = (uint8_t*)malloc(size);
+    buffer_size = size;
+  }
+
+  de265_convert_image(img, de265_output_format_I420, de265_color_matrix_BT601, buffer, 0);
+
+  int w = de265_get_image_width(img,0);
+  int h = de265_get_image_height(img,0);
+
+  planes[0] = buffer;
+  planes[1] = buffer + w*h;
+  planes[2] = planes[1] + (w/2)*de265_get_image_height(img,1);
+  strides[0] = w;
+  strides[1] = strides[2] = w/2;
+  return true;
+}
+#endif
+
+
 #if HAVE_VIDEOGFX
 void display_image(const struct de265_image* img)
 {
@@ -139,11 +267,16 @@ void display_image(const struct de265_image* img)
   Image<Pixel> visu;
   visu.Create(width, height, Colorspace_YUV, Chroma_420);
 
+  const uint8_t* planes[3];
+  int strides[3];
+  if (!get_display_planes(img, planes, strides)) {
+    return;
+  }
+
   for (int ch=0;ch<3;ch++) {
-    const uint8_t* data;
-    int stride;
+    const uint8_t* data = planes[ch];
+    int stride = strides[ch];
 
-    data   = de265_get_image_plane(img,ch,&stride);
     width  = de265_get_image_width(img,ch);
     height = de265_get_image_height(img,ch);
 
@@ -171,12 +304,13 @@ bool display_sdl(const struct de265_image* img)
     sdlWin.init(width,height);
   }
 
-  int stride,chroma_stride;
-  const uint8_t* y = de265_get_image_plane(img,0,&stride);
-  const uint8_t* cb =de265_get_image_plane(img,1,&chroma_stride);
-  const uint8_t* cr =de265_get_image_plane(img,2,NULL);
+  const uint8_t* planes[3];
+  int strides[3];
+  if (!get_display_planes(img, planes, strides)) {
+    return sdlWin.doQuit();
+  }
 
-  sdlWin.display(y,cb,cr, stride, chroma_stride);
+  sdlWin.display(planes[0],planes[1],planes[2], strides[0], strides[1]);
 
   return sdlWin.doQuit();
 }
@@ -299,6 +433,85 @@ void (*volatile __malloc_initialize_hook)(void) = init_my_hooks;
 #endif
 #endif
 
+// parse CPU list, e.g. "0-7,16-23"
+static void parse_cpu_list(const char* list)
+{
+  num_worker_cpus=0;
+
+  while (*list) {
+    char* end;
+    int first = strtol(list,&end,10);
+    int last  = first;
+    if (end==list) break;
+
+    if (*end=='-') {
+      list = end+1;
+      last = strtol(list,&end,10);
+    }
+
+    for (int i=first; i<=last && num_worker_cpus<1024; i++) {
+      worker_cpus[num_worker_cpus++] = i;
+    }
+
+    list = end;
+    if (*list==',') list++;
+    else break;
+  }
+}
+
+
+// print the stream structure without decoding any slice data
+static int probe_stream(const char* filename)
+{
+  FILE* fh = fopen(filename, "rb");
+  if (fh==NULL) {
+    fprintf(stderr,"cannot open file %s!\n", filename);
+    return 10;
+  }
+
+  de265_stream_index* index = de265_new_stream_index();
+
+  const int probeBufferSize = 1<<20;
+  uint8_t* buf = new uint8_t[probeBufferSize];
+  int n;
+  while ((n = fread(buf,1,probeBufferSize,fh)) > 0) {
+    de265_stream_index_push_data(index, buf, n);
+  }
+  de265_stream_index_flush_data(index);
+
+  delete[] buf;
+  fclose(fh);
+
+  static const char* chroma_names[4] = { "4:0:0","4:2:0","4:2:2","4:4:4" };
+
+  for (int s=0;s<de265_stream_index_get_number_of_sequences(index);s++) {
+    const de265_sequence_info* seq = de265_stream_index_get_sequence(index, s);
+
+    printf("sequence %d: %dx%d %s %d/%d bit, profile %d, %s tier, level %d.%d, %d pictures\n",
+           s, seq->width, seq->height, chroma_names[seq->chroma_format & 3],
+           seq->bit_depth_luma, seq->bit_depth_chroma, seq->profile_idc,
+           seq->tier_flag ? "high" : "main", seq->level_idc/30, seq->level_idc%30/3,
+           seq->num_pictures);
+
+    for (int p=seq->first_picture; p<seq->first_picture+seq->num_pictures; p++) {
+      const de265_picture_info* pic = de265_stream_index_get_picture(index, p);
+
+      printf("  picture %d: offset %lld size %lld POC %d NAL %d TID %d slices %d %s%s%s%s\n",
+             p, (long long)pic->byte_offset, (long long)pic->size, pic->POC,
+             pic->nal_unit_type, pic->temporal_id, pic->num_slice_segments,
+             (pic->slice_types & 4) ? "I" : "",
+             (pic->slice_types & 2) ? "P" : "",
+             (pic->slice_types & 1) ? "B" : "",
+             pic->pic_output_flag ? "" : " (not output)");
+    }
+  }
+
+  de265_free_stream_index(index);
+
+  return 0;
+}
+
+
 int main(int argc, char** argv)
 {
   while (1) {
@@ -327,6 +540,26 @@ int main(int argc, char** argv)
     case 'B': write_bytestream=true; bytestream_filename=optarg; break;
     case 'T': highestTID=atoi(optarg); break;
     case 'v': verbosity++; break;
+    case 'N': numa_node=atoi(optarg); break;
+    case 'C': parse_cpu_list(optarg); break;
+    case 'R':
+      if (sscanf(optarg,"%d,%d,%d,%d",&roi[0],&roi[1],&roi[2],&roi[3])!=4) show_help=true;
+      break;
+    case 'S': seek_target=atoi(optarg); break;
+    case 'I': index_filename=optarg; break;
+    case 'Q': ctb_statistics_filename=optarg; break;
+    case 'X': trace_filename=optarg; break;
+    case 'F':
+      output_format_given=true;
+      if      (strcmp(optarg,"i420")==0) output_format=de265_output_format_I420;
+      else if (strcmp(optarg,"nv12")==0) output_format=de265_output_format_NV12;
+      else if (strcmp(optarg,"rgb" )==0) output_format=de265_output_format_RGB24;
+      else if (strcmp(optarg,"rgba")==0) output_format=de265_output_format_RGBA32;
+      else if (strcmp(optarg,"yuv420p10")==0) output_format=de265_output_format_YUV420P10;
+      else if (strcmp(optarg,"p010")==0) output_format=de265_output_format_P010;
+      else show_help=true;
+      break;
+    case '7': output_matrix=de265_color_matrix_BT709; break;
     }
   }
 
@@ -353,12 +586,35 @@ int main(int argc, char** argv)
     fprintf(stderr,"  -T, --highest-TID select highest temporal sublayer to decode\n");
     fprintf(stderr,"      --disable-deblocking   disable deblocking filter\n");
     fprintf(stderr,"      --disable-sao          disable sample-adaptive offset filter\n");
+    fprintf(stderr,"      --decoupled-recon      reconstruct in a separate thread, pipelined with parsing\n");
+    fprintf(stderr,"      --irap-only            decode only IRAP pictures (key frames)\n");
+    fprintf(stderr,"      --low-latency          filter while decoding, output pictures without reordering delay\n");
+    fprintf(stderr,"      --release-metadata     free per-block decoding data after filtering (less memory)\n");
+    fprintf(stderr,"      --tiled-references     block-tiled copy of reference pictures for faster MC\n");
+    fprintf(stderr,"      --no-huge-pages        do not use transparent huge pages for pictures\n");
+    fprintf(stderr,"      --numa-node N          run workers and allocate pictures on NUMA node N\n");
+    fprintf(stderr,"      --cpus LIST            pin worker threads to CPUs (e.g. 0-7,16-23)\n");
+    fprintf(stderr,"      --roi X,Y,W,H          only decode tiles that intersect this region\n");
+    fprintf(stderr,"      --probe                only list sequences and pictures, without decoding\n");
+    fprintf(stderr,"      --parse-only           parse the syntax only, without reconstruction\n");
+    fprintf(stderr,"      --ctb-statistics FILE  write bits, QP and block modes of each CTB to FILE\n");
+    fprintf(stderr,"      --trace FILE           write a timeline of the worker thread tasks to FILE\n");
+    fprintf(stderr,"                             (Chrome trace event JSON, for chrome://tracing or Perfetto)\n");
+    fprintf(stderr,"      --seek POC             start output at this (stream) POC\n");
+    fprintf(stderr,"      --index FILE           IRAP index for seeking, built and saved if FILE does not exist\n");
+    fprintf(stderr,"      --output-format FMT    write output as i420 (default), nv12, rgb, rgba,\n");
+    fprintf(stderr,"                             yuv420p10 or p010 (default for >8 bit: 16 bit samples)\n");
+    fprintf(stderr,"      --bt709                use BT.709 instead of BT.601 for RGB output\n");
     fprintf(stderr,"  -h, --help        show help\n");
 
     exit(show_help ? 0 : 5);
   }
 
 
+  if (probe) {
+    return probe_stream(argv[optind]);
+  }
+
   de265_error err =DE265_OK;
 
   de265_decoder_context* ctx = de265_new_decoder();
@@ -368,6 +624,29 @@ int main(int argc, char** argv)
 
   de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_DISABLE_DEBLOCKING, disable_deblocking);
   de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_DISABLE_SAO, disable_sao);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_DECOUPLED_RECONSTRUCTION, decoupled_recon);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_DECODE_IRAP_ONLY, irap_only);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_LOW_LATENCY, low_latency);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_RELEASE_METADATA, release_metadata);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_TILED_REFERENCES, tiled_references);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_HUGE_PAGES, !no_huge_pages);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_PARSE_ONLY, parse_only);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_TRACE_TASKS, trace_filename!=NULL);
+
+  FILE* ctb_statistics_fh = NULL;
+  if (ctb_statistics_filename) {
+    ctb_statistics_fh = fopen(ctb_statistics_filename, "w");
+    if (ctb_statistics_fh==NULL) {
+      fprintf(stderr,"cannot write file %s!\n", ctb_statistics_filename);
+      exit(10);
+    }
+
+    de265_set_ctb_statistics_callback(ctx, write_ctb_statistics, ctb_statistics_fh);
+  }
+
+  if (low_latency && verbosity>0) {
+    de265_set_row_output_callback(ctx, show_finished_rows, NULL);
+  }
 
   if (dump_headers) {
     de265_set_parameter_int(ctx, DE265_DECODER_PARAM_DUMP_SPS_HEADERS, 1);
@@ -387,6 +666,10 @@ int main(int argc, char** argv)
   de265_set_verbosity(verbosity);
 
 
+  de265_set_parameter_int(ctx, DE265_DECODER_PARAM_NUMA_NODE, numa_node);
+  de265_set_worker_thread_affinity(ctx, worker_cpus, num_worker_cpus);
+  de265_set_region_of_interest(ctx, roi[0],roi[1],roi[2],roi[3]);
+
   if (argc>=3) {
     if (nThreads>0) {
       err = de265_start_worker_threads(ctx, nThreads);
@@ -403,6 +686,44 @@ int main(int argc, char** argv)
     exit(10);
   }
 
+  int pos=0;
+
+  if (!nal_input && (seek_target>=0 || index_filename)) {
+    de265_stream_index* index = de265_new_stream_index();
+
+    if (index_filename==NULL ||
+        de265_stream_index_load(index, index_filename) != DE265_OK) {
+      // scan the whole file for IRAP pictures
+
+      uint8_t buf[BUFFER_SIZE];
+      int n;
+      while ((n = fread(buf,1,BUFFER_SIZE,fh)) > 0) {
+        de265_stream_index_push_data(index, buf, n);
+      }
+      de265_stream_index_flush_data(index);
+
+      fseek(fh, 0, SEEK_SET);
+
+      if (index_filename) {
+        de265_stream_index_save(index, index_filename);
+      }
+    }
+
+    if (seek_target>=0) {
+      int entryIdx = de265_stream_index_find_entry(index, seek_target);
+      if (entryIdx>=0) {
+        const de265_index_entry* entry = de265_stream_index_get_entry(index, entryIdx);
+
+        de265_seek(ctx, index, entryIdx, seek_target);
+
+        fseek(fh, entry->byte_offset, SEEK_SET);
+        pos = entry->byte_offset;
+      }
+    }
+
+    de265_free_stream_index(index);
+  }
+
   FILE* bytestream_fh = NULL;
 
   if (write_bytestream) {
@@ -414,8 +735,6 @@ int main(int argc, char** argv)
   struct timeval tv_start;
   gettimeofday(&tv_start, NULL);
 
-  int pos=0;
-
   while (!stop)
     {
       //tid = (framecnt/1000) & 1;
@@ -453,16 +772,6 @@ int main(int argc, char** argv)
         }
 
         pos+=n;
-
-        if (0) { // fake skipping
-          if (pos>1000000) {
-            printf("RESET\n");
-            de265_reset(ctx);
-            pos=0;
-
-            fseek(fh,-200000,SEEK_CUR);
-          }
-        }
       }
 
       // printf("pending data: %d\n", de265_get_number_of_input_bytes_pending(ctx));
@@ -518,8 +827,18 @@ int main(int argc, char** argv)
     fclose(bytestream_fh);
   }
 
+  if (trace_filename) {
+    if (de265_write_task_trace(ctx, trace_filename) != DE265_OK) {
+      fprintf(stderr,"cannot write file %s!\n", trace_filename);
+    }
+  }
+
   de265_free_decoder(ctx);
 
+  if (ctb_statistics_fh) {
+    fclose(ctb_statistics_fh);
+  }
+
   struct timeval tv_end;
   gettimeofday(&tv_end, NULL);
 
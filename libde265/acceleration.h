@@ -60,6 +60,42 @@ struct acceleration_functions
                                 uint8_t *src, ptrdiff_t srcstride, int width, int height,
                                 int16_t* mcbuffer);
 
+  // high bit-depth variants (16 bit samples)
+
+  void (*put_weighted_pred_avg_16)(uint16_t *_dst, ptrdiff_t dststride,
+                                   int16_t *src1, int16_t *src2, ptrdiff_t srcstride,
+                                   int width, int height, int bit_depth);
+
+  void (*put_unweighted_pred_16)(uint16_t *_dst, ptrdiff_t dststride,
+                                 int16_t *src, ptrdiff_t srcstride,
+                                 int width, int height, int bit_depth);
+
+  void (*put_weighted_pred_16)(uint16_t *_dst, ptrdiff_t dststride,
+                               int16_t *src, ptrdiff_t srcstride,
+                               int width, int height,
+                               int w,int o,int log2WD, int bit_depth);
+  void (*put_weighted_bipred_16)(uint16_t *_dst, ptrdiff_t dststride,
+                                 int16_t *src1, int16_t *src2, ptrdiff_t srcstride,
+                                 int width, int height,
+                                 int w1,int o1, int w2,int o2, int log2WD, int bit_depth);
+
+  void (*put_hevc_epel_16)(int16_t *dst, ptrdiff_t dststride,
+                           uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                           int mx, int my, int16_t* mcbuffer, int bit_depth);
+  void (*put_hevc_epel_h_16)(int16_t *dst, ptrdiff_t dststride,
+                             uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                             int mx, int my, int16_t* mcbuffer, int bit_depth);
+  void (*put_hevc_epel_v_16)(int16_t *dst, ptrdiff_t dststride,
+                             uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                             int mx, int my, int16_t* mcbuffer, int bit_depth);
+  void (*put_hevc_epel_hv_16)(int16_t *dst, ptrdiff_t dststride,
+                              uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                              int mx, int my, int16_t* mcbuffer, int bit_depth);
+
+  void (*put_hevc_qpel_16[4][4])(int16_t *dst, ptrdiff_t dststride,
+                                 uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                                 int16_t* mcbuffer, int bit_depth);
+
   void (*transform_skip_8)(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride); // no transform
   void (*transform_bypass_8)(uint8_t *dst, int16_t *coeffs, int nT, ptrdiff_t stride);
   void (*transform_4x4_luma_add_8)(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride); // iDST
@@ -68,6 +104,29 @@ struct acceleration_functions
   void (*transform_8x8_add_8)(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride); // iDCT
   void (*transform_16x16_add_8)(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride); // iDCT
   void (*transform_32x32_add_8)(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride); // iDCT
+
+  // high bit-depth variants (16 bit samples, clipped to bit_depth)
+  void (*transform_skip_16)(uint16_t *_dst, int16_t *coeffs, ptrdiff_t _stride, int bit_depth);
+  void (*transform_bypass_16)(uint16_t *dst, int16_t *coeffs, int nT, ptrdiff_t stride,
+                              int bit_depth);
+  void (*transform_4x4_luma_add_16)(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                    int bit_depth);
+
+  void (*transform_4x4_add_16)(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+  void (*transform_8x8_add_16)(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+  void (*transform_16x16_add_16)(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+  void (*transform_32x32_add_16)(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+
+  // dequantization of n coefficients (in place, n multiple of 8, 16-byte aligned)
+  // c = Clip16( (c*fact + (1<<(shift-1))) >> shift )  or  Clip16( c*fact << -shift ) for shift<=0
+  void (*dequant_flat)(int16_t *coeffs, int n, int fact, int shift);
+  // the same with fact multiplied by the scaling factor m[i] of each coefficient
+  void (*dequant_scaled)(int16_t *coeffs, const uint8_t *m, int n, int fact, int shift);
+
+  // output conversion (one row)
+  void (*interleave_chroma_8)(uint8_t* dst, const uint8_t* u, const uint8_t* v, int width); // NV12
+  void (*yuv420_to_rgb_8)(uint8_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                          int width, const int16_t* coeffs, int bytes_per_pixel);
 };
 
 #endif
@@ -0,0 +1,388 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "convert.h"
+#include "image.h"
+#include "decctx.h"
+#include "fallback.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+
+// frames with at least this number of pixels are converted in parallel
+#define MIN_PIXELS_FOR_THREADED_CONVERSION (1280*720)
+
+// height of the bands handed to the worker threads (luma rows, must be even)
+#define CONVERSION_BAND_HEIGHT 64
+
+
+/* YUV -> RGB coefficients (limited range) in 6-bit fixed point:
+   Y factor, V->R, U->G, V->G, U->B
+ */
+static const int16_t rgb_coefficients[2][5] = {
+  { 75, 102, 25, 52, 129 },  // BT.601
+  { 75, 115, 14, 34, 135 }   // BT.709
+};
+
+
+static int get_bytes_per_pixel(enum de265_output_format format)
+{
+  switch (format) {
+  case de265_output_format_RGB24:  return 3;
+  case de265_output_format_RGBA32: return 4;
+  case de265_output_format_YUV420P10:
+  case de265_output_format_P010:   return 2;
+  default: return 1;
+  }
+}
+
+
+static bool is_supported(const de265_image* img, enum de265_output_format format)
+{
+  if (img->get_chroma_format() != de265_chroma_420 ||
+      img->get_bit_depth(0) > 16 || img->get_bit_depth(1) > 16) {
+    return false;
+  }
+
+  switch (format) {
+  case de265_output_format_RGB24:
+  case de265_output_format_RGBA32:
+    return true;
+
+  case de265_output_format_I420:
+  case de265_output_format_NV12:
+  case de265_output_format_YUV420P10:
+  case de265_output_format_P010:
+    // the chroma planes are laid out for an even luma size
+    return (img->width_confwin & 1)==0 && (img->height_confwin & 1)==0;
+
+  default:
+    return false;
+  }
+}
+
+
+int get_converted_image_size(const de265_image* img, enum de265_output_format format, int stride)
+{
+  if (!is_supported(img, format)) {
+    return 0;
+  }
+
+  int w = img->width_confwin;
+  int h = img->height_confwin;
+
+  if (stride==0) {
+    stride = w*get_bytes_per_pixel(format);
+  }
+
+  switch (format) {
+  case de265_output_format_I420:
+  case de265_output_format_YUV420P10:
+    return stride*h + 2*(stride/2)*img->chroma_height_confwin;
+  case de265_output_format_NV12:
+  case de265_output_format_P010:
+    return stride*h + stride*img->chroma_height_confwin;
+  default:
+    return stride*h;
+  }
+}
+
+
+struct conversion
+{
+  const de265_image* img;
+  const acceleration_functions* accel;
+  enum de265_output_format format;
+  const int16_t* coeffs;
+
+  uint8_t* dst;
+  int stride;
+};
+
+
+/* Get row y of plane cIdx with 8 bit samples. For high bit-depth images, the
+   samples are rounded into 'tmp', which must hold a full row.
+ */
+static const uint8_t* get_row_8(const de265_image* img, int cIdx, int y, uint8_t* tmp, int w)
+{
+  const int stride = img->get_image_stride(cIdx) * img->get_bytes_per_pixel(cIdx);
+
+  if (!img->high_bit_depth(cIdx)) {
+    return img->pixels_confwin[cIdx] + y*stride;
+  }
+
+  const uint16_t* src = (const uint16_t*)(img->pixels_confwin[cIdx] + y*stride);
+  const int shift = img->get_bit_depth(cIdx) - 8;
+  const int rnd = 1<<(shift-1);
+
+  for (int x=0;x<w;x++) {
+    tmp[x] = libde265_min(255, (src[x] + rnd) >> shift);
+  }
+
+  return tmp;
+}
+
+
+// write w samples of row y of plane cIdx as 16 bit little-endian values, shifted to 'bit_depth' bits
+
+static void write_row_16(const de265_image* img, int cIdx, int y, int w, int bit_depth,
+                         uint8_t* dst, int dst_step)
+{
+  const int stride = img->get_image_stride(cIdx) * img->get_bytes_per_pixel(cIdx);
+  const int shift = bit_depth - img->get_bit_depth(cIdx);
+  const int maxValue = (1<<bit_depth)-1;
+
+  const uint8_t*  src8  = img->pixels_confwin[cIdx] + y*stride;
+  const uint16_t* src16 = (const uint16_t*)src8;
+  const bool high_bit_depth = img->high_bit_depth(cIdx);
+
+  for (int x=0;x<w;x++) {
+    int v = (high_bit_depth ? src16[x] : src8[x]);
+
+    if (shift>=0) {
+      v <<= shift;
+    }
+    else {
+      v = libde265_min(maxValue, (v + (1<<(-shift-1))) >> -shift);
+    }
+
+    dst[x*dst_step  ] = v & 0xFF;
+    dst[x*dst_step+1] = v >> 8;
+  }
+}
+
+
+// convert luma rows [y0;y1), y0 is even (y1 too, except for RGB output of odd-height images)
+
+static void convert_rows(const conversion& c, int y0, int y1)
+{
+  const de265_image* img = c.img;
+
+  const int w  = img->width_confwin;
+  const int h  = img->height_confwin;
+  const int cw = img->chroma_width_confwin;
+  const int ch = img->chroma_height_confwin;
+
+  // row buffers for high bit-depth input to 8 bit output
+  std::vector<uint8_t> tmp;
+  uint8_t* tmpY = NULL;
+  uint8_t* tmpU = NULL;
+  uint8_t* tmpV = NULL;
+
+  if (img->high_bit_depth(0) || img->high_bit_depth(1)) {
+    tmp.resize(3*w);
+    tmpY = &tmp[0];
+    tmpU = tmpY + w;
+    tmpV = tmpU + w;
+  }
+
+  switch (c.format) {
+  case de265_output_format_I420:
+  case de265_output_format_NV12:
+    for (int y=y0;y<y1;y++) {
+      memcpy(c.dst + y*c.stride, get_row_8(img,0,y,tmpY,w), w);
+    }
+
+    for (int y=y0/2; y<y1/2 && y<ch; y++) {
+      const uint8_t* srcU = get_row_8(img,1,y,tmpU,cw);
+      const uint8_t* srcV = get_row_8(img,2,y,tmpV,cw);
+
+      if (c.format == de265_output_format_I420) {
+        const int dstCStride = c.stride/2;
+        uint8_t* dstU = c.dst + h*c.stride;
+        uint8_t* dstV = dstU + ch*dstCStride;
+
+        memcpy(dstU + y*dstCStride, srcU, cw);
+        memcpy(dstV + y*dstCStride, srcV, cw);
+      }
+      else {
+        uint8_t* dstUV = c.dst + h*c.stride;
+
+        c.accel->interleave_chroma_8(dstUV + y*c.stride, srcU, srcV, cw);
+      }
+    }
+    break;
+
+  case de265_output_format_YUV420P10:
+    for (int y=y0;y<y1;y++) {
+      write_row_16(img,0,y,w,10, c.dst + y*c.stride, 2);
+    }
+
+    for (int y=y0/2; y<y1/2 && y<ch; y++) {
+      const int dstCStride = c.stride/2;
+      uint8_t* dstU = c.dst + h*c.stride;
+      uint8_t* dstV = dstU + ch*dstCStride;
+
+      write_row_16(img,1,y,cw,10, dstU + y*dstCStride, 2);
+      write_row_16(img,2,y,cw,10, dstV + y*dstCStride, 2);
+    }
+    break;
+
+  case de265_output_format_P010:
+    // samples are stored in the most significant bits
+    for (int y=y0;y<y1;y++) {
+      write_row_16(img,0,y,w,16, c.dst + y*c.stride, 2);
+    }
+
+    for (int y=y0/2; y<y1/2 && y<ch; y++) {
+      uint8_t* dstUV = c.dst + h*c.stride + y*c.stride;
+
+      write_row_16(img,1,y,cw,16, dstUV,   4);
+      write_row_16(img,2,y,cw,16, dstUV+2, 4);
+    }
+    break;
+
+  default:
+    for (int y=y0;y<y1;y++) {
+      c.accel->yuv420_to_rgb_8(c.dst + y*c.stride,
+                               get_row_8(img,0,y,  tmpY,w),
+                               get_row_8(img,1,y/2,tmpU,cw),
+                               get_row_8(img,2,y/2,tmpV,cw),
+                               w, c.coeffs, get_bytes_per_pixel(c.format));
+    }
+    break;
+  }
+}
+
+
+class thread_task_convert : public thread_task
+{
+public:
+  const conversion* conv;
+  int y0, y1;
+
+  de265_mutex* mutex;
+  de265_cond*  finished_cond;
+  int*         num_pending;
+
+  virtual void work();
+  virtual void describe(task_trace_event* ev) const {
+    ev->name  = "convert";
+    ev->index = y0;
+    ev->POC   = INT_MIN;
+  }
+};
+
+
+void thread_task_convert::work()
+{
+  state = Running;
+
+  convert_rows(*conv, y0,y1);
+
+  de265_mutex_lock(mutex);
+  state = Finished;
+  (*num_pending)--;
+  de265_cond_signal(finished_cond);
+  de265_mutex_unlock(mutex);
+}
+
+
+de265_error convert_image(const de265_image* img, enum de265_output_format format,
+                          enum de265_color_matrix matrix, uint8_t* dst, int stride)
+{
+  if (!is_supported(img, format) ||
+      (matrix != de265_color_matrix_BT601 && matrix != de265_color_matrix_BT709)) {
+    return DE265_ERROR_UNSUPPORTED_OUTPUT_FORMAT;
+  }
+
+  const int w = img->width_confwin;
+  const int h = img->height_confwin;
+
+  if (stride==0) {
+    stride = w*get_bytes_per_pixel(format);
+  }
+
+  if (stride < w*get_bytes_per_pixel(format)) {
+    return DE265_ERROR_CODED_PARAMETER_OUT_OF_RANGE;
+  }
+
+
+  static acceleration_functions fallback_functions;
+  const acceleration_functions* accel;
+
+  if (img->decctx) {
+    accel = &img->decctx->acceleration;
+  }
+  else {
+    init_acceleration_functions_fallback(&fallback_functions);
+    accel = &fallback_functions;
+  }
+
+  conversion conv;
+  conv.img    = img;
+  conv.accel  = accel;
+  conv.format = format;
+  conv.coeffs = rgb_coefficients[matrix];
+  conv.dst    = dst;
+  conv.stride = stride;
+
+
+  // small frames or no worker threads -> convert directly
+
+  thread_pool* pool = (img->decctx ? &img->decctx->thread_pool : NULL);
+
+  if (pool==NULL || pool->num_threads==0 ||
+      w*h < MIN_PIXELS_FOR_THREADED_CONVERSION) {
+    convert_rows(conv, 0,h);
+    return DE265_OK;
+  }
+
+
+  // Split the image into bands. The first band is converted in the calling thread.
+
+  const int nBands = (h + CONVERSION_BAND_HEIGHT-1) / CONVERSION_BAND_HEIGHT;
+
+  de265_mutex mutex;
+  de265_cond  finished_cond;
+  de265_mutex_init(&mutex);
+  de265_cond_init(&finished_cond);
+
+  int num_pending = nBands-1;
+
+  std::vector<thread_task_convert> tasks(nBands-1);
+
+  for (int i=1;i<nBands;i++) {
+    thread_task_convert& task = tasks[i-1];
+    task.conv = &conv;
+    task.y0 = i*CONVERSION_BAND_HEIGHT;
+    task.y1 = std::min(h, (i+1)*CONVERSION_BAND_HEIGHT);
+    task.mutex = &mutex;
+    task.finished_cond = &finished_cond;
+    task.num_pending = &num_pending;
+
+    add_task(pool, &task);
+  }
+
+  convert_rows(conv, 0, std::min(h, CONVERSION_BAND_HEIGHT));
+
+  de265_mutex_lock(&mutex);
+  while (num_pending>0) {
+    de265_cond_wait(&finished_cond, &mutex);
+  }
+  de265_mutex_unlock(&mutex);
+
+  de265_cond_destroy(&finished_cond);
+  de265_mutex_destroy(&mutex);
+
+  return DE265_OK;
+}
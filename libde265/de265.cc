@@ -24,9 +24,10 @@
 #include "de265.h"
 #include "decctx.h"
 #include "util.h"
-#include "scan.h"
 #include "image.h"
 #include "sei.h"
+#include "stream-index.h"
+#include "convert.h"
 
 #include <assert.h>
 #include <string.h>
@@ -74,6 +75,8 @@ LIBDE265_API const char* de265_get_error_text(de265_error err)
     return "no more input data, decoder stalled";
   case DE265_ERROR_CANNOT_PROCESS_SEI:
     return "SEI data cannot be processed";
+  case DE265_ERROR_UNSUPPORTED_OUTPUT_FORMAT:
+    return "image cannot be converted into this output format";
 
   case DE265_WARNING_NO_WPP_CANNOT_USE_MULTITHREADING:
     return "Cannot run decoder multi-threaded because stream does not support WPP";
@@ -152,13 +155,9 @@ LIBDE265_API de265_error de265_init()
 
 
   // do initializations
+  // (the scan order and CABAC context tables are constant data and need no initialization)
 
-  init_scan_orders();
-
-  if (!alloc_and_init_significant_coeff_ctxIdx_lookupTable()) {
-    de265_sync_sub_and_fetch(&de265_init_count,1);
-    return DE265_ERROR_LIBRARY_INITIALIZATION_FAILED;
-  }
+  init_sei_crc_tables();
 
   return DE265_OK;
 }
@@ -171,10 +170,6 @@ LIBDE265_API de265_error de265_free()
     return DE265_ERROR_LIBRARY_NOT_INITIALIZED;
   }
 
-  if (cnt==0) {
-    free_significant_coeff_ctxIdx_lookupTable();
-  }
-
   return DE265_OK;
 }
 
@@ -212,10 +207,6 @@ LIBDE265_API de265_error de265_start_worker_threads(de265_decoder_context* de265
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
 
-  if (number_of_threads > MAX_THREADS) {
-    number_of_threads = MAX_THREADS;
-  }
-
   if (number_of_threads>0) {
     de265_error err = ctx->start_thread_pool(number_of_threads);
     if (de265_isOK(err)) {
@@ -229,6 +220,15 @@ LIBDE265_API de265_error de265_start_worker_threads(de265_decoder_context* de265
 }
 
 
+LIBDE265_API void de265_set_worker_thread_affinity(de265_decoder_context* de265ctx,
+                                                   const int* cpus, int num_cpus)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  ctx->param_worker_cpus.assign(cpus, cpus+num_cpus);
+}
+
+
 #ifndef LIBDE265_DISABLE_DEPRECATED
 LIBDE265_API de265_error de265_decode_data(de265_decoder_context* de265ctx,
                                            const void* data8, int len)
@@ -349,6 +349,142 @@ LIBDE265_API void de265_reset(de265_decoder_context* de265ctx)
 }
 
 
+LIBDE265_API de265_error de265_seek(de265_decoder_context* de265ctx,
+                                    const de265_stream_index* de265idx,
+                                    int entry_idx, int32_t target_stream_POC)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  const stream_index* idx = (const stream_index*)de265idx;
+
+  if (entry_idx<0 || entry_idx>=(int)idx->entries.size()) {
+    return DE265_ERROR_CODED_PARAMETER_OUT_OF_RANGE;
+  }
+
+  idx->seek(ctx, entry_idx, target_stream_POC);
+
+  return DE265_OK;
+}
+
+
+LIBDE265_API de265_stream_index* de265_new_stream_index(void)
+{
+  return (de265_stream_index*)new stream_index;
+}
+
+
+LIBDE265_API void de265_free_stream_index(de265_stream_index* de265idx)
+{
+  delete (stream_index*)de265idx;
+}
+
+
+LIBDE265_API void de265_stream_index_push_data(de265_stream_index* de265idx,
+                                               const void* data, int length)
+{
+  stream_index* idx = (stream_index*)de265idx;
+
+  idx->push_data((const unsigned char*)data, length);
+}
+
+
+LIBDE265_API void de265_stream_index_flush_data(de265_stream_index* de265idx)
+{
+  stream_index* idx = (stream_index*)de265idx;
+
+  idx->flush_data();
+}
+
+
+LIBDE265_API int de265_stream_index_get_number_of_entries(const de265_stream_index* de265idx)
+{
+  const stream_index* idx = (const stream_index*)de265idx;
+
+  return idx->entries.size();
+}
+
+
+LIBDE265_API const de265_index_entry* de265_stream_index_get_entry(const de265_stream_index* de265idx,
+                                                                   int n)
+{
+  const stream_index* idx = (const stream_index*)de265idx;
+
+  if (n<0 || n>=(int)idx->entries.size()) {
+    return NULL;
+  }
+
+  return &idx->entries[n];
+}
+
+
+LIBDE265_API int de265_stream_index_find_entry(const de265_stream_index* de265idx,
+                                               int32_t stream_POC)
+{
+  const stream_index* idx = (const stream_index*)de265idx;
+
+  return idx->find_entry(stream_POC);
+}
+
+
+LIBDE265_API int de265_stream_index_get_number_of_pictures(const de265_stream_index* de265idx)
+{
+  const stream_index* idx = (const stream_index*)de265idx;
+
+  return idx->pictures.size();
+}
+
+
+LIBDE265_API const de265_picture_info* de265_stream_index_get_picture(const de265_stream_index* de265idx,
+                                                                      int n)
+{
+  const stream_index* idx = (const stream_index*)de265idx;
+
+  if (n<0 || n>=(int)idx->pictures.size()) {
+    return NULL;
+  }
+
+  return &idx->pictures[n];
+}
+
+
+LIBDE265_API int de265_stream_index_get_number_of_sequences(const de265_stream_index* de265idx)
+{
+  const stream_index* idx = (const stream_index*)de265idx;
+
+  return idx->sequences.size();
+}
+
+
+LIBDE265_API const de265_sequence_info* de265_stream_index_get_sequence(const de265_stream_index* de265idx,
+                                                                        int n)
+{
+  const stream_index* idx = (const stream_index*)de265idx;
+
+  if (n<0 || n>=(int)idx->sequences.size()) {
+    return NULL;
+  }
+
+  return &idx->sequences[n];
+}
+
+
+LIBDE265_API de265_error de265_stream_index_save(const de265_stream_index* de265idx,
+                                                 const char* filename)
+{
+  const stream_index* idx = (const stream_index*)de265idx;
+
+  return idx->save(filename) ? DE265_OK : DE265_ERROR_NO_SUCH_FILE;
+}
+
+
+LIBDE265_API de265_error de265_stream_index_load(de265_stream_index* de265idx,
+                                                 const char* filename)
+{
+  stream_index* idx = (stream_index*)de265idx;
+
+  return idx->load(filename) ? DE265_OK : DE265_ERROR_NO_SUCH_FILE;
+}
+
+
 LIBDE265_API const struct de265_image* de265_get_next_picture(de265_decoder_context* de265ctx)
 {
   const struct de265_image* img = de265_peek_next_picture(de265ctx);
@@ -418,6 +554,32 @@ LIBDE265_API void de265_set_limit_TID(de265_decoder_context* de265ctx,int max_ti
   ctx->set_limit_TID(max_tid);
 }
 
+LIBDE265_API void de265_set_region_of_interest(de265_decoder_context* de265ctx,
+                                               int x,int y, int width,int height)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  ctx->param_roi_x = x;
+  ctx->param_roi_y = y;
+  ctx->param_roi_width  = width;
+  ctx->param_roi_height = height;
+}
+
+LIBDE265_API void de265_set_presentation_clock(de265_decoder_context* de265ctx,
+                                               de265_presentation_clock clock,
+                                               void* userdata,
+                                               de265_PTS pts_per_second)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->set_presentation_clock(clock, userdata, pts_per_second);
+}
+
+LIBDE265_API int  de265_get_number_of_late_pictures_dropped(de265_decoder_context* de265ctx)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  return ctx->get_number_of_late_pictures_dropped();
+}
+
 LIBDE265_API void de265_set_framerate_ratio(de265_decoder_context* de265ctx,int percent)
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
@@ -460,6 +622,42 @@ LIBDE265_API void de265_set_parameter_bool(de265_decoder_context* de265ctx, enum
       ctx->param_disable_sao = !!value;
       break;
 
+    case DE265_DECODER_PARAM_DECOUPLED_RECONSTRUCTION:
+      ctx->param_decoupled_reconstruction = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_DECODE_IRAP_ONLY:
+      ctx->param_decode_irap_only = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_LOW_LATENCY:
+      ctx->param_low_latency = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_RELEASE_METADATA:
+      ctx->param_release_metadata = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_TILED_REFERENCES:
+      ctx->param_tiled_references = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_HUGE_PAGES:
+      ctx->param_huge_pages = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_PARSE_ONLY:
+      ctx->param_parse_only = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_KEEP_MOTION_FIELD:
+      ctx->param_keep_motion_field = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_TRACE_TASKS:
+      ctx->param_trace_tasks = !!value;
+      break;
+
       /*
     case DE265_DECODER_PARAM_DISABLE_MC_RESIDUAL_IDCT:
       ctx->param_disable_mc_residual_idct = !!value;
@@ -503,6 +701,10 @@ LIBDE265_API void de265_set_parameter_int(de265_decoder_context* de265ctx, enum
       ctx->set_acceleration_functions((enum de265_acceleration)value);
       break;
 
+    case DE265_DECODER_PARAM_NUMA_NODE:
+      ctx->param_numa_node = value;
+      break;
+
     default:
       assert(false);
       break;
@@ -530,6 +732,33 @@ LIBDE265_API int de265_get_parameter_bool(de265_decoder_context* de265ctx, enum
     case DE265_DECODER_PARAM_DISABLE_SAO:
       return ctx->param_disable_sao;
 
+    case DE265_DECODER_PARAM_DECOUPLED_RECONSTRUCTION:
+      return ctx->param_decoupled_reconstruction;
+
+    case DE265_DECODER_PARAM_DECODE_IRAP_ONLY:
+      return ctx->param_decode_irap_only;
+
+    case DE265_DECODER_PARAM_LOW_LATENCY:
+      return ctx->param_low_latency;
+
+    case DE265_DECODER_PARAM_RELEASE_METADATA:
+      return ctx->param_release_metadata;
+
+    case DE265_DECODER_PARAM_TILED_REFERENCES:
+      return ctx->param_tiled_references;
+
+    case DE265_DECODER_PARAM_HUGE_PAGES:
+      return ctx->param_huge_pages;
+
+    case DE265_DECODER_PARAM_PARSE_ONLY:
+      return ctx->param_parse_only;
+
+    case DE265_DECODER_PARAM_KEEP_MOTION_FIELD:
+      return ctx->param_keep_motion_field;
+
+    case DE265_DECODER_PARAM_TRACE_TASKS:
+      return ctx->param_trace_tasks;
+
       /*
     case DE265_DECODER_PARAM_DISABLE_MC_RESIDUAL_IDCT:
       return ctx->param_disable_mc_residual_idct;
@@ -598,11 +827,32 @@ LIBDE265_API const uint8_t* de265_get_image_plane(const de265_image* img, int ch
 
   uint8_t* data = img->pixels_confwin[channel];
 
-  if (stride) *stride = img->get_image_stride(channel);
+  if (stride) *stride = img->get_image_stride(channel) * img->get_bytes_per_pixel(channel);
 
   return data;
 }
 
+LIBDE265_API int de265_get_bits_per_pixel(const struct de265_image* img,int channel)
+{
+  assert(channel>=0 && channel <= 2);
+
+  return img->get_bit_depth(channel);
+}
+
+LIBDE265_API int de265_get_converted_image_size(const struct de265_image* img,
+                                                enum de265_output_format format, int stride)
+{
+  return get_converted_image_size(img, format, stride);
+}
+
+LIBDE265_API de265_error de265_convert_image(const struct de265_image* img,
+                                             enum de265_output_format format,
+                                             enum de265_color_matrix matrix,
+                                             uint8_t* dst, int stride)
+{
+  return convert_image(img, format, matrix, dst, stride);
+}
+
 LIBDE265_API void *de265_get_image_plane_user_data(const struct de265_image* img, int channel)
 {
   assert(channel>=0 && channel <= 2);
@@ -612,7 +862,7 @@ LIBDE265_API void *de265_get_image_plane_user_data(const struct de265_image* img
 
 LIBDE265_API void de265_set_image_plane(de265_image* img, int cIdx, void* mem, int stride, void *userdata)
 {
-  img->set_image_plane(cIdx, (uint8_t*)mem, stride, userdata);
+  img->set_image_plane(cIdx, (uint8_t*)mem, stride / img->get_bytes_per_pixel(cIdx), userdata);
 }
 
 LIBDE265_API void de265_set_image_allocation_functions(de265_decoder_context* de265ctx,
@@ -624,6 +874,33 @@ LIBDE265_API void de265_set_image_allocation_functions(de265_decoder_context* de
   ctx->set_image_allocation_functions(allocfunc, userdata);
 }
 
+LIBDE265_API void de265_set_row_output_callback(de265_decoder_context* de265ctx,
+                                                de265_row_output_callback callback,
+                                                void* userdata)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  ctx->param_row_output_callback = callback;
+  ctx->param_row_output_userdata = userdata;
+}
+
+LIBDE265_API void de265_set_ctb_statistics_callback(de265_decoder_context* de265ctx,
+                                                    de265_ctb_statistics_callback callback,
+                                                    void* userdata)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  ctx->param_ctb_statistics_callback = callback;
+  ctx->param_ctb_statistics_userdata = userdata;
+}
+
+LIBDE265_API de265_error de265_write_task_trace(de265_decoder_context* de265ctx, const char* filename)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  return ctx->write_task_trace(filename);
+}
+
 LIBDE265_API const struct de265_image_allocation *de265_get_default_image_allocation_functions(void)
 {
   return &de265_image::default_image_allocation;
@@ -644,6 +921,14 @@ LIBDE265_API void de265_set_image_user_data(struct de265_image* img, void *user_
   img->user_data = user_data;
 }
 
+LIBDE265_API const void* de265_get_image_metadata(const struct de265_image* img,
+                                                  enum de265_metadata_type type,
+                                                  de265_metadata_layout* out_layout)
+{
+  return img->get_metadata(type, out_layout);
+}
+
+
 LIBDE265_API void de265_get_image_NAL_header(const struct de265_image* img,
                                              int* nal_unit_type,
                                              const char** nal_unit_name,
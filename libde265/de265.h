@@ -91,6 +91,7 @@ typedef enum {
   DE265_ERROR_LIBRARY_NOT_INITIALIZED=12,
   DE265_ERROR_WAITING_FOR_INPUT_DATA=13,
   DE265_ERROR_CANNOT_PROCESS_SEI=14,
+  DE265_ERROR_UNSUPPORTED_OUTPUT_FORMAT=15,
 
   // --- errors that should become obsolete in later libde265 versions ---
 
@@ -159,6 +160,9 @@ typedef int64_t de265_PTS;
 LIBDE265_API int de265_get_image_width(const struct de265_image*,int channel);
 LIBDE265_API int de265_get_image_height(const struct de265_image*,int channel);
 LIBDE265_API enum de265_chroma de265_get_chroma_format(const struct de265_image*);
+LIBDE265_API int de265_get_bits_per_pixel(const struct de265_image*,int channel);
+/* For bit depths > 8, each sample is stored as uint16_t in native byte order.
+   'out_stride' is the line length in bytes. */
 LIBDE265_API const uint8_t* de265_get_image_plane(const struct de265_image*, int channel, int* out_stride);
 LIBDE265_API void* de265_get_image_plane_user_data(const struct de265_image*, int channel);
 LIBDE265_API de265_PTS de265_get_image_PTS(const struct de265_image*);
@@ -175,6 +179,93 @@ LIBDE265_API void de265_get_image_NAL_header(const struct de265_image*,
                                              int* nuh_temporal_id);
 
 
+/* --- block metadata ---
+
+   Read-only views of the per-block decoding data of a picture, without copying.
+   Each array covers the whole picture (before cropping) in units of
+   (1<<log2_unit_size)^2 luma samples. The element for luma position (x,y) is at
+     data + (y>>log2_unit_size)*stride + (x>>log2_unit_size)*element_size  (in bytes).
+   The data is valid as long as the picture. NULL is returned if it is not available,
+   e.g. when DE265_DECODER_PARAM_RELEASE_METADATA is set.
+ */
+
+enum de265_metadata_type {
+  de265_metadata_motion=0,          // de265_motion_info, 4x4 units. After decoding, only
+                                    // available with DE265_DECODER_PARAM_KEEP_MOTION_FIELD.
+  de265_metadata_compressed_motion=1, // de265_motion_info of the 16x16 motion field used for
+                                    // TMVP, intra blocks have no predFlag set. Also kept with
+                                    // RELEASE_METADATA for pictures that may be referenced.
+  de265_metadata_coding_blocks=2,   // de265_coding_block_info, minimum CB size units
+  de265_metadata_intra_modes=3      // uint8_t luma intra prediction mode, minimum PU size units,
+                                    // undefined outside of intra CBs
+};
+
+typedef struct {
+  int element_size; // distance of horizontally neighboring elements in bytes
+  int stride;       // distance of vertically neighboring elements in bytes
+  int log2_unit_size;
+  int width, height; // number of units
+} de265_metadata_layout;
+
+typedef struct {
+  int8_t  refIdx[2];   // reference index into list 0/1, valid if predFlag is set
+  uint8_t predFlag[2];
+  int16_t mv[2][2];    // [list][x/y] in quarter luma samples
+} de265_motion_info;
+
+typedef struct {
+  uint8_t log2CbSize : 3;  // set only in the top-left unit of a CB, 0 elsewhere
+  uint8_t PartMode : 3;    // set only in the top-left unit of a CB:
+                           // 0: 2Nx2N, 1: 2NxN, 2: Nx2N, 3: NxN, 4: 2NxnU, 5: 2NxnD, 6: nLx2N, 7: nRx2N
+  uint8_t ctDepth : 2;     // coding quadtree depth
+  uint8_t PredMode : 2;    // 0: intra, 1: inter, 2: skip
+  uint8_t pcm_flag : 1;
+  uint8_t cu_transquant_bypass : 1;
+
+  int8_t  QP_Y;
+} de265_coding_block_info;
+
+LIBDE265_API const void* de265_get_image_metadata(const struct de265_image*,
+                                                  enum de265_metadata_type,
+                                                  de265_metadata_layout* out_layout);
+
+
+/* --- output conversion --- */
+
+enum de265_output_format {
+  de265_output_format_I420=0,   // Y, U, V planes, one after another
+  de265_output_format_NV12=1,   // Y plane, followed by one plane of interleaved U,V
+  de265_output_format_RGB24=2,  // packed R,G,B
+  de265_output_format_RGBA32=3, // packed R,G,B,A (A=255)
+  de265_output_format_YUV420P10=4, // like I420, 16 bit little-endian samples with 10 bit values
+  de265_output_format_P010=5       // like NV12, 16 bit little-endian samples, value in the upper bits
+};
+
+enum de265_color_matrix {
+  de265_color_matrix_BT601=0,
+  de265_color_matrix_BT709=1
+};
+
+/* Size in bytes of the buffer that de265_convert_image() writes, 0 if the format is not
+   supported for this image. 'stride' is the line length in bytes of the first plane
+   (0: no padding). I420/YUV420P10 chroma planes use stride/2, the NV12/P010 chroma
+   plane uses stride.
+ */
+LIBDE265_API int de265_get_converted_image_size(const struct de265_image*,
+                                                enum de265_output_format, int stride);
+
+/* Convert the image, cropped to the conformance window, into a single buffer.
+   Currently, only 4:2:0 images are supported, and the YUV formats require an even width
+   and height of the conformance window. Samples are rounded or shifted to the bit depth
+   of the output format. RGB output assumes limited-range YUV.
+   Large frames are converted in parallel on the decoder's worker threads.
+ */
+LIBDE265_API de265_error de265_convert_image(const struct de265_image*,
+                                             enum de265_output_format,
+                                             enum de265_color_matrix,
+                                             uint8_t* dst, int stride);
+
+
 /* === decoder === */
 
 typedef void de265_decoder_context; // private structure
@@ -188,6 +279,11 @@ LIBDE265_API de265_decoder_context* de265_new_decoder(void);
    all decoding is done in the main thread (no multi-threading). */
 LIBDE265_API de265_error de265_start_worker_threads(de265_decoder_context*, int number_of_threads);
 
+/* Pin the worker threads to CPUs: worker i runs on cpus[i % num_cpus].
+   Has to be set before de265_start_worker_threads(). num_cpus=0 removes the pinning.
+   See also DE265_DECODER_PARAM_NUMA_NODE. */
+LIBDE265_API void de265_set_worker_thread_affinity(de265_decoder_context*, const int* cpus, int num_cpus);
+
 /* Free decoder context. May only be called once on a context. */
 LIBDE265_API de265_error de265_free_decoder(de265_decoder_context*);
 
@@ -285,11 +381,96 @@ LIBDE265_API void de265_release_next_picture(de265_decoder_context*);
 LIBDE265_API de265_error de265_get_warning(de265_decoder_context*);
 
 
+/* --- random access --- */
+
+typedef struct {
+  int64_t byte_offset;   // position of the start code of the IRAP picture in the bytestream
+  int32_t POC;           // picture order count when decoding the stream from its start
+  int32_t stream_POC;    // POC continued over IDR/BLA pictures, increases over the whole stream
+  uint8_t nal_unit_type; // IDR, CRA or BLA
+} de265_index_entry;
+
+typedef void de265_stream_index; // private structure
+
+/* Get a new stream index. Must be freed with de265_free_stream_index(). */
+LIBDE265_API de265_stream_index* de265_new_stream_index(void);
+LIBDE265_API void de265_free_stream_index(de265_stream_index*);
+
+/* Scan bytestream data for IRAP pictures. The whole stream has to be pushed in
+   consecutive chunks, followed by de265_stream_index_flush_data(). Slice data is not decoded. */
+LIBDE265_API void de265_stream_index_push_data(de265_stream_index*, const void* data, int length);
+LIBDE265_API void de265_stream_index_flush_data(de265_stream_index*);
+
+LIBDE265_API int  de265_stream_index_get_number_of_entries(const de265_stream_index*);
+LIBDE265_API const de265_index_entry* de265_stream_index_get_entry(const de265_stream_index*, int idx);
+
+/* Index of the last IRAP picture with a stream_POC not larger than the given one, -1 if none. */
+LIBDE265_API int  de265_stream_index_find_entry(const de265_stream_index*, int32_t stream_POC);
+
+LIBDE265_API de265_error de265_stream_index_save(const de265_stream_index*, const char* filename);
+LIBDE265_API de265_error de265_stream_index_load(de265_stream_index*, const char* filename);
+
+/* Reset the decoder for decoding from the IRAP picture of index entry 'entry_idx' on.
+   The parameter sets active at that picture are passed to the decoder, input data has to
+   be pushed starting at the entry's byte_offset. Pictures preceding 'target_stream_POC' in
+   output order are not output. The RASL pictures of the IRAP and the non-reference
+   pictures before the target are not decoded at all. */
+LIBDE265_API de265_error de265_seek(de265_decoder_context*, const de265_stream_index*,
+                                    int entry_idx, int32_t target_stream_POC);
+
+
+/* --- stream probing ---
+
+   While scanning a stream, the stream index also collects information about each coded
+   video sequence and each coded picture. Hence, pushing a stream into a new index is a fast
+   way to probe it: only parameter sets and slice segment headers are parsed, no pictures are
+   allocated and slice data is never read. This information is not stored in index files.
+ */
+
+typedef struct {
+  int32_t  first_picture;    // index of the first picture of the sequence
+  int32_t  num_pictures;
+  uint16_t width, height;    // size of the output pictures (after cropping)
+  uint8_t  chroma_format;    // enum de265_chroma
+  uint8_t  bit_depth_luma;
+  uint8_t  bit_depth_chroma;
+  uint8_t  profile_idc;      // general_profile_idc (1: Main, 2: Main 10, 3: Main Still Picture)
+  uint8_t  tier_flag;
+  uint8_t  level_idc;        // general_level_idc (30 times the level number)
+} de265_sequence_info;
+
+typedef struct {
+  int64_t  byte_offset;      // position of the first start code of the access unit
+  int64_t  size;             // size of the access unit in the bytestream
+  int32_t  POC;
+  int32_t  stream_POC;
+  int32_t  sequence;         // index of the coded video sequence
+  uint16_t num_slice_segments;
+  uint8_t  nal_unit_type;
+  uint8_t  temporal_id;
+  uint8_t  slice_types;      // (1<<slice_type) of all slice segments: 1 = B, 2 = P, 4 = I
+  uint8_t  pic_output_flag;
+} de265_picture_info;
+
+/* Pictures are numbered in decoding order. */
+LIBDE265_API int  de265_stream_index_get_number_of_pictures(const de265_stream_index*);
+LIBDE265_API const de265_picture_info* de265_stream_index_get_picture(const de265_stream_index*, int idx);
+
+LIBDE265_API int  de265_stream_index_get_number_of_sequences(const de265_stream_index*);
+LIBDE265_API const de265_sequence_info* de265_stream_index_get_sequence(const de265_stream_index*, int idx);
+
+
 enum de265_image_format {
   de265_image_format_mono8    = 1,
   de265_image_format_YUV420P8 = 2,
   de265_image_format_YUV422P8 = 3,
-  de265_image_format_YUV444P8 = 4
+  de265_image_format_YUV444P8 = 4,
+
+  // bit depths > 8, samples are stored as uint16_t (see de265_get_bits_per_pixel())
+  de265_image_format_mono16    = 5,
+  de265_image_format_YUV420P16 = 6,
+  de265_image_format_YUV422P16 = 7,
+  de265_image_format_YUV444P16 = 8
 };
 
 struct de265_image_spec
@@ -297,7 +478,7 @@ struct de265_image_spec
   enum de265_image_format format;
   int width;
   int height;
-  int alignment;
+  int alignment;  // in bytes, for the plane start addresses and the strides
 
   // conformance window
 
@@ -326,11 +507,94 @@ struct de265_image_allocation
 LIBDE265_API void de265_set_image_allocation_functions(de265_decoder_context*,
                                                        struct de265_image_allocation*,
                                                        void* userdata);
+
+/* The default allocator places the three planes of a picture in one block with cache-line
+   aligned planes and strides. Strides that are multiples of 1024 bytes are padded to avoid
+   cache-set aliasing. See DE265_DECODER_PARAM_HUGE_PAGES. Custom allocators can call these
+   functions, e.g. to pool the default buffers. */
 LIBDE265_API const struct de265_image_allocation *de265_get_default_image_allocation_functions(void);
 
+/* 'stride' is given in bytes. */
 LIBDE265_API void de265_set_image_plane(struct de265_image* img, int cIdx, void* mem, int stride, void *userdata);
 
 
+/* --- low-latency output ---
+
+   The row output callback is called as soon as a band of lines is completely decoded and
+   filtered, before the whole picture is finished. Lines [first_line;end_line) are luma
+   lines in the conformance window. The bands of a picture are passed in top-to-bottom order,
+   usually from the worker threads. 'img' may be an internal buffer that is only valid during
+   the callback, use it only to access the pixel data.
+   Use together with DE265_DECODER_PARAM_LOW_LATENCY to filter while decoding.
+ */
+typedef void (*de265_row_output_callback)(void* userdata, const struct de265_image* img,
+                                          int first_line, int end_line);
+
+LIBDE265_API void de265_set_row_output_callback(de265_decoder_context*,
+                                                de265_row_output_callback, // NULL: disable
+                                                void* userdata);
+
+
+/* --- syntax statistics ---
+
+   The CTB statistics callback is called for each CTB right after it has been parsed,
+   usually from the worker threads and, with tiles or WPP, for several CTBs in parallel.
+   The data is only valid during the callback.
+   Combined with DE265_DECODER_PARAM_PARSE_ONLY, bitstream statistics can be collected
+   several times faster than with a full decode.
+ */
+
+typedef struct {
+  uint16_t x,y;          // luma position
+  uint8_t  log2_size;
+  uint8_t  pred_mode;    // 0: intra, 1: inter, 2: skip
+  uint8_t  part_mode;    // 0: 2Nx2N, 1: 2NxN, 2: Nx2N, 3: NxN, 4: 2NxnU, 5: 2NxnD, 6: nLx2N, 7: nRx2N
+  uint8_t  intra_pred_mode; // luma mode of the first prediction block (intra only)
+  int8_t   QP_Y;
+} de265_cb_statistics;
+
+typedef struct {
+  uint16_t x,y;          // luma position
+  uint8_t  width,height;
+  int8_t   refIdx[2];    // -1: list not used
+  int16_t  mv[2][2];     // [list][x/y] in quarter samples
+} de265_pb_statistics;
+
+typedef struct {
+  int32_t  POC;
+  uint16_t x,y;          // luma position
+  uint32_t bits;         // coded size, including the SAO parameters
+  int      num_cbs;      // coding blocks in decoding order
+  const de265_cb_statistics* cbs;
+  int      num_pbs;      // inter prediction blocks in decoding order
+  const de265_pb_statistics* pbs;
+} de265_ctb_statistics;
+
+typedef void (*de265_ctb_statistics_callback)(void* userdata, const de265_ctb_statistics*);
+
+LIBDE265_API void de265_set_ctb_statistics_callback(de265_decoder_context*,
+                                                    de265_ctb_statistics_callback, // NULL: disable
+                                                    void* userdata);
+
+
+/* --- task trace ---
+
+   With DE265_DECODER_PARAM_TRACE_TASKS set before de265_start_worker_threads(),
+   the worker threads record every task they execute (slice segments, tiles,
+   WPP CTB rows, deblocking and SAO rows, hash checks, ...): which worker ran it,
+   when it started and ended, and how long it was blocked waiting for other tasks.
+
+   de265_write_task_trace() writes the recorded tasks as Chrome trace event JSON,
+   which can be loaded into chrome://tracing or https://ui.perfetto.dev .
+   The written tasks are removed from the recording, i.e. each call writes the
+   tasks executed since the previous call. The call blocks until the currently
+   running tasks have finished. Without DE265_DECODER_PARAM_TRACE_TASKS, an empty
+   trace is written.
+ */
+
+LIBDE265_API de265_error de265_write_task_trace(de265_decoder_context*, const char* filename);
+
+
 /* --- frame dropping API ---
 
    To limit decoding to a maximum temporal layer (TID), use de265_set_limit_TID().
@@ -358,6 +622,50 @@ LIBDE265_API void de265_set_framerate_ratio(de265_decoder_context*,int percent);
 LIBDE265_API int  de265_change_framerate(de265_decoder_context*,int more_vs_less); // 1: more, -1: less, returns corresponding framerate_ratio
 
 
+/* --- deadline-driven frame dropping ---
+
+   With a presentation clock, the decoder drops pictures that would not be decoded before
+   they are due for display. The clock returns the PTS that is presented at the time of the
+   call, 'pts_per_second' is the number of PTS units per second. The decoding time of each
+   temporal layer is measured while decoding.
+
+   The decision is taken when the first slice of a picture is read, such that pictures
+   are only dropped when they are actually late. Only pictures that no decoded picture
+   depends on are dropped: sub-layer non-reference pictures of the highest decoded layer
+   first, then whole temporal layers from the top. Dropped layers are decoded again from
+   the next TSA/STSA or IRAP picture on, when there is enough time left. Reference pictures
+   of the base layer are never dropped.
+
+   This works together with de265_set_limit_TID(), layers above the limit are never
+   decoded. Pass clock=NULL to disable.
+*/
+
+typedef de265_PTS (*de265_presentation_clock)(void* userdata);
+
+LIBDE265_API void de265_set_presentation_clock(de265_decoder_context*,
+                                               de265_presentation_clock clock, // NULL: disable
+                                               void* userdata,
+                                               de265_PTS pts_per_second);
+LIBDE265_API int  de265_get_number_of_late_pictures_dropped(de265_decoder_context*);
+
+
+/* --- region of interest ---
+
+   In streams with tiles, tiles that lie completely outside of the region of interest
+   are not decoded. Their slice data is skipped using the entry points, the area is
+   neither reconstructed nor filtered and keeps undefined content.
+   The region is given in luma samples of the output (cropped) picture.
+   Inside of the region, the result is only exact if the stream does not predict from
+   outside the decoded tiles (e.g. motion-constrained tile sets). Otherwise, prediction
+   from undecoded areas leads to drift, which may be acceptable for a viewport.
+   SEI hashes are not checked on pictures with skipped tiles.
+   Pass width=0 or height=0 to decode the whole picture again.
+*/
+
+LIBDE265_API void de265_set_region_of_interest(de265_decoder_context*,
+                                               int x,int y, int width,int height);
+
+
 /* --- decoding parameters --- */
 
 enum de265_param {
@@ -370,9 +678,19 @@ enum de265_param {
   DE265_DECODER_PARAM_SUPPRESS_FAULTY_PICTURES=6, // (bool)  do not output frames with decoding errors, default: no (output all images)
 
   DE265_DECODER_PARAM_DISABLE_DEBLOCKING=7,   // (bool)  disable deblocking
-  DE265_DECODER_PARAM_DISABLE_SAO=8           // (bool)  disable SAO filter
+  DE265_DECODER_PARAM_DISABLE_SAO=8,          // (bool)  disable SAO filter
   //DE265_DECODER_PARAM_DISABLE_MC_RESIDUAL_IDCT=9,     // (bool)  disable decoding of IDCT residuals in MC blocks
   //DE265_DECODER_PARAM_DISABLE_INTRA_RESIDUAL_IDCT=10  // (bool)  disable decoding of IDCT residuals in MC blocks
+  DE265_DECODER_PARAM_DECOUPLED_RECONSTRUCTION=11, // (bool)  reconstruct in a separate thread, pipelined with parsing (needs worker threads)
+  DE265_DECODER_PARAM_NUMA_NODE=12, // (int)  place worker threads (unless pinned explicitly) and picture memory on this NUMA node, default: -1 (no placement)
+  DE265_DECODER_PARAM_DECODE_IRAP_ONLY=13, // (bool)  decode only IRAP pictures, drop all others after the NAL header (combine with DISABLE_DEBLOCKING/SAO for fastest thumbnails)
+  DE265_DECODER_PARAM_LOW_LATENCY=14, // (bool)  filter CTB rows while decoding (WPP, one slice segment per picture), bypass the reorder buffer if the stream has no reordering, check SEI hashes before output
+  DE265_DECODER_PARAM_RELEASE_METADATA=15, // (bool)  free the per-block decoding data of pictures after filtering, keep only pixels and the motion field for TMVP (saves memory, but visualization of output pictures is not possible anymore)
+  DE265_DECODER_PARAM_TILED_REFERENCES=16, // (bool)  keep an additional copy of reference pictures in 16x16 sample blocks for motion compensation (faster MC at large resolutions, costs one more picture of memory per reference)
+  DE265_DECODER_PARAM_HUGE_PAGES=17, // (bool)  default image allocator: use transparent huge pages for pictures of 2 MB or more, default: on
+  DE265_DECODER_PARAM_PARSE_ONLY=18, // (bool)  parse the complete syntax, but skip prediction, residual transforms, loop filters and hash checks (pixel data of output pictures is undefined, see de265_set_ctb_statistics_callback())
+  DE265_DECODER_PARAM_KEEP_MOTION_FIELD=19, // (bool)  keep the full-resolution motion field of decoded pictures for de265_get_image_metadata(), default: only the 16x16 field is kept
+  DE265_DECODER_PARAM_TRACE_TASKS=20 // (bool)  record the tasks executed by the worker threads for de265_write_task_trace() (set before starting the worker threads)
 };
 
 // sorted such that a large ID includes all optimizations from lower IDs
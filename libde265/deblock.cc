@@ -127,254 +127,248 @@ void markPredictionBlockBoundary(de265_image* img, int x0,int y0,
 }
 
 
-bool derive_edgeFlags_CTBRow(de265_image* img, int ctby)
+// 8.7.2.3 bS of a single edge segment (xDi;yDi is on the Q side)
+static uint8_t derive_edge_bS(de265_image* img, bool vertical, int xDi,int yDi,
+                              uint8_t edgeFlags)
 {
-  const int minCbSize = img->sps.MinCbSizeY;
-  bool deblocking_enabled=false; // whether deblocking is enabled in some part of the image
+  int xOffs = vertical ? 1 : 0;
+  int yOffs = vertical ? 0 : 1;
+  int transformEdgeMask = vertical ? DEBLOCK_FLAG_VERTI : DEBLOCK_FLAG_HORIZ;
 
-  int ctb_mask = (1<<img->sps.Log2CtbSizeY)-1;
-  int picWidthInCtbs = img->sps.PicWidthInCtbsY;
-  int ctbshift = img->sps.Log2CtbSizeY;
+  bool p_is_intra_pred = (img->get_pred_mode(xDi-xOffs, yDi-yOffs) == MODE_INTRA);
+  bool q_is_intra_pred = (img->get_pred_mode(xDi,       yDi      ) == MODE_INTRA);
 
-  const pic_parameter_set* pps = &img->pps;
+  int bS;
 
+  if (p_is_intra_pred || q_is_intra_pred) {
+    bS = 2;
+  }
+  else {
+    // opposing site
+    int xDiOpp = xDi-xOffs;
+    int yDiOpp = yDi-yOffs;
+
+    if ((edgeFlags & transformEdgeMask) &&
+        (img->get_nonzero_coefficient(xDi   ,yDi) ||
+         img->get_nonzero_coefficient(xDiOpp,yDiOpp))) {
+      bS = 1;
+    }
+    else {
 
-  int cb_y_start = ( ctby    << img->sps.Log2CtbSizeY) >> img->sps.Log2MinCbSizeY;
-  int cb_y_end   = ((ctby+1) << img->sps.Log2CtbSizeY) >> img->sps.Log2MinCbSizeY;
+      bS = 0;
 
-  cb_y_end = std::min(cb_y_end, img->sps.PicHeightInMinCbsY);
+      const PredVectorInfo* mviP = img->get_mv_info(xDiOpp,yDiOpp);
+      const PredVectorInfo* mviQ = img->get_mv_info(xDi   ,yDi);
 
-  for (int cb_y=cb_y_start;cb_y<cb_y_end;cb_y++)
-    for (int cb_x=0;cb_x<img->sps.PicWidthInMinCbsY;cb_x++)
-      {
-        int log2CbSize = img->get_log2CbSize_cbUnits(cb_x,cb_y);
-        if (log2CbSize==0) {
-          continue;
-        }
+      slice_segment_header* shdrP = img->get_SliceHeader(xDiOpp,yDiOpp);
+      slice_segment_header* shdrQ = img->get_SliceHeader(xDi   ,yDi);
 
-        // we are now at the top corner of a CB
+      int refPicP0 = mviP->predFlag[0] ? shdrP->RefPicList[0][ mviP->refIdx[0] ] : -1;
+      int refPicP1 = mviP->predFlag[1] ? shdrP->RefPicList[1][ mviP->refIdx[1] ] : -1;
+      int refPicQ0 = mviQ->predFlag[0] ? shdrQ->RefPicList[0][ mviQ->refIdx[0] ] : -1;
+      int refPicQ1 = mviQ->predFlag[1] ? shdrQ->RefPicList[1][ mviQ->refIdx[1] ] : -1;
 
-        int x0 = cb_x * minCbSize;
-        int y0 = cb_y * minCbSize;
+      bool samePics = ((refPicP0==refPicQ0 && refPicP1==refPicQ1) ||
+                       (refPicP0==refPicQ1 && refPicP1==refPicQ0));
 
-        int x0ctb = x0 >> ctbshift;
-        int y0ctb = y0 >> ctbshift;
-
-        // check whether we should filter this slice
-
-        slice_segment_header* shdr = img->get_SliceHeader(x0,y0);
+      if (!samePics) {
+        bS = 1;
+      }
+      else {
+        MotionVector mvP0 = mviP->mv[0]; if (!mviP->predFlag[0]) { mvP0.x=mvP0.y=0; }
+        MotionVector mvP1 = mviP->mv[1]; if (!mviP->predFlag[1]) { mvP1.x=mvP1.y=0; }
+        MotionVector mvQ0 = mviQ->mv[0]; if (!mviQ->predFlag[0]) { mvQ0.x=mvQ0.y=0; }
+        MotionVector mvQ1 = mviQ->mv[1]; if (!mviQ->predFlag[1]) { mvQ1.x=mvQ1.y=0; }
 
-        // check whether to filter left and top edge
+        int numMV_P = mviP->predFlag[0] + mviP->predFlag[1];
+        int numMV_Q = mviQ->predFlag[0] + mviQ->predFlag[1];
 
-        uint8_t filterLeftCbEdge = DEBLOCK_FLAG_VERTI;
-        uint8_t filterTopCbEdge  = DEBLOCK_FLAG_HORIZ;
-        if (x0 == 0) filterLeftCbEdge = 0;
-        if (y0 == 0) filterTopCbEdge  = 0;
+        if (numMV_P!=numMV_Q) {
+          img->decctx->add_warning(DE265_WARNING_NUMMVP_NOT_EQUAL_TO_NUMMVQ, false);
+          img->integrity = INTEGRITY_DECODING_ERRORS;
+        }
 
-        // check for slice and tile boundaries (8.7.2, step 2 in both processes)
+        // two different reference pictures or only one reference picture
+        if (refPicP0 != refPicP1) {
 
-        if (x0 && ((x0 & ctb_mask) == 0)) { // left edge at CTB boundary
-          if (shdr->slice_loop_filter_across_slices_enabled_flag == 0 &&
-              shdr->SliceAddrRS != img->get_SliceHeader(x0-1,y0)->SliceAddrRS)
-            {
-              filterLeftCbEdge = 0;
+          if (refPicP0 == refPicQ0) {
+            if (abs_value(mvP0.x-mvQ0.x) >= 4 ||
+                abs_value(mvP0.y-mvQ0.y) >= 4 ||
+                abs_value(mvP1.x-mvQ1.x) >= 4 ||
+                abs_value(mvP1.y-mvQ1.y) >= 4) {
+              bS = 1;
             }
-          else if (pps->loop_filter_across_tiles_enabled_flag == 0 &&
-                   pps->TileIdRS[  x0ctb           +y0ctb*picWidthInCtbs] !=
-                   pps->TileIdRS[((x0-1)>>ctbshift)+y0ctb*picWidthInCtbs]) {
-            filterLeftCbEdge = 0;
           }
-        }
-
-        if (y0 && ((y0 & ctb_mask) == 0)) { // top edge at CTB boundary
-          if (shdr->slice_loop_filter_across_slices_enabled_flag == 0 &&
-              shdr->SliceAddrRS != img->get_SliceHeader(x0,y0-1)->SliceAddrRS)
-            {
-              filterTopCbEdge = 0;
+          else {
+            if (abs_value(mvP0.x-mvQ1.x) >= 4 ||
+                abs_value(mvP0.y-mvQ1.y) >= 4 ||
+                abs_value(mvP1.x-mvQ0.x) >= 4 ||
+                abs_value(mvP1.y-mvQ0.y) >= 4) {
+              bS = 1;
             }
-          else if (pps->loop_filter_across_tiles_enabled_flag == 0 &&
-                   pps->TileIdRS[x0ctb+  y0ctb           *picWidthInCtbs] !=
-                   pps->TileIdRS[x0ctb+((y0-1)>>ctbshift)*picWidthInCtbs]) {
-            filterTopCbEdge = 0;
           }
         }
-
-
-        // mark edges
-
-        if (shdr->slice_deblocking_filter_disabled_flag==0) {
-          deblocking_enabled=true;
-
-          markTransformBlockBoundary(img, x0,y0, log2CbSize,0,
-                                     filterLeftCbEdge, filterTopCbEdge);
-
-          markPredictionBlockBoundary(img, x0,y0, log2CbSize,
-                                      filterLeftCbEdge, filterTopCbEdge);
+        else {
+          assert(refPicQ0==refPicQ1);
+
+          if ((abs_value(mvP0.x-mvQ0.x) >= 4 ||
+               abs_value(mvP0.y-mvQ0.y) >= 4 ||
+               abs_value(mvP1.x-mvQ1.x) >= 4 ||
+               abs_value(mvP1.y-mvQ1.y) >= 4)
+              &&
+              (abs_value(mvP0.x-mvQ1.x) >= 4 ||
+               abs_value(mvP0.y-mvQ1.y) >= 4 ||
+               abs_value(mvP1.x-mvQ0.x) >= 4 ||
+               abs_value(mvP1.y-mvQ0.y) >= 4)) {
+            bS = 1;
+          }
         }
       }
 
-  return deblocking_enabled;
-}
+      /*
+        printf("unimplemented deblocking code for CU at %d;%d\n",xDi,yDi);
 
-
-bool derive_edgeFlags(de265_image* img)
-{
-  bool deblocking_enabled=false;
-
-  for (int y=0;y<img->sps.PicHeightInCtbsY;y++) {
-    deblocking_enabled |= derive_edgeFlags_CTBRow(img,y);
+        logerror(LogDeblock, "unimplemented code reached (file %s, line %d)\n",
+        __FILE__, __LINE__);
+      */
+    }
   }
 
-  return deblocking_enabled;
+  return bS;
 }
 
 
-// 8.7.2.3 (both, EDGE_VER and EDGE_HOR)
-void derive_boundaryStrength(de265_image* img, bool vertical, int yStart,int yEnd,
-                             int xStart,int xEnd)
+/* Mark the transform and prediction block edges (8.7.2.1, 8.7.2.2) of a CU that has
+   just been decoded and derive their boundary strengths while the CU metadata is still
+   in the cache.
+
+   The edges on the left and top CTB boundary are only marked. Their bS is derived in
+   derive_CTB_boundary_edges() because the neighboring CTB might not be decoded yet.
+ */
+void derive_deblocking_CU(de265_image* img, const slice_segment_header* shdr,
+                          int x0,int y0, int log2CbSize)
 {
-  int xIncr = vertical ? 2 : 1;
-  int yIncr = vertical ? 1 : 2;
-  int xOffs = vertical ? 1 : 0;
-  int yOffs = vertical ? 0 : 1;
-  int edgeMask = vertical ?
-    (DEBLOCK_FLAG_VERTI | DEBLOCK_PB_EDGE_VERTI) :
-    (DEBLOCK_FLAG_HORIZ | DEBLOCK_PB_EDGE_HORIZ);
-  int transformEdgeMask = vertical ? DEBLOCK_FLAG_VERTI : DEBLOCK_FLAG_HORIZ;
+  if (shdr->slice_deblocking_filter_disabled_flag) {
+    return;
+  }
 
-  xEnd = libde265_min(xEnd,img->get_deblk_width());
-  yEnd = libde265_min(yEnd,img->get_deblk_height());
+  const int ctbshift = img->sps.Log2CtbSizeY;
+  const int ctb_mask = (1<<ctbshift)-1;
 
-  int TUShift = img->sps.Log2MinTrafoSize;
-  int TUStride= img->sps.PicWidthInTbsY;
+  img->set_CtbDeblockFlag(x0>>ctbshift, y0>>ctbshift, true);
 
-  for (int y=yStart;y<yEnd;y+=yIncr)
-    for (int x=xStart;x<xEnd;x+=xIncr) {
-      int xDi = x<<2;
-      int yDi = y<<2;
+  uint8_t filterLeftCbEdge = DEBLOCK_FLAG_VERTI;
+  uint8_t filterTopCbEdge  = DEBLOCK_FLAG_HORIZ;
+  if (x0 == 0) filterLeftCbEdge = 0;
+  if (y0 == 0) filterTopCbEdge  = 0;
 
-      logtrace(LogDeblock,"%d %d %s = %s\n",xDi,yDi, vertical?"Vertical":"Horizontal",
-               (img->get_deblk_flags(xDi,yDi) & edgeMask) ? "edge" : "...");
+  markTransformBlockBoundary(img, x0,y0, log2CbSize,0,
+                             filterLeftCbEdge, filterTopCbEdge);
 
-      uint8_t edgeFlags = img->get_deblk_flags(xDi,yDi);
+  markPredictionBlockBoundary(img, x0,y0, log2CbSize,
+                              filterLeftCbEdge, filterTopCbEdge);
 
-      if (edgeFlags & edgeMask) {
-        bool p_is_intra_pred = (img->get_pred_mode(xDi-xOffs, yDi-yOffs) == MODE_INTRA);
-        bool q_is_intra_pred = (img->get_pred_mode(xDi,       yDi      ) == MODE_INTRA);
 
-        int bS;
+  // bS of all edges on the 8x8 grid inside of the CTB
 
-        if (p_is_intra_pred || q_is_intra_pred) {
-          bS = 2;
-        }
-        else {
-          // opposing site
-          int xDiOpp = xDi-xOffs;
-          int yDiOpp = yDi-yOffs;
+  const int cbSize = 1<<log2CbSize;
 
-          if ((edgeFlags & transformEdgeMask) &&
-              (img->get_nonzero_coefficient(xDi   ,yDi) ||
-               img->get_nonzero_coefficient(xDiOpp,yDiOpp))) {
-            bS = 1;
-          }
-          else {
+  for (int y=y0;y<y0+cbSize;y+=4)
+    for (int x=x0;x<x0+cbSize;x+=4) {
+      uint8_t edgeFlags = img->get_deblk_flags(x,y);
 
-            bS = 0;
+      if ((x & 7)==0 && (x & ctb_mask)!=0 &&
+          (edgeFlags & (DEBLOCK_FLAG_VERTI | DEBLOCK_PB_EDGE_VERTI))) {
+        img->set_deblk_bS(x,y, true, derive_edge_bS(img, true, x,y, edgeFlags));
+      }
 
-            const PredVectorInfo* mviP = img->get_mv_info(xDiOpp,yDiOpp);
-            const PredVectorInfo* mviQ = img->get_mv_info(xDi   ,yDi);
+      if ((y & 7)==0 && (y & ctb_mask)!=0 &&
+          (edgeFlags & (DEBLOCK_FLAG_HORIZ | DEBLOCK_PB_EDGE_HORIZ))) {
+        img->set_deblk_bS(x,y, false, derive_edge_bS(img, false, x,y, edgeFlags));
+      }
+    }
+}
 
-            slice_segment_header* shdrP = img->get_SliceHeader(xDiOpp,yDiOpp);
-            slice_segment_header* shdrQ = img->get_SliceHeader(xDi   ,yDi);
 
-            int refPicP0 = mviP->predFlag[0] ? shdrP->RefPicList[0][ mviP->refIdx[0] ] : -1;
-            int refPicP1 = mviP->predFlag[1] ? shdrP->RefPicList[1][ mviP->refIdx[1] ] : -1;
-            int refPicQ0 = mviQ->predFlag[0] ? shdrQ->RefPicList[0][ mviQ->refIdx[0] ] : -1;
-            int refPicQ1 = mviQ->predFlag[1] ? shdrQ->RefPicList[1][ mviQ->refIdx[1] ] : -1;
+/* Derive the bS on the left and top CTB boundaries of a CTB row.
+   All CTBs of this row and of the row above have to be decoded.
+   Returns whether deblocking is enabled in some CTB of the row.
+ */
+bool derive_CTB_boundary_edges(de265_image* img, int ctby)
+{
+  const seq_parameter_set* sps = &img->sps;
+  const pic_parameter_set* pps = &img->pps;
 
-            bool samePics = ((refPicP0==refPicQ0 && refPicP1==refPicQ1) ||
-                             (refPicP0==refPicQ1 && refPicP1==refPicQ0));
+  const int ctbshift = sps->Log2CtbSizeY;
+  const int ctbSize  = sps->CtbSizeY;
+  const int picWidthInCtbs = sps->PicWidthInCtbsY;
 
-            if (!samePics) {
-              bS = 1;
-            }
-            else {
-              MotionVector mvP0 = mviP->mv[0]; if (!mviP->predFlag[0]) { mvP0.x=mvP0.y=0; }
-              MotionVector mvP1 = mviP->mv[1]; if (!mviP->predFlag[1]) { mvP1.x=mvP1.y=0; }
-              MotionVector mvQ0 = mviQ->mv[0]; if (!mviQ->predFlag[0]) { mvQ0.x=mvQ0.y=0; }
-              MotionVector mvQ1 = mviQ->mv[1]; if (!mviQ->predFlag[1]) { mvQ1.x=mvQ1.y=0; }
+  bool deblocking_enabled=false;
 
-              int numMV_P = mviP->predFlag[0] + mviP->predFlag[1];
-              int numMV_Q = mviQ->predFlag[0] + mviQ->predFlag[1];
+  for (int ctbx=0;ctbx<picWidthInCtbs;ctbx++) {
+    if (!img->get_CtbDeblockFlag(ctbx,ctby)) {
+      continue;
+    }
 
-              if (numMV_P!=numMV_Q) {
-                img->decctx->add_warning(DE265_WARNING_NUMMVP_NOT_EQUAL_TO_NUMMVQ, false);
-                img->integrity = INTEGRITY_DECODING_ERRORS;
-              }
+    deblocking_enabled=true;
 
-              // two different reference pictures or only one reference picture
-              if (refPicP0 != refPicP1) {
+    const slice_segment_header* shdr = img->get_SliceHeaderCtb(ctbx,ctby);
 
-                if (refPicP0 == refPicQ0) {
-                  if (abs_value(mvP0.x-mvQ0.x) >= 4 ||
-                      abs_value(mvP0.y-mvQ0.y) >= 4 ||
-                      abs_value(mvP1.x-mvQ1.x) >= 4 ||
-                      abs_value(mvP1.y-mvQ1.y) >= 4) {
-                    bS = 1;
-                  }
-                }
-                else {
-                  if (abs_value(mvP0.x-mvQ1.x) >= 4 ||
-                      abs_value(mvP0.y-mvQ1.y) >= 4 ||
-                      abs_value(mvP1.x-mvQ0.x) >= 4 ||
-                      abs_value(mvP1.y-mvQ0.y) >= 4) {
-                    bS = 1;
-                  }
-                }
-              }
-              else {
-                assert(refPicQ0==refPicQ1);
-
-                if ((abs_value(mvP0.x-mvQ0.x) >= 4 ||
-                     abs_value(mvP0.y-mvQ0.y) >= 4 ||
-                     abs_value(mvP1.x-mvQ1.x) >= 4 ||
-                     abs_value(mvP1.y-mvQ1.y) >= 4)
-                    &&
-                    (abs_value(mvP0.x-mvQ1.x) >= 4 ||
-                     abs_value(mvP0.y-mvQ1.y) >= 4 ||
-                     abs_value(mvP1.x-mvQ0.x) >= 4 ||
-                     abs_value(mvP1.y-mvQ0.y) >= 4)) {
-                  bS = 1;
-                }
-              }
-            }
+    int x0 = ctbx << ctbshift;
+    int y0 = ctby << ctbshift;
+    int xEnd = libde265_min(x0+ctbSize, sps->pic_width_in_luma_samples);
+    int yEnd = libde265_min(y0+ctbSize, sps->pic_height_in_luma_samples);
 
-            /*
-              printf("unimplemented deblocking code for CU at %d;%d\n",xDi,yDi);
+    // check for slice and tile boundaries (8.7.2, step 2 in both processes)
 
-              logerror(LogDeblock, "unimplemented code reached (file %s, line %d)\n",
-              __FILE__, __LINE__);
-            */
-          }
-        }
+    if (ctbx>0) { // left CTB boundary
+      bool filterLeftCtbEdge = true;
 
-        img->set_deblk_bS(xDi,yDi, bS);
+      if (shdr->slice_loop_filter_across_slices_enabled_flag == 0 &&
+          shdr->SliceAddrRS != img->get_SliceAddrRS(ctbx-1,ctby)) {
+        filterLeftCtbEdge = false;
       }
-      else {
-        img->set_deblk_bS(xDi,yDi, 0);
+      else if (pps->loop_filter_across_tiles_enabled_flag == 0 &&
+               pps->TileIdRS[ctbx  +ctby*picWidthInCtbs] !=
+               pps->TileIdRS[ctbx-1+ctby*picWidthInCtbs]) {
+        filterLeftCtbEdge = false;
+      }
+
+      if (filterLeftCtbEdge) {
+        for (int y=y0;y<yEnd;y+=4) {
+          uint8_t edgeFlags = img->get_deblk_flags(x0,y);
+          if (edgeFlags & DEBLOCK_FLAG_VERTI) {
+            img->set_deblk_bS(x0,y, true, derive_edge_bS(img, true, x0,y, edgeFlags));
+          }
+        }
       }
     }
-}
 
+    if (ctby>0) { // top CTB boundary
+      bool filterTopCtbEdge = true;
 
-void derive_boundaryStrength_CTB(de265_image* img, bool vertical, int xCtb,int yCtb)
-{
-  int ctbSize = img->sps.CtbSizeY;
-  int deblkSize = ctbSize/4;
+      if (shdr->slice_loop_filter_across_slices_enabled_flag == 0 &&
+          shdr->SliceAddrRS != img->get_SliceAddrRS(ctbx,ctby-1)) {
+        filterTopCtbEdge = false;
+      }
+      else if (pps->loop_filter_across_tiles_enabled_flag == 0 &&
+               pps->TileIdRS[ctbx+ ctby   *picWidthInCtbs] !=
+               pps->TileIdRS[ctbx+(ctby-1)*picWidthInCtbs]) {
+        filterTopCtbEdge = false;
+      }
+
+      if (filterTopCtbEdge) {
+        for (int x=x0;x<xEnd;x+=4) {
+          uint8_t edgeFlags = img->get_deblk_flags(x,y0);
+          if (edgeFlags & DEBLOCK_FLAG_HORIZ) {
+            img->set_deblk_bS(x,y0, false, derive_edge_bS(img, false, x,y0, edgeFlags));
+          }
+        }
+      }
+    }
+  }
 
-  derive_boundaryStrength(img,vertical,
-                          yCtb*deblkSize, (yCtb+1)*deblkSize,
-                          xCtb*deblkSize, (xCtb+1)*deblkSize);
+  return deblocking_enabled;
 }
 
 
@@ -393,8 +387,9 @@ static uint8_t table_8_23_tc[54] = {
 
 
 // 8.7.2.4
-void edge_filtering_luma(de265_image* img, bool vertical,
-                         int yStart,int yEnd, int xStart,int xEnd)
+template <class pixel_t>
+static void edge_filtering_luma_internal(de265_image* img, bool vertical,
+                                         int yStart,int yEnd, int xStart,int xEnd)
 {
   int xIncr = vertical ? 2 : 1;
   int yIncr = vertical ? 1 : 2;
@@ -410,7 +405,7 @@ void edge_filtering_luma(de265_image* img, bool vertical,
     for (int x=xStart;x<xEnd;x+=xIncr) {
       int xDi = x<<2;
       int yDi = y<<2;
-      int bS = img->get_deblk_bS(xDi,yDi);
+      int bS = img->get_deblk_bS(xDi,yDi, vertical);
 
       logtrace(LogDeblock,"deblock POC=%d %c --- x:%d y:%d bS:%d---\n",
                img->PicOrderCntVal,vertical ? 'V':'H',xDi,yDi,bS);
@@ -450,9 +445,9 @@ void edge_filtering_luma(de265_image* img, bool vertical,
 
         // 8.7.2.4.3
 
-        uint8_t* ptr = img->get_image_plane_at_pos(0, xDi,yDi);
+        pixel_t* ptr = (pixel_t*)img->get_image_plane_at_pos(0, xDi,yDi);
 
-        uint8_t q[4][4], p[4][4];
+        pixel_t q[4][4], p[4][4];
         for (int k=0;k<4;k++)
           for (int i=0;i<4;i++)
             {
@@ -577,21 +572,21 @@ void edge_filtering_luma(de265_image* img, bool vertical,
 
             logtrace(LogDeblock,"line:%d\n",k);
 
-            const uint8_t p0 = p[k][0];
-            const uint8_t p1 = p[k][1];
-            const uint8_t p2 = p[k][2];
-            const uint8_t p3 = p[k][3];
-            const uint8_t q0 = q[k][0];
-            const uint8_t q1 = q[k][1];
-            const uint8_t q2 = q[k][2];
-            const uint8_t q3 = q[k][3];
+            const pixel_t p0 = p[k][0];
+            const pixel_t p1 = p[k][1];
+            const pixel_t p2 = p[k][2];
+            const pixel_t p3 = p[k][3];
+            const pixel_t q0 = q[k][0];
+            const pixel_t q1 = q[k][1];
+            const pixel_t q2 = q[k][2];
+            const pixel_t q3 = q[k][3];
 
             if (dE==2) {
               // strong filtering
 
               //nDp=nDq=3;
 
-              uint8_t pnew[3],qnew[3];
+              pixel_t pnew[3],qnew[3];
               pnew[0] = Clip3(p0-2*tc,p0+2*tc, (p2 + 2*p1 + 2*p0 + 2*q0 + q1 +4)>>3);
               pnew[1] = Clip3(p1-2*tc,p1+2*tc, (p2 + p1 + p0 + q0+2)>>2);
               pnew[2] = Clip3(p2-2*tc,p2+2*tc, (2*p3 + 3*p2 + p1 + p0 + q0 + 4)>>3);
@@ -629,18 +624,18 @@ void edge_filtering_luma(de265_image* img, bool vertical,
                 delta = Clip3(-tc,tc,delta);
                 logtrace(LogDeblock," deblk + %d;%d [%02x->%02x]  - %d;%d [%02x->%02x] delta:%d\n",
                          vertical ? xDi-1 : xDi+k,
-                         vertical ? yDi+k : yDi-1, p0,Clip1_8bit(p0+delta),
+                         vertical ? yDi+k : yDi-1, p0,Clip_BitDepth(p0+delta, bitDepth_Y),
                          vertical ? xDi   : xDi+k,
-                         vertical ? yDi+k : yDi, q0,Clip1_8bit(q0-delta),
+                         vertical ? yDi+k : yDi, q0,Clip_BitDepth(q0-delta, bitDepth_Y),
                          delta);
 
                 if (vertical) {
-                  if (filterP) { ptr[-0-1+k*stride] = Clip1_8bit(p0+delta); }
-                  if (filterQ) { ptr[ 0  +k*stride] = Clip1_8bit(q0-delta); }
+                  if (filterP) { ptr[-0-1+k*stride] = Clip_BitDepth(p0+delta, bitDepth_Y); }
+                  if (filterQ) { ptr[ 0  +k*stride] = Clip_BitDepth(q0-delta, bitDepth_Y); }
                 }
                 else {
-                  if (filterP) { ptr[ k -1*stride] = Clip1_8bit(p0+delta); }
-                  if (filterQ) { ptr[ k +0*stride] = Clip1_8bit(q0-delta); }
+                  if (filterP) { ptr[ k -1*stride] = Clip_BitDepth(p0+delta, bitDepth_Y); }
+                  if (filterQ) { ptr[ k +0*stride] = Clip_BitDepth(q0-delta, bitDepth_Y); }
                 }
 
                 //ptr[ 0+k*stride] = 200;
@@ -653,8 +648,8 @@ void edge_filtering_luma(de265_image* img, bool vertical,
                            vertical ? yDi+k : yDi-2,
                            delta_p);
 
-                  if (vertical) { ptr[-1-1+k*stride] = Clip1_8bit(p1+delta_p); }
-                  else          { ptr[ k  -2*stride] = Clip1_8bit(p1+delta_p); }
+                  if (vertical) { ptr[-1-1+k*stride] = Clip_BitDepth(p1+delta_p, bitDepth_Y); }
+                  else          { ptr[ k  -2*stride] = Clip_BitDepth(p1+delta_p, bitDepth_Y); }
                 }
 
                 if (dEq==1 && filterQ) {
@@ -665,8 +660,8 @@ void edge_filtering_luma(de265_image* img, bool vertical,
                            vertical ? yDi+k : yDi+1,
                            delta_q);
 
-                  if (vertical) { ptr[ 1  +k*stride] = Clip1_8bit(q1+delta_q); }
-                  else          { ptr[ k  +1*stride] = Clip1_8bit(q1+delta_q); }
+                  if (vertical) { ptr[ 1  +k*stride] = Clip_BitDepth(q1+delta_q, bitDepth_Y); }
+                  else          { ptr[ k  +1*stride] = Clip_BitDepth(q1+delta_q, bitDepth_Y); }
                 }
 
                 //nDp = dEp+1;
@@ -682,6 +677,18 @@ void edge_filtering_luma(de265_image* img, bool vertical,
 }
 
 
+void edge_filtering_luma(de265_image* img, bool vertical,
+                         int yStart,int yEnd, int xStart,int xEnd)
+{
+  if (img->high_bit_depth(0)) {
+    edge_filtering_luma_internal<uint16_t>(img,vertical,yStart,yEnd,xStart,xEnd);
+  }
+  else {
+    edge_filtering_luma_internal<uint8_t>(img,vertical,yStart,yEnd,xStart,xEnd);
+  }
+}
+
+
 void edge_filtering_luma_CTB(de265_image* img, bool vertical, int xCtb,int yCtb)
 {
   int ctbSize = img->sps.CtbSizeY;
@@ -696,14 +703,17 @@ void edge_filtering_luma_CTB(de265_image* img, bool vertical, int xCtb,int yCtb)
 
 
 // 8.7.2.4
-void edge_filtering_chroma(de265_image* img, bool vertical, int yStart,int yEnd,
-                           int xStart,int xEnd)
+template <class pixel_t>
+static void edge_filtering_chroma_internal(de265_image* img, bool vertical,
+                                           int yStart,int yEnd, int xStart,int xEnd)
 {
   int xIncr = vertical ? 4 : 2;
   int yIncr = vertical ? 2 : 4;
 
   const int stride = img->get_image_stride(1);
 
+  const int bitDepth_C = img->sps.BitDepth_C;
+
   xEnd = libde265_min(xEnd,img->get_deblk_width());
   yEnd = libde265_min(yEnd,img->get_deblk_height());
 
@@ -711,7 +721,7 @@ void edge_filtering_chroma(de265_image* img, bool vertical, int yStart,int yEnd,
     for (int x=xStart;x<xEnd;x+=xIncr) {
       int xDi = x*2;
       int yDi = y*2;
-      int bS = img->get_deblk_bS(2*xDi,2*yDi);
+      int bS = img->get_deblk_bS(2*xDi,2*yDi, vertical);
 
       if (bS>1) {
         // 8.7.2.4.5
@@ -721,10 +731,10 @@ void edge_filtering_chroma(de265_image* img, bool vertical, int yStart,int yEnd,
                               img->pps.pic_cb_qp_offset :
                               img->pps.pic_cr_qp_offset);
 
-          uint8_t* ptr = img->get_image_plane_at_pos(cplane+1, xDi,yDi);
+          pixel_t* ptr = (pixel_t*)img->get_image_plane_at_pos(cplane+1, xDi,yDi);
 
-          uint8_t p[2][4];
-          uint8_t q[2][4];
+          pixel_t p[2][4];
+          pixel_t q[2][4];
 
           logtrace(LogDeblock,"-%s- %d %d\n",cplane==0 ? "Cb" : "Cr",xDi,yDi);
 
@@ -776,7 +786,7 @@ void edge_filtering_chroma(de265_image* img, bool vertical, int yStart,int yEnd,
           int Q = Clip3(0,53, QP_C + 2*(bS-1) + tc_offset);
 
           int tcPrime = table_8_23_tc[Q];
-          int tc = tcPrime * (1<<(img->sps.BitDepth_C - 8));
+          int tc = tcPrime * (1<<(bitDepth_C - 8));
 
           logtrace(LogDeblock,"tc_offset=%d Q=%d tc'=%d tc=%d\n",tc_offset,Q,tcPrime,tc);
 
@@ -793,8 +803,8 @@ void edge_filtering_chroma(de265_image* img, bool vertical, int yStart,int yEnd,
             for (int k=0;k<4;k++) {
               int delta = Clip3(-tc,tc, ((((q[0][k]-p[0][k])<<2)+p[1][k]-q[1][k]+4)>>3));
               logtrace(LogDeblock,"delta=%d\n",delta);
-              if (filterP) { ptr[-1+k*stride] = Clip1_8bit(p[0][k]+delta); }
-              if (filterQ) { ptr[ 0+k*stride] = Clip1_8bit(q[0][k]-delta); }
+              if (filterP) { ptr[-1+k*stride] = Clip_BitDepth(p[0][k]+delta, bitDepth_C); }
+              if (filterQ) { ptr[ 0+k*stride] = Clip_BitDepth(q[0][k]-delta, bitDepth_C); }
             }
           }
           else {
@@ -808,8 +818,8 @@ void edge_filtering_chroma(de265_image* img, bool vertical, int yStart,int yEnd,
 
             for (int k=0;k<4;k++) {
               int delta = Clip3(-tc,tc, ((((q[0][k]-p[0][k])<<2)+p[1][k]-q[1][k]+4)>>3));
-              if (filterP) { ptr[ k-1*stride] = Clip1_8bit(p[0][k]+delta); }
-              if (filterQ) { ptr[ k+0*stride] = Clip1_8bit(q[0][k]-delta); }
+              if (filterP) { ptr[ k-1*stride] = Clip_BitDepth(p[0][k]+delta, bitDepth_C); }
+              if (filterQ) { ptr[ k+0*stride] = Clip_BitDepth(q[0][k]-delta, bitDepth_C); }
             }
           }
         }
@@ -817,6 +827,18 @@ void edge_filtering_chroma(de265_image* img, bool vertical, int yStart,int yEnd,
     }
 }
 
+
+void edge_filtering_chroma(de265_image* img, bool vertical, int yStart,int yEnd,
+                           int xStart,int xEnd)
+{
+  if (img->high_bit_depth(1)) {
+    edge_filtering_chroma_internal<uint16_t>(img,vertical,yStart,yEnd,xStart,xEnd);
+  }
+  else {
+    edge_filtering_chroma_internal<uint8_t>(img,vertical,yStart,yEnd,xStart,xEnd);
+  }
+}
+
 void edge_filtering_chroma_CTB(de265_image* img, bool vertical, int xCtb,int yCtb)
 {
   int ctbSize = img->sps.CtbSizeY;
@@ -837,6 +859,11 @@ public:
   bool vertical;
 
   virtual void work();
+  virtual void describe(task_trace_event* ev) const {
+    ev->name  = vertical ? "deblock vertical" : "deblock horizontal";
+    ev->index = ctb_y;
+    ev->POC   = img->PicOrderCntVal;
+  }
 };
 
 
@@ -886,20 +913,19 @@ void thread_task_deblock_CTBRow::work()
 
   bool deblocking_enabled;
 
-  // first pass: check edge flags and whether we have to deblock
+  // Edges inside of the CTBs have been derived during decoding. In the first pass,
+  // complete the CTB boundaries and check whether we have to deblock at all.
   if (vertical) {
-    deblocking_enabled = derive_edgeFlags_CTBRow(img, ctb_y);
-
-    //for (int x=0;x<=rightCtb;x++) {
-    int x=0; img->set_CtbDeblockFlag(x,ctb_y, deblocking_enabled);
-    //}
+    deblocking_enabled = derive_CTB_boundary_edges(img, ctb_y);
   }
   else {
-    int x=0; deblocking_enabled=img->get_CtbDeblockFlag(x,ctb_y);
+    deblocking_enabled = false;
+    for (int x=0;x<=rightCtb;x++) {
+      deblocking_enabled |= img->get_CtbDeblockFlag(x,ctb_y);
+    }
   }
 
   if (deblocking_enabled) {
-    derive_boundaryStrength(img, vertical, first,last, xStart,xEnd);
     edge_filtering_luma    (img, vertical, first,last, xStart,xEnd);
     edge_filtering_chroma  (img, vertical, first,last, xStart,xEnd);
   }
@@ -909,6 +935,10 @@ void thread_task_deblock_CTBRow::work()
     img->ctb_progress[x+ctb_y*CtbWidth].set_progress(finalProgress);
   }
 
+  if (!vertical) {
+    img->output_finished_rows();
+  }
+
   state = Finished;
   img->thread_finishes();
 }
@@ -928,7 +958,7 @@ void add_deblocking_tasks(image_unit* imgunit)
     {
       for (int y=0;y<img->sps.PicHeightInCtbsY;y++)
         {
-          thread_task_deblock_CTBRow* task = new thread_task_deblock_CTBRow;
+          thread_task_deblock_CTBRow* task = ctx->task_arena.get_task<thread_task_deblock_CTBRow>();
 
           task->img   = img;
           task->ctb_y = y;
@@ -946,14 +976,17 @@ void apply_deblocking_filter(de265_image* img) // decoder_context* ctx)
 {
   decoder_context* ctx = img->decctx;
 
-  char enabled_deblocking = derive_edgeFlags(img);
+  bool enabled_deblocking = false;
+
+  for (int y=0;y<img->sps.PicHeightInCtbsY;y++) {
+    enabled_deblocking |= derive_CTB_boundary_edges(img,y);
+  }
 
   if (enabled_deblocking)
     {
       // vertical filtering
 
       logtrace(LogDeblock,"VERTICAL\n");
-      derive_boundaryStrength(img, true ,0,img->get_deblk_height(),0,img->get_deblk_width());
       edge_filtering_luma    (img, true ,0,img->get_deblk_height(),0,img->get_deblk_width());
       edge_filtering_chroma  (img, true ,0,img->get_deblk_height(),0,img->get_deblk_width());
 
@@ -966,7 +999,6 @@ void apply_deblocking_filter(de265_image* img) // decoder_context* ctx)
       // horizontal filtering
 
       logtrace(LogDeblock,"HORIZONTAL\n");
-      derive_boundaryStrength(img, false ,0,img->get_deblk_height(),0,img->get_deblk_width());
       edge_filtering_luma    (img, false ,0,img->get_deblk_height(),0,img->get_deblk_width());
       edge_filtering_chroma  (img, false ,0,img->get_deblk_height(),0,img->get_deblk_width());
 
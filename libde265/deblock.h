@@ -23,6 +23,9 @@
 
 #include "libde265/decctx.h"
 
+void derive_deblocking_CU(de265_image* img, const slice_segment_header* shdr,
+                          int x0,int y0, int log2CbSize);
+
 void add_deblocking_tasks(image_unit* imgunit);
 void apply_deblocking_filter(de265_image* img); //decoder_context* ctx);
 
@@ -114,6 +114,8 @@ thread_context::thread_context()
   img = NULL;
   shdr = NULL;
 
+  pipeline = NULL;
+  syntax_buffer = NULL;
 
   //memset(this,0,sizeof(thread_context));
 
@@ -133,12 +135,11 @@ thread_context::thread_context()
 
 
 slice_unit::slice_unit(decoder_context* decctx)
-  : ctx(decctx),
-    nal(NULL),
+  : nal(NULL),
     shdr(NULL),
+    imgunit(NULL),
     flush_reorder_buffer(false),
-    thread_contexts(NULL),
-    imgunit(NULL)
+    ctx(decctx)
 {
   state = Unprocessed;
 }
@@ -147,17 +148,20 @@ slice_unit::~slice_unit()
 {
   ctx->nal_parser.free_NAL_unit(nal);
 
-  if (thread_contexts) {
-    delete[] thread_contexts;
+  for (size_t i=0;i<thread_contexts.size();i++) {
+    ctx->release_thread_context(thread_contexts[i]);
   }
 }
 
 
 void slice_unit::allocate_thread_contexts(int n)
 {
-  assert(thread_contexts==NULL);
+  assert(thread_contexts.empty());
 
-  thread_contexts = new thread_context[n];
+  thread_contexts.resize(n);
+  for (int i=0;i<n;i++) {
+    thread_contexts[i] = ctx->acquire_thread_context();
+  }
 }
 
 
@@ -166,6 +170,8 @@ image_unit::image_unit()
   img=NULL;
   role=Invalid;
   state=Unprocessed;
+  filtered=false;
+  decode_start_time=0;
 }
 
 
@@ -176,7 +182,7 @@ image_unit::~image_unit()
   }
 
   for (int i=0;i<tasks.size();i++) {
-    delete tasks[i];
+    tasks[i]->release();
   }
 }
 
@@ -193,6 +199,17 @@ decoder_context::decoder_context()
 
   param_disable_deblocking = false;
   param_disable_sao = false;
+  param_decoupled_reconstruction = false;
+  param_decode_irap_only = false;
+  param_low_latency = false;
+  param_release_metadata = false;
+  param_tiled_references = false;
+  param_huge_pages = true;
+  param_parse_only = false;
+  param_keep_motion_field = false;
+  param_trace_tasks = false;
+  param_roi_x = param_roi_y = 0;
+  param_roi_width = param_roi_height = 0;
   //param_disable_mc_residual_idct = false;
   //param_disable_intra_residual_idct = false;
 
@@ -208,6 +225,14 @@ decoder_context::decoder_context()
   param_image_allocation_functions = de265_image::default_image_allocation;
   param_image_allocation_userdata  = NULL;
 
+  param_row_output_callback = NULL;
+  param_row_output_userdata = NULL;
+
+  param_ctb_statistics_callback = NULL;
+  param_ctb_statistics_userdata = NULL;
+
+  param_numa_node = -1;
+
   /*
   memset(&vps, 0, sizeof(video_parameter_set)*DE265_MAX_VPS_SETS);
   memset(&sps, 0, sizeof(seq_parameter_set)  *DE265_MAX_SPS_SETS);
@@ -219,6 +244,8 @@ decoder_context::decoder_context()
   current_sps = NULL;
   current_pps = NULL;
 
+  previous_slice_header = NULL;
+
   //memset(&thread_pool,0,sizeof(struct thread_pool));
   num_worker_threads = 0;
 
@@ -234,6 +261,18 @@ decoder_context::decoder_context()
 
   compute_framedrop_table();
 
+  presentation_clock = NULL;
+  presentation_clock_userdata = NULL;
+  pts_per_second = 1;
+
+  deadline_HighestTid = 6;
+  deadline_skip_RASL = false;
+  deadline_pictures_dropped = 0;
+
+  for (int i=0;i<=6;i++) {
+    decode_time[i] = -1;
+  }
+
 
   //
 
@@ -247,6 +286,12 @@ decoder_context::decoder_context()
   prevPicOrderCntMsb = 0;
   img = NULL;
 
+  seek_pending = false;
+  seek_active  = false;
+  seek_POC_distance = 0;
+  seek_POC = 0;
+  skip_current_picture = false;
+
   /*
   int PocLsbLt[MAX_NUM_REF_PICS];
   int UsedByCurrPicLt[MAX_NUM_REF_PICS];
@@ -303,6 +348,49 @@ decoder_context::~decoder_context()
     delete image_units.back();
     image_units.pop_back();
   }
+
+  while (!hash_check_units.empty()) {
+    delete hash_check_units.back();
+    hash_check_units.pop_back();
+  }
+
+  for (size_t i=0;i<free_thread_contexts.size();i++) {
+    delete free_thread_contexts[i];
+  }
+}
+
+
+thread_context* decoder_context::acquire_thread_context()
+{
+  if (free_thread_contexts.empty()) {
+    return new thread_context;
+  }
+
+  thread_context* tctx = free_thread_contexts.back();
+  free_thread_contexts.pop_back();
+
+  // Reset what the constructor initializes. The coefficient buffer is zero already,
+  // because it is cleared again after each transform block.
+
+  tctx->IsCuQpDeltaCoded = false;
+  tctx->CuQpDelta = 0;
+
+  tctx->decctx = NULL;
+  tctx->img = NULL;
+  tctx->shdr = NULL;
+  tctx->imgunit = NULL;
+  tctx->task = NULL;
+
+  tctx->pipeline = NULL;
+  tctx->syntax_buffer = NULL;
+
+  return tctx;
+}
+
+
+void decoder_context::release_thread_context(thread_context* tctx)
+{
+  free_thread_contexts.push_back(tctx);
 }
 
 
@@ -324,11 +412,20 @@ void decoder_context::set_image_allocation_functions(de265_image_allocation* all
 
 de265_error decoder_context::start_thread_pool(int nThreads)
 {
-  ::start_thread_pool(&thread_pool, nThreads);
+  // without explicit pinning, keep the workers on the CPUs of the NUMA node
 
-  num_worker_threads = nThreads;
+  std::vector<int> cpus = param_worker_cpus;
+  if (cpus.empty() && param_numa_node >= 0) {
+    de265_numa_get_node_cpus(param_numa_node, &cpus);
+  }
 
-  return DE265_OK;
+  thread_pool.trace_tasks = param_trace_tasks;
+
+  de265_error err = ::start_thread_pool(&thread_pool, nThreads, cpus);
+
+  num_worker_threads = thread_pool.num_threads;
+
+  return err;
 }
 
 
@@ -341,8 +438,30 @@ void decoder_context::stop_thread_pool()
 }
 
 
+de265_error decoder_context::write_task_trace(const char* filename)
+{
+  std::vector<task_trace_event> events;
+  int nWorkers = 0;
+
+  // without worker threads, the pool (and its mutex) is not initialized
+
+  if (num_worker_threads>0) {
+    get_task_trace(&thread_pool, &events, &nWorkers);
+  }
+
+  if (!::write_task_trace(filename, events, nWorkers)) {
+    return DE265_ERROR_NO_SUCH_FILE;
+  }
+
+  return DE265_OK;
+}
+
+
 void decoder_context::reset()
 {
+  // the hash tasks have to run before the thread pool is stopped
+  finish_hash_checks();
+
   if (num_worker_threads>0) {
     //flush_thread_pool(&ctx->thread_pool);
     ::stop_thread_pool(&thread_pool);
@@ -386,6 +505,13 @@ void decoder_context::reset()
   current_image_poc_lsb = -1; // any invalid number
   first_decoded_picture = true;
 
+  seek_pending = false;
+  seek_active  = false;
+  skip_current_picture = false;
+
+  deadline_HighestTid = 6;
+  deadline_skip_RASL = false;
+
 
   // --- remove all pictures from output queue ---
 
@@ -435,8 +561,8 @@ void decoder_context::set_acceleration_functions(enum de265_acceleration l)
 
 void decoder_context::init_thread_context(thread_context* tctx)
 {
-  // zero scrap memory for coefficient blocks
-  memset(tctx->_coeffBuf, 0, sizeof(tctx->_coeffBuf));  // TODO: check if we can safely remove this
+  // The scrap memory for coefficient blocks is zeroed when the thread_context is
+  // constructed and every transform clears the coefficients it has written.
 
   tctx->currentQG_x = -1;
   tctx->currentQG_y = -1;
@@ -477,7 +603,7 @@ void decoder_context::init_thread_context(thread_context* tctx)
 
 void decoder_context::add_task_decode_CTB_row(thread_context* tctx, bool firstSliceSubstream)
 {
-  thread_task_ctb_row* task = new thread_task_ctb_row;
+  thread_task_ctb_row* task = task_arena.get_task<thread_task_ctb_row>();
   task->firstSliceSubstream = firstSliceSubstream;
   task->tctx = tctx;
   tctx->task = task;
@@ -490,7 +616,7 @@ void decoder_context::add_task_decode_CTB_row(thread_context* tctx, bool firstSl
 
 void decoder_context::add_task_decode_slice_segment(thread_context* tctx, bool firstSliceSubstream)
 {
-  thread_task_slice_segment* task = new thread_task_slice_segment;
+  thread_task_slice_segment* task = task_arena.get_task<thread_task_slice_segment>();
   task->firstSliceSubstream = firstSliceSubstream;
   task->tctx = tctx;
   tctx->task = task;
@@ -501,6 +627,19 @@ void decoder_context::add_task_decode_slice_segment(thread_context* tctx, bool f
 }
 
 
+void decoder_context::add_task_reconstruct(thread_context* tctx, recon_pipeline* pipeline)
+{
+  thread_task_reconstruct* task = task_arena.get_task<thread_task_reconstruct>();
+  task->tctx = tctx;
+  task->pipeline = pipeline;
+  tctx->task = task;
+
+  add_task(&thread_pool, task);
+
+  tctx->imgunit->tasks.push_back(task);
+}
+
+
 de265_error decoder_context::read_vps_NAL(bitreader& reader)
 {
   logdebug(LogHeaders,"---> read VPS\n");
@@ -589,6 +728,47 @@ de265_error decoder_context::read_eos_NAL(bitreader& reader)
   return DE265_OK;
 }
 
+/* Pictures without WPP or tiles can only use multithreading by decoding several
+   slice segments at the same time.
+ */
+static bool use_slice_parallel_decoding(const de265_image* img)
+{
+  return (img != NULL &&
+          img->decctx->get_num_worker_threads() > 0 &&
+          img->pps.entropy_coding_sync_enabled_flag == false &&
+          img->pps.tiles_enabled_flag == false);
+}
+
+
+/* A dependent slice segment continues the CABAC state and QP of the segment before it,
+   which is only known after that segment has been decoded.
+ */
+static bool has_dependent_slice_segments(const image_unit* imgunit)
+{
+  for (size_t i=0;i<imgunit->slice_units.size();i++) {
+    if (imgunit->slice_units[i]->shdr->dependent_slice_segment_flag) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+// slice segment NAL that belongs to the same picture as the previous slice segment
+static bool is_continuing_slice_NAL(const NAL_unit* nal)
+{
+  if (nal==NULL || nal->size() < 3) {
+    return false;
+  }
+
+  int nal_unit_type = (nal->data()[0] >> 1) & 0x3F;
+  bool first_slice_segment_in_pic_flag = (nal->data()[2] & 0x80);
+
+  return nal_unit_type < 32 && !first_slice_segment_in_pic_flag;
+}
+
+
 de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, nal_header& nal_hdr)
 {
   logdebug(LogHeaders,"---> read slice segment header\n");
@@ -610,6 +790,12 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
     shdr->dump_slice_segment_header(this, param_slice_headers_fd);
   }
 
+  if (skip_picture(shdr, nal_hdr, nal->pts)) {
+    nal_parser.free_NAL_unit(nal);
+    delete shdr;
+    return DE265_OK;
+  }
+
 
   if (process_slice_segment_header(this, shdr, &err, nal->pts, &nal_hdr, nal->user_data) == false)
     {
@@ -659,12 +845,171 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
     image_units.back()->slice_units.push_back(sliceunit);
   }
 
+
+  // When the slices of this picture can be decoded in parallel, do not start decoding
+  // as long as the next queued NAL is another slice segment of the same picture.
+
+  if (use_slice_parallel_decoding(this->img) &&
+      is_continuing_slice_NAL(nal_parser.peek_NAL_queue())) {
+    return DE265_OK;
+  }
+
   decode_some();
 
   return DE265_OK;
 }
 
 
+void decoder_context::seek(int POC_distance)
+{
+  reset();
+
+  seek_pending = true;
+  seek_POC_distance = POC_distance;
+}
+
+
+/* Decide at the first slice segment whether the picture can be dropped without
+   allocating it in the DPB. The other slice segments of the picture follow that decision.
+ */
+bool decoder_context::skip_picture(const slice_segment_header* shdr, const nal_header& nal_hdr,
+                                   de265_PTS pts)
+{
+  if (!shdr->first_slice_segment_in_pic_flag) {
+    return skip_current_picture;
+  }
+
+  uint8_t type = nal_hdr.nal_unit_type;
+
+  skip_current_picture = false;
+
+  // RASL pictures associated with an IRAP that starts decoding cannot be decoded correctly
+
+  if (isRASL(type) && (NoRaslOutputFlag || first_decoded_picture)) {
+    skip_current_picture = true;
+  }
+
+  // when seeking, sub-layer non-reference pictures in the highest sub-layer that
+  // precede the seek target are not needed
+
+  else if (seek_active && !isReferenceNALU(type)) {
+    const pic_parameter_set* pps = get_pps(shdr->slice_pic_parameter_set_id);
+    const seq_parameter_set* sps = get_sps(pps->seq_parameter_set_id);
+
+    if (nal_hdr.nuh_temporal_id == sps->sps_max_sub_layers-1) {
+      int POC = derive_PicOrderCntMsb(shdr->slice_pic_order_cnt_lsb,
+                                      prevPicOrderCntLsb, prevPicOrderCntMsb,
+                                      sps->MaxPicOrderCntLsb) + shdr->slice_pic_order_cnt_lsb;
+
+      skip_current_picture = (POC < seek_POC);
+    }
+  }
+
+  // pictures that would be displayed too late are dropped if nothing depends on them
+
+  else if (presentation_clock) {
+    const pic_parameter_set* pps = get_pps(shdr->slice_pic_parameter_set_id);
+    const seq_parameter_set* sps = get_sps(pps->seq_parameter_set_id);
+
+    skip_current_picture = drop_late_picture(nal_hdr, sps, pts);
+  }
+
+  return skip_current_picture;
+}
+
+
+void decoder_context::set_presentation_clock(de265_presentation_clock clock, void* userdata,
+                                             de265_PTS pts_per_second)
+{
+  presentation_clock = clock;
+  presentation_clock_userdata = userdata;
+  this->pts_per_second = std::max(pts_per_second, (de265_PTS)1);
+
+  deadline_HighestTid = 6;
+  deadline_skip_RASL = false;
+}
+
+
+bool decoder_context::drop_late_picture(const nal_header& nal_hdr, const seq_parameter_set* sps,
+                                        de265_PTS pts)
+{
+  const uint8_t type = nal_hdr.nal_unit_type;
+  const int tid = nal_hdr.nuh_temporal_id;
+  const int highestTid = sps->sps_max_sub_layers-1;
+
+  // At an IRAP picture, all layers can be decoded again. The RASL pictures of a CRA
+  // may reference pictures of layers that have been dropped, so they are dropped too.
+
+  if (isIRAP(type)) {
+    deadline_skip_RASL = (isCRA(type) && deadline_HighestTid < highestTid);
+    deadline_HighestTid = highestTid;
+    return false;
+  }
+
+  if (isRASL(type) && deadline_skip_RASL) {
+    deadline_pictures_dropped++;
+    return true;
+  }
+
+  deadline_HighestTid = std::min(deadline_HighestTid, highestTid);
+
+  double timeLeft = (pts - presentation_clock(presentation_clock_userdata)) / (double)pts_per_second;
+  double needed = std::max(decode_time[tid], 0.0f);
+
+  // Switch up one layer at a TSA/STSA picture if there is time for it. Pictures of that
+  // layer following a TSA/STSA do not reference earlier pictures of the layer.
+
+  if (tid == deadline_HighestTid+1 &&
+      type >= NAL_UNIT_TSA_N && type <= NAL_UNIT_STSA_R &&
+      timeLeft > 2*needed) {
+    deadline_HighestTid = tid;
+  }
+
+  bool drop;
+
+  if (tid > deadline_HighestTid) {
+    drop = true;
+  }
+  else if (timeLeft >= needed) {
+    drop = false;
+  }
+  else if (!isReferenceNALU(type) && tid == deadline_HighestTid) {
+    // sub-layer non-reference pictures are only referenced from higher layers
+    drop = true;
+  }
+  else if (tid > 0) {
+    // stop decoding this layer until the next switching point
+    deadline_HighestTid = tid-1;
+    drop = true;
+  }
+  else {
+    drop = false; // the base layer is always decoded
+  }
+
+  if (drop) {
+    deadline_pictures_dropped++;
+  }
+
+  return drop;
+}
+
+
+void decoder_context::measure_decode_time(const image_unit* imgunit)
+{
+  if (imgunit->decode_start_time == 0) {
+    return;
+  }
+
+  int tid = imgunit->img->nal_hdr.nuh_temporal_id;
+  float t = (de265_get_time_usec() - imgunit->decode_start_time) * 0.000001f;
+
+  // exponential average, such that the estimate follows changes of the CPU load
+
+  if (decode_time[tid] < 0) { decode_time[tid] = t; }
+  else                      { decode_time[tid] = 0.8f*decode_time[tid] + 0.2f*t; }
+}
+
+
 template <class T> void pop_front(std::vector<T>& vec)
 {
   for (int i=1;i<vec.size();i++)
@@ -692,21 +1037,45 @@ de265_error decoder_context::decode_some()
   if ( ! image_units.empty() && ! image_units[0]->slice_units.empty() ) {
 
     image_unit* imgunit = image_units[0];
-    slice_unit* sliceunit = imgunit->slice_units[0];
-
-    pop_front(imgunit->slice_units);
 
-    if (sliceunit->flush_reorder_buffer) {
-      dpb.flush_reorder_buffer();
+    if (imgunit->decode_start_time == 0 && presentation_clock) {
+      imgunit->decode_start_time = de265_get_time_usec();
     }
 
-    //err = decode_slice_unit_sequential(imgunit, sliceunit);
-    err = decode_slice_unit_parallel(imgunit, sliceunit);
-    if (err) {
-      return err;
+    // decode all independent slices that we have of this picture in parallel
+
+    if (use_slice_parallel_decoding(imgunit->img) &&
+        imgunit->slice_units.size() > 1 &&
+        !has_dependent_slice_segments(imgunit)) {
+      err = decode_slice_units_parallel(imgunit);
+      if (err) {
+        return err;
+      }
     }
+    else {
+      slice_unit* sliceunit = imgunit->slice_units[0];
+
+      pop_front(imgunit->slice_units);
+
+      de265_error hash_err = DE265_OK;
+
+      if (sliceunit->flush_reorder_buffer) {
+        hash_err = finish_hash_checks();
+        dpb.flush_reorder_buffer();
+      }
+
+      //err = decode_slice_unit_sequential(imgunit, sliceunit);
+      err = decode_slice_unit_parallel(imgunit, sliceunit);
+      if (err) {
+        return err;
+      }
 
-    delete sliceunit;
+      delete sliceunit;
+
+      if (hash_err) {
+        return hash_err;
+      }
+    }
   }
 
 
@@ -728,33 +1097,84 @@ de265_error decoder_context::decode_some()
     // so we will have to replace this with keeping track of which CTB should have
     // been decoded (but aren't because of the input stream being faulty)
 
-    imgunit->img->mark_all_CTB_progress(CTB_PROGRESS_PREFILTER);
+    if (!imgunit->filtered) {
+      imgunit->img->mark_all_CTB_progress(CTB_PROGRESS_PREFILTER);
 
 
 
-    // run post-processing filters (deblocking & SAO)
+      // run post-processing filters (deblocking & SAO)
 
-    if (img->decctx->num_worker_threads)
-      run_postprocessing_filters_parallel(imgunit);
-    else
-      run_postprocessing_filters_sequential(imgunit->img);
+      if (img->decctx->num_worker_threads)
+        run_postprocessing_filters_parallel(imgunit);
+      else
+        run_postprocessing_filters_sequential(imgunit->img);
+    }
 
-    // process suffix SEIs
+    // rows that are not final yet (e.g. sequential filtering) are output now
 
-    for (int i=0;i<imgunit->suffix_SEIs.size();i++) {
-      const sei_message& sei = imgunit->suffix_SEIs[i];
+    imgunit->img->output_finished_rows(true);
 
-      err = process_sei(&sei, imgunit->img);
-      if (err != DE265_OK)
-        break;
+    if (presentation_clock) {
+      measure_decode_time(imgunit);
     }
 
+    // keep only the subsampled motion field that is needed for TMVP in later pictures
 
-    push_picture_to_output_queue(imgunit);
+    imgunit->img->compress_motion_field(param_keep_motion_field);
 
-    // remove just decoded image unit from queue
+    // Sub-layer non-reference pictures of the highest sub-layer are never used for prediction.
 
-    delete imgunit;
+    de265_image* outimg = imgunit->img;
+
+    bool mayBeReferenced = (isReferenceNALU(outimg->nal_hdr.nal_unit_type) ||
+                            outimg->nal_hdr.nuh_temporal_id < outimg->sps.sps_max_sub_layers-1);
+
+    if (param_tiled_references && mayBeReferenced && !param_parse_only) {
+      build_tiled_reference(imgunit);
+    }
+
+    // Only the pixels and, if the picture can still be referenced, the motion field are
+    // needed from here on.
+
+    if (param_release_metadata) {
+      if (previous_slice_header &&
+          previous_slice_header->slice_index < (int)outimg->slices.size() &&
+          outimg->slices[previous_slice_header->slice_index] == previous_slice_header) {
+        previous_slice_header = NULL;
+      }
+
+      outimg->release_metadata(mayBeReferenced);
+    }
+
+    // the hash check of the previous picture has overlapped with decoding this one
+
+    err = finish_hash_checks();
+
+
+    // process suffix SEIs. With worker threads, the hash is verified in the background
+    // and the picture is output when the next picture has been decoded.
+
+    if (param_sei_check_hash && !param_parse_only && num_worker_threads>0 && !param_low_latency &&
+        add_sei_hash_tasks(imgunit)) {
+      hash_check_units.push_back(imgunit);
+    }
+    else {
+      for (int i=0;i<imgunit->suffix_SEIs.size();i++) {
+        const sei_message& sei = imgunit->suffix_SEIs[i];
+
+        de265_error sei_err = process_sei(&sei, imgunit->img);
+        if (sei_err != DE265_OK) {
+          err = sei_err;
+          break;
+        }
+      }
+
+      push_picture_to_output_queue(imgunit);
+
+      delete imgunit;
+    }
+
+    // remove just decoded image unit from queue
 
     pop_front(image_units);
   }
@@ -763,6 +1183,30 @@ de265_error decoder_context::decode_some()
 }
 
 
+de265_error decoder_context::finish_hash_checks()
+{
+  de265_error err = DE265_OK;
+
+  for (size_t i=0;i<hash_check_units.size();i++) {
+    image_unit* imgunit = hash_check_units[i];
+
+    imgunit->img->wait_for_completion();
+
+    if (!imgunit->img->sei_hash_check_result) {
+      err = DE265_ERROR_CHECKSUM_MISMATCH;
+    }
+
+    push_picture_to_output_queue(imgunit);
+
+    delete imgunit;
+  }
+
+  hash_check_units.clear();
+
+  return err;
+}
+
+
 de265_error decoder_context::decode_slice_unit_sequential(image_unit* imgunit,
                                                           slice_unit* sliceunit)
 {
@@ -778,7 +1222,9 @@ de265_error decoder_context::decode_slice_unit_sequential(image_unit* imgunit,
   remove_images_from_dpb(sliceunit->shdr->RemoveReferencesList);
 
 
-  struct thread_context tctx;
+  sliceunit->allocate_thread_contexts(1);
+
+  thread_context& tctx = *sliceunit->get_thread_context(0);
 
   tctx.shdr = sliceunit->shdr;
   tctx.img  = imgunit->img;
@@ -800,6 +1246,10 @@ de265_error decoder_context::decode_slice_unit_sequential(image_unit* imgunit,
     imgunit->ctx_models.resize( (img->sps.PicHeightInCtbsY-1) * CONTEXT_MODEL_TABLE_LENGTH );
   }
 
+  if (param_decoupled_reconstruction && num_worker_threads > 0) {
+    return decode_slice_unit_pipelined(imgunit, sliceunit, &tctx);
+  }
+
   if ((err=read_slice_segment_data(&tctx)) != DE265_OK)
     { return err; }
 
@@ -807,6 +1257,55 @@ de265_error decoder_context::decode_slice_unit_sequential(image_unit* imgunit,
 }
 
 
+/* Parse the slice segment in the calling thread while a worker thread reconstructs
+   the CTBs that have already been parsed.
+ */
+de265_error decoder_context::decode_slice_unit_pipelined(image_unit* imgunit,
+                                                         slice_unit* sliceunit,
+                                                         thread_context* tctx)
+{
+  de265_image* img = imgunit->img;
+
+  recon_pipeline pipeline;
+
+
+  // prepare reconstruction thread context
+
+  thread_context* recon_tctx = acquire_thread_context();
+
+  recon_tctx->shdr = sliceunit->shdr;
+  recon_tctx->img  = img;
+  recon_tctx->decctx = this;
+  recon_tctx->imgunit = imgunit;
+
+  assert(img->num_threads_active() == 0);
+  img->thread_start(1);
+
+  add_task_reconstruct(recon_tctx, &pipeline);
+
+
+  // parse
+
+  tctx->pipeline = &pipeline;
+
+  de265_error err = read_slice_segment_data(tctx);
+
+  tctx->pipeline = NULL;
+  pipeline.end_of_data();
+
+
+  img->wait_for_completion();
+
+  for (size_t i=0;i<imgunit->tasks.size();i++)
+    imgunit->tasks[i]->release();
+  imgunit->tasks.clear();
+
+  release_thread_context(recon_tctx);
+
+  return err;
+}
+
+
 de265_error decoder_context::decode_slice_unit_parallel(image_unit* imgunit,
                                                         slice_unit* sliceunit)
 {
@@ -829,7 +1328,9 @@ de265_error decoder_context::decode_slice_unit_parallel(image_unit* imgunit,
   // TODO: remove this warning later when we do frame-parallel decoding
   if (img->decctx->num_worker_threads > 0 &&
       pps->entropy_coding_sync_enabled_flag == false &&
-      pps->tiles_enabled_flag == false) {
+      pps->tiles_enabled_flag == false &&
+      sliceunit->shdr->first_slice_segment_in_pic_flag &&
+      imgunit->slice_units.empty()) {
 
     img->decctx->add_warning(DE265_WARNING_NO_WPP_CANNOT_USE_MULTITHREADING, true);
   }
@@ -859,6 +1360,78 @@ de265_error decoder_context::decode_slice_unit_parallel(image_unit* imgunit,
 }
 
 
+/* Decode all queued slice segments of the picture at once, one task per slice segment.
+   Only used for pictures that consist of independent slice segments, which have no
+   parsing dependencies on each other. Pictures with dependent slice segments are
+   decoded sequentially.
+ */
+de265_error decoder_context::decode_slice_units_parallel(image_unit* imgunit)
+{
+  de265_image* img = imgunit->img;
+  const pic_parameter_set* pps = &img->pps;
+
+  int nSlices = imgunit->slice_units.size();
+
+  de265_error hash_err = DE265_OK;
+
+  for (int i=0;i<nSlices;i++) {
+    slice_unit* sliceunit = imgunit->slice_units[i];
+
+    if (sliceunit->flush_reorder_buffer) {
+      hash_err = finish_hash_checks();
+      dpb.flush_reorder_buffer();
+    }
+
+    remove_images_from_dpb(sliceunit->shdr->RemoveReferencesList);
+  }
+
+
+  assert(img->num_threads_active() == 0);
+  img->thread_start(nSlices);
+
+  for (int i=0;i<nSlices;i++) {
+    slice_unit* sliceunit = imgunit->slice_units[i];
+    slice_segment_header* shdr = sliceunit->shdr;
+
+    sliceunit->allocate_thread_contexts(1);
+
+
+    // prepare thread context
+
+    thread_context* tctx = sliceunit->get_thread_context(0);
+
+    tctx->shdr    = shdr;
+    tctx->decctx  = img->decctx;
+    tctx->img     = img;
+    tctx->imgunit = imgunit;
+    tctx->CtbAddrInTS = pps->CtbAddrRStoTS[shdr->slice_segment_address];
+
+    init_thread_context(tctx);
+
+    init_CABAC_decoder(&tctx->cabac_decoder,
+                       sliceunit->reader.data,
+                       sliceunit->reader.bytes_remaining);
+
+    // add task
+
+    add_task_decode_slice_segment(tctx, true);
+  }
+
+  img->wait_for_completion();
+
+  for (size_t i=0;i<imgunit->tasks.size();i++)
+    imgunit->tasks[i]->release();
+  imgunit->tasks.clear();
+
+  for (int i=0;i<nSlices;i++) {
+    delete imgunit->slice_units[i];
+  }
+  imgunit->slice_units.clear();
+
+  return hash_err;
+}
+
+
 de265_error decoder_context::decode_slice_unit_WPP(image_unit* imgunit,
                                                    slice_unit* sliceunit)
 {
@@ -947,15 +1520,58 @@ de265_error decoder_context::decode_slice_unit_WPP(image_unit* imgunit,
   }
 #endif
 
+  // In low-latency mode, filter the CTB rows while the picture is still being decoded.
+  // This requires that this slice segment covers the whole picture.
+
+  if (param_low_latency &&
+      shdr->slice_segment_address == 0 &&
+      nRows == img->sps.PicHeightInCtbsY) {
+    run_postprocessing_filters_parallel(imgunit);
+    imgunit->filtered = true;
+  }
+
   img->wait_for_completion();
 
   for (int i=0;i<imgunit->tasks.size();i++)
-    delete imgunit->tasks[i];
+    imgunit->tasks[i]->release();
   imgunit->tasks.clear();
 
   return DE265_OK;
 }
 
+bool decoder_context::is_tile_outside_ROI(const de265_image* img, int tileID) const
+{
+  if (param_roi_width <= 0 || param_roi_height <= 0) {
+    return false;
+  }
+
+  const seq_parameter_set* sps = &img->sps;
+  const pic_parameter_set* pps = &img->pps;
+
+  // with WPP, the substreams are CTB rows and cannot be skipped per tile
+
+  if (!pps->tiles_enabled_flag || pps->entropy_coding_sync_enabled_flag) {
+    return false;
+  }
+
+  int col = tileID % pps->num_tile_columns;
+  int row = tileID / pps->num_tile_columns;
+
+  int x0 = pps->colBd[col  ] << sps->Log2CtbSizeY;
+  int x1 = pps->colBd[col+1] << sps->Log2CtbSizeY;
+  int y0 = pps->rowBd[row  ] << sps->Log2CtbSizeY;
+  int y1 = pps->rowBd[row+1] << sps->Log2CtbSizeY;
+
+  // the region is given in the cropped output picture
+
+  int roiX = param_roi_x + sps->conf_win_left_offset * sps->SubWidthC;
+  int roiY = param_roi_y + sps->conf_win_top_offset  * sps->SubHeightC;
+
+  return (x1 <= roiX || x0 >= roiX + param_roi_width ||
+          y1 <= roiY || y0 >= roiY + param_roi_height);
+}
+
+
 de265_error decoder_context::decode_slice_unit_tiles(image_unit* imgunit,
                                                      slice_unit* sliceunit)
 {
@@ -968,16 +1584,30 @@ de265_error decoder_context::decode_slice_unit_tiles(image_unit* imgunit,
   int nTiles = shdr->num_entry_point_offsets +1;
   int ctbsWidth = img->sps.PicWidthInCtbsY;
 
+  // tiles outside of the region of interest get no task
+
+  int firstTileID = pps->TileIdRS[shdr->slice_segment_address];
+  int nTasks = 0;
+
+  for (int entryPt=0;entryPt<nTiles;entryPt++) {
+    if (is_tile_outside_ROI(img, firstTileID+entryPt)) {
+      img->mark_tile_skipped(firstTileID+entryPt);
+    }
+    else {
+      nTasks++;
+    }
+  }
+
 
   assert(img->num_threads_active() == 0);
-  img->thread_start(nTiles);
+  img->thread_start(nTasks);
 
   sliceunit->allocate_thread_contexts(nTiles);
 
 
   // first CTB in this slice
   int ctbAddrRS = shdr->slice_segment_address;
-  int tileID = pps->TileIdRS[ctbAddrRS];
+  int tileID = firstTileID;
 
   for (int entryPt=0;entryPt<nTiles;entryPt++) {
     // entry points other than the first start at tile beginnings
@@ -988,6 +1618,10 @@ de265_error decoder_context::decode_slice_unit_tiles(image_unit* imgunit,
       ctbAddrRS = ctbY * ctbsWidth + ctbX;
     }
 
+    if (is_tile_outside_ROI(img, tileID)) {
+      continue;
+    }
+
     // set thread context
 
     thread_context* tctx = sliceunit->get_thread_context(entryPt);
@@ -1023,7 +1657,7 @@ de265_error decoder_context::decode_slice_unit_tiles(image_unit* imgunit,
   img->wait_for_completion();
 
   for (int i=0;i<imgunit->tasks.size();i++)
-    delete imgunit->tasks[i];
+    imgunit->tasks[i]->release();
   imgunit->tasks.clear();
 
   return DE265_OK;
@@ -1067,6 +1701,16 @@ de265_error decoder_context::decode_NAL(NAL_unit* nal)
     return DE265_OK;
   }
 
+  // in IRAP-only mode, drop all other pictures before reading their slice headers
+
+  if (param_decode_irap_only &&
+      nal_hdr.nal_unit_type < 32 &&
+      !isIRAP(nal_hdr.nal_unit_type)) {
+    skip_current_picture = true;
+    nal_parser.free_NAL_unit(nal);
+    return DE265_OK;
+  }
+
 
   if (nal_hdr.nal_unit_type<32) {
     err = read_slice_NAL(reader, nal, nal_hdr);
@@ -1089,7 +1733,10 @@ de265_error decoder_context::decode_NAL(NAL_unit* nal)
 
     case NAL_UNIT_PREFIX_SEI_NUT:
     case NAL_UNIT_SUFFIX_SEI_NUT:
-      err = read_sei_NAL(reader, nal_hdr.nal_unit_type==NAL_UNIT_SUFFIX_SEI_NUT);
+      // suffix SEIs of dropped pictures would be applied to the previous picture
+      if (nal_hdr.nal_unit_type==NAL_UNIT_PREFIX_SEI_NUT || !skip_current_picture) {
+        err = read_sei_NAL(reader, nal_hdr.nal_unit_type==NAL_UNIT_SUFFIX_SEI_NUT);
+      }
       nal_parser.free_NAL_unit(nal);
       break;
 
@@ -1120,11 +1767,12 @@ de265_error decoder_context::decode(int* more)
     // flush all pending pictures into output queue
 
     // ctx->push_current_picture_to_output_queue(); // TODO: not with new queue
+    de265_error err = ctx->finish_hash_checks();
     ctx->dpb.flush_reorder_buffer();
 
     if (more) { *more = ctx->dpb.num_pictures_in_output_queue(); }
 
-    return DE265_OK;
+    return err;
   }
 
 
@@ -1145,6 +1793,12 @@ de265_error decoder_context::decode(int* more)
 
   if (!ctx->dpb.has_free_dpb_picture(false)) {
     if (more) *more = 1;
+
+    // pictures waiting for their hash check can only be released after output
+    if (!ctx->hash_check_units.empty()) {
+      return ctx->finish_hash_checks();
+    }
+
     return DE265_ERROR_IMAGE_BUFFER_FULL;
   }
 
@@ -1163,6 +1817,11 @@ de265_error decoder_context::decode(int* more)
       ctx->image_units.empty()) {
     if (more) { *more=1; }
 
+    // the frame is complete, do not hold it back until the next one is decoded
+    if (!ctx->hash_check_units.empty()) {
+      return ctx->finish_hash_checks();
+    }
+
     return DE265_ERROR_WAITING_FOR_INPUT_DATA;
   }
   else {
@@ -1212,6 +1871,26 @@ void decoder_context::process_pps(pic_parameter_set* pps)
 }
 
 
+/* 8.3.1, PicOrderCntMsb for pictures that do not start with PicOrderCntMsb=0
+ */
+int derive_PicOrderCntMsb(int slice_pic_order_cnt_lsb,
+                          int prevPicOrderCntLsb, int prevPicOrderCntMsb,
+                          int MaxPicOrderCntLsb)
+{
+  if ((slice_pic_order_cnt_lsb < prevPicOrderCntLsb) &&
+      (prevPicOrderCntLsb - slice_pic_order_cnt_lsb) >= MaxPicOrderCntLsb/2) {
+    return prevPicOrderCntMsb + MaxPicOrderCntLsb;
+  }
+  else if ((slice_pic_order_cnt_lsb > prevPicOrderCntLsb) &&
+           (slice_pic_order_cnt_lsb - prevPicOrderCntLsb) > MaxPicOrderCntLsb/2) {
+    return prevPicOrderCntMsb - MaxPicOrderCntLsb;
+  }
+  else {
+    return prevPicOrderCntMsb;
+  }
+}
+
+
 /* 8.3.1
  */
 void decoder_context::process_picture_order_count(decoder_context* ctx, slice_segment_header* hdr)
@@ -1234,19 +1913,10 @@ void decoder_context::process_picture_order_count(decoder_context* ctx, slice_se
     }
   else
     {
-      int MaxPicOrderCntLsb = ctx->current_sps->MaxPicOrderCntLsb;
-
-      if ((hdr->slice_pic_order_cnt_lsb < ctx->prevPicOrderCntLsb) &&
-          (ctx->prevPicOrderCntLsb - hdr->slice_pic_order_cnt_lsb) >= MaxPicOrderCntLsb/2) {
-        ctx->PicOrderCntMsb = ctx->prevPicOrderCntMsb + MaxPicOrderCntLsb;
-      }
-      else if ((hdr->slice_pic_order_cnt_lsb > ctx->prevPicOrderCntLsb) &&
-               (hdr->slice_pic_order_cnt_lsb - ctx->prevPicOrderCntLsb) > MaxPicOrderCntLsb/2) {
-        ctx->PicOrderCntMsb = ctx->prevPicOrderCntMsb - MaxPicOrderCntLsb;
-      }
-      else {
-        ctx->PicOrderCntMsb = ctx->prevPicOrderCntMsb;
-      }
+      ctx->PicOrderCntMsb = derive_PicOrderCntMsb(hdr->slice_pic_order_cnt_lsb,
+                                                  ctx->prevPicOrderCntLsb,
+                                                  ctx->prevPicOrderCntMsb,
+                                                  ctx->current_sps->MaxPicOrderCntLsb);
     }
 
   ctx->img->PicOrderCntVal = ctx->PicOrderCntMsb + hdr->slice_pic_order_cnt_lsb;
@@ -1329,8 +1999,13 @@ void decoder_context::process_reference_picture_set(decoder_context* ctx, slice_
     for (int i=0;i<dpb.size();i++) {
       de265_image* img = ctx->dpb.get_image(i);
 
+      // In IRAP-only mode, the POC may be lower than that of the previous IRAP.
+      bool precedingPicture = (param_decode_irap_only ?
+                               img != ctx->img :
+                               img->PicOrderCntVal < currentPOC);
+
       if (img->PicState != UnusedForReference &&
-          img->PicOrderCntVal < currentPOC &&
+          precedingPicture &&
           img->removed_at_picture_id > ctx->img->get_ID()) {
 
         removeReferencesList.push_back(img->get_ID());
@@ -1708,7 +2383,7 @@ void decoder_context::run_postprocessing_filters_sequential(de265_image* img)
     write_picture_to_file(img, buf);
 #endif
 
-    if (!img->decctx->param_disable_deblocking) {
+    if (!img->decctx->param_disable_deblocking && !img->decctx->param_parse_only) {
       apply_deblocking_filter(img);
     }
 
@@ -1717,7 +2392,7 @@ void decoder_context::run_postprocessing_filters_sequential(de265_image* img)
     write_picture_to_file(img, buf);
 #endif
 
-    if (!img->decctx->param_disable_sao) {
+    if (!img->decctx->param_disable_sao && !img->decctx->param_parse_only) {
       apply_sample_adaptive_offset_sequential(img);
     }
 
@@ -1735,12 +2410,12 @@ void decoder_context::run_postprocessing_filters_parallel(image_unit* imgunit)
   int saoWaitsForProgress = CTB_PROGRESS_PREFILTER;
   bool waitForCompletion = false;
 
-  if (!img->decctx->param_disable_deblocking) {
+  if (!img->decctx->param_disable_deblocking && !img->decctx->param_parse_only) {
     add_deblocking_tasks(imgunit);
     saoWaitsForProgress = CTB_PROGRESS_DEBLK_H;
   }
 
-  if (!img->decctx->param_disable_sao) {
+  if (!img->decctx->param_disable_sao && !img->decctx->param_parse_only) {
     waitForCompletion |= add_sao_tasks(imgunit, saoWaitsForProgress);
     //apply_sample_adaptive_offset(img);
   }
@@ -1748,6 +2423,70 @@ void decoder_context::run_postprocessing_filters_parallel(image_unit* imgunit)
   img->wait_for_completion();
 }
 
+class thread_task_tile_reference : public thread_task
+{
+public:
+  de265_image* img;
+  int firstCtbRow, endCtbRow;
+
+  virtual void work();
+  virtual void describe(task_trace_event* ev) const {
+    ev->name  = "tile reference";
+    ev->index = firstCtbRow;
+    ev->POC   = img->PicOrderCntVal;
+  }
+};
+
+
+void thread_task_tile_reference::work()
+{
+  state = Running;
+  img->thread_run();
+
+  img->tile_ctb_rows(firstCtbRow, endCtbRow);
+
+  state = Finished;
+  img->thread_finishes();
+}
+
+
+void decoder_context::build_tiled_reference(image_unit* imgunit)
+{
+  de265_image* img = imgunit->img;
+
+  if (!img->alloc_tiled_planes()) {
+    return; // motion compensation falls back to the raster planes
+  }
+
+  int nRows = img->sps.PicHeightInCtbsY;
+
+  if (num_worker_threads==0) {
+    img->tile_ctb_rows(0, nRows);
+  }
+  else {
+    // The copy is needed before the next picture is predicted, so split it among the
+    // workers. Bands of several CTB rows keep the task overhead small.
+
+    int nTasks = std::min(nRows, num_worker_threads);
+    img->thread_start(nTasks);
+
+    for (int i=0;i<nTasks;i++) {
+      thread_task_tile_reference* task = task_arena.get_task<thread_task_tile_reference>();
+      task->img = img;
+      task->firstCtbRow =  i   *nRows/nTasks;
+      task->endCtbRow   = (i+1)*nRows/nTasks;
+
+      imgunit->tasks.push_back(task);
+      add_task(&thread_pool, task);
+    }
+
+    img->wait_for_completion();
+  }
+
+  img->set_tiled_planes_valid();
+}
+
+
 /*
 void decoder_context::push_current_picture_to_output_queue()
 {
@@ -1764,12 +2503,21 @@ de265_error decoder_context::push_picture_to_output_queue(image_unit* imgunit)
 
   // push image into output queue
 
+  int sublayer = outimg->vps.vps_max_sub_layers -1;
+  int maxNumPicsInReorderBuffer = outimg->vps.layer[sublayer].vps_max_num_reorder_pics;
+
   if (outimg->PicOutputFlag) {
     loginfo(LogDPB,"new picture has output-flag=true\n");
 
     if (outimg->integrity != INTEGRITY_CORRECT &&
         param_suppress_faulty_pictures) {
     }
+    else if (param_low_latency && maxNumPicsInReorderBuffer==0) {
+      // no reordering in this stream, pass the picture directly to the output queue
+
+      dpb.flush_reorder_buffer();
+      dpb.insert_image_into_output_queue(outimg);
+    }
     else {
       dpb.insert_image_into_reorder_buffer(outimg);
     }
@@ -1779,9 +2527,6 @@ de265_error decoder_context::push_picture_to_output_queue(image_unit* imgunit)
 
   // check for full reorder buffers
 
-  int sublayer = outimg->vps.vps_max_sub_layers -1;
-  int maxNumPicsInReorderBuffer = outimg->vps.layer[sublayer].vps_max_num_reorder_pics;
-
   if (dpb.num_pictures_in_reorder_buffer() > maxNumPicsInReorderBuffer) {
     dpb.output_next_picture_in_reorder_buffer();
   }
@@ -1835,7 +2580,8 @@ bool decoder_context::process_slice_segment_header(decoder_context* ctx, slice_s
     // --- find and allocate image buffer for decoding ---
 
     int image_buffer_idx;
-    bool isOutputImage = (!sps->sample_adaptive_offset_enabled_flag || ctx->param_disable_sao);
+    bool isOutputImage = (!sps->sample_adaptive_offset_enabled_flag ||
+                          ctx->param_disable_sao || ctx->param_parse_only);
     image_buffer_idx = ctx->dpb.new_image(sps, this, pts, user_data, isOutputImage);
     if (image_buffer_idx == -1) {
       *err = DE265_ERROR_IMAGE_BUFFER_FULL;
@@ -1863,8 +2609,11 @@ bool decoder_context::process_slice_segment_header(decoder_context* ctx, slice_s
           ctx->NoRaslOutputFlag = true;
           ctx->FirstAfterEndOfSequenceNAL = false;
         }
-      else if (0) // TODO: set HandleCraAsBlaFlag by external means
+      else if (param_decode_irap_only)
         {
+          // the previous IRAP is not available for reference, handle CRA as BLA
+          ctx->NoRaslOutputFlag   = true;
+          ctx->HandleCraAsBlaFlag = true;
         }
       else
         {
@@ -1886,6 +2635,19 @@ bool decoder_context::process_slice_segment_header(decoder_context* ctx, slice_s
 
     process_picture_order_count(ctx,hdr);
 
+    if (seek_pending && isIRAP(ctx->nal_unit_type)) {
+      seek_POC = img->PicOrderCntVal + seek_POC_distance;
+      seek_pending = false;
+      seek_active  = true;
+    }
+    else if (seek_active && isIRAP(ctx->nal_unit_type) && ctx->NoRaslOutputFlag) {
+      seek_active = false; // new coded video sequence, all following pictures are output
+    }
+
+    if (seek_active && img->PicOrderCntVal < seek_POC) {
+      img->PicOutputFlag = false;
+    }
+
     if (hdr->first_slice_segment_in_pic_flag) {
       // mark picture so that it is not overwritten by unavailable reference frames
       img->PicState = UsedForShortTermReference;
@@ -34,11 +34,11 @@
 #include "libde265/threads.h"
 #include "libde265/acceleration.h"
 #include "libde265/nal-parser.h"
+#include "libde265/pipeline.h"
 
 #define DE265_MAX_VPS_SETS 16   // this is the maximum as defined in the standard
 #define DE265_MAX_SPS_SETS 16   // this is the maximum as defined in the standard
 #define DE265_MAX_PPS_SETS 64   // this is the maximum as defined in the standard
-#define MAX_THREAD_CONTEXTS 68  // enough for 4K @ 32 pixel CTBs, but TODO: make this dynamic
 
 #define MAX_WARNINGS 20
 
@@ -107,6 +107,11 @@ struct thread_context
   struct image_unit* imgunit;
   struct thread_task* task; // executing thread_task or NULL if not multi-threaded
 
+  // decoupled reconstruction: the parser records the reconstruction of
+  // the current CTB into 'syntax_buffer' instead of executing it
+  class recon_pipeline* pipeline;
+  class ctb_syntax_buffer* syntax_buffer;
+
 private:
   thread_context(const thread_context&); // not allowed
   const thread_context& operator=(const thread_context&); // not allowed
@@ -150,11 +155,10 @@ struct slice_unit
   } state;
 
   void allocate_thread_contexts(int n);
-  thread_context* get_thread_context(int n) { return &thread_contexts[n]; }
+  thread_context* get_thread_context(int n) { return thread_contexts[n]; }
 
 private:
-  thread_context* thread_contexts; /* NOTE: cannot use std::vector, because thread_context has
-                                      no copy constructor. */
+  std::vector<thread_context*> thread_contexts; // taken from the decoder_context, given back on destruction
 
   decoder_context* ctx;
 
@@ -189,6 +193,10 @@ struct image_unit
 
   std::vector<thread_task*> tasks; // we are the owner
 
+  bool filtered; // post-filters have already run while decoding (low-latency mode)
+
+  int64_t decode_start_time; // usec, 0: decoding has not started yet
+
   /* Saved context models for WPP.
      There is one saved model for the initialization of each CTB row.
      The array is unused for non-WPP streams. */
@@ -205,6 +213,8 @@ class decoder_context : public error_queue {
   de265_error start_thread_pool(int nThreads);
   void        stop_thread_pool();
 
+  de265_error write_task_trace(const char* filename);
+
   void reset();
 
   /* */ seq_parameter_set* get_sps(int id)       { return &sps[id]; }
@@ -228,6 +238,9 @@ class decoder_context : public error_queue {
 
   de265_error decode_slice_unit_sequential(image_unit* imgunit, slice_unit* sliceunit);
   de265_error decode_slice_unit_parallel(image_unit* imgunit, slice_unit* sliceunit);
+  de265_error decode_slice_units_parallel(image_unit* imgunit);
+  de265_error decode_slice_unit_pipelined(image_unit* imgunit, slice_unit* sliceunit,
+                                          thread_context* tctx);
   de265_error decode_slice_unit_WPP(image_unit* imgunit, slice_unit* sliceunit);
   de265_error decode_slice_unit_tiles(image_unit* imgunit, slice_unit* sliceunit);
 
@@ -243,6 +256,9 @@ class decoder_context : public error_queue {
   //void push_current_picture_to_output_queue();
   de265_error push_picture_to_output_queue(image_unit*);
 
+  // wait for the background SEI hash checks and output these pictures
+  de265_error finish_hash_checks();
+
 
   // --- parameters ---
 
@@ -257,6 +273,18 @@ class decoder_context : public error_queue {
 
   bool param_disable_deblocking;
   bool param_disable_sao;
+  bool param_decoupled_reconstruction;
+  bool param_decode_irap_only;
+  bool param_low_latency;
+  bool param_release_metadata;
+  bool param_tiled_references;
+  bool param_huge_pages; // used by the default image allocator
+  bool param_parse_only; // no reconstruction, filtering and hash checks
+  bool param_keep_motion_field; // keep the 4x4 motion field after decoding for export
+  bool param_trace_tasks; // record worker tasks, applied when the thread pool is started
+
+  // region of interest in the output picture, tiles outside are skipped (width or height 0: off)
+  int  param_roi_x, param_roi_y, param_roi_width, param_roi_height;
   //bool param_disable_mc_residual_idct;  // not implemented yet
   //bool param_disable_intra_residual_idct;  // not implemented yet
 
@@ -265,6 +293,15 @@ class decoder_context : public error_queue {
   de265_image_allocation param_image_allocation_functions;
   void*                  param_image_allocation_userdata;
 
+  de265_row_output_callback param_row_output_callback; // NULL: no row output
+  void*                     param_row_output_userdata;
+
+  de265_ctb_statistics_callback param_ctb_statistics_callback; // NULL: no statistics
+  void*                         param_ctb_statistics_userdata;
+
+  std::vector<int> param_worker_cpus; // CPUs to pin the worker threads to, empty: no pinning
+  int              param_numa_node;   // NUMA node for workers and picture memory, -1: none
+
 
   // --- accelerated DSP functions ---
 
@@ -280,6 +317,9 @@ class decoder_context : public error_queue {
 
   int get_num_worker_threads() const { return num_worker_threads; }
 
+  // the tile does not intersect the region of interest and is not decoded
+  bool is_tile_outside_ROI(const de265_image* img, int tileID) const;
+
   /* */ de265_image* get_image(int dpb_index)       { return dpb.get_image(dpb_index); }
   const de265_image* get_image(int dpb_index) const { return dpb.get_image(dpb_index); }
 
@@ -311,7 +351,16 @@ class decoder_context : public error_queue {
  public:
   struct thread_pool thread_pool;
 
+  // task objects and thread contexts are kept for reuse in the following slices
+
+  thread_task_arena task_arena;
+
+  thread_context* acquire_thread_context();
+  void release_thread_context(thread_context*);
+
  private:
+  std::vector<thread_context*> free_thread_contexts;
+
   int num_worker_threads;
 
 
@@ -344,6 +393,44 @@ class decoder_context : public error_queue {
   void compute_framedrop_table();
   void calc_tid_and_framerate_ratio();
 
+ public:
+  // --- deadline-driven frame dropping ---
+
+  void set_presentation_clock(de265_presentation_clock clock, void* userdata,
+                              de265_PTS pts_per_second);
+  int  get_number_of_late_pictures_dropped() const { return deadline_pictures_dropped; }
+
+ private:
+  de265_presentation_clock presentation_clock; // NULL: no deadline-driven dropping
+  void*     presentation_clock_userdata;
+  de265_PTS pts_per_second;
+
+  int   deadline_HighestTid;      // layers above are dropped until the next switching point
+  bool  deadline_skip_RASL;       // RASL pictures of the current CRA may use dropped pictures
+  float decode_time[6+1];         // average decoding time per temporal layer (seconds, <0: unknown)
+  int   deadline_pictures_dropped;
+
+  bool drop_late_picture(const nal_header& nal_hdr, const seq_parameter_set* sps, de265_PTS pts);
+  void measure_decode_time(const image_unit* imgunit);
+
+ public:
+  // --- random access ---
+
+  /* Reset the decoder for restarting at an IRAP picture. Pictures that precede
+     the picture at distance 'POC_distance' from the IRAP in output order are not
+     output, and are only decoded when they may be needed for reference. */
+  void seek(int POC_distance);
+
+ private:
+  bool seek_pending;  // waiting for the IRAP at which decoding restarts
+  bool seek_active;   // pictures before 'seek_POC' are not output
+  int  seek_POC_distance;
+  int  seek_POC;
+
+  bool skip_current_picture; // drop all slices of the current picture
+
+  bool skip_picture(const slice_segment_header* shdr, const nal_header& nal_hdr, de265_PTS pts);
+
  private:
   // --- decoded picture buffer ---
 
@@ -412,12 +499,16 @@ class decoder_context : public error_queue {
 
   std::vector<image_unit*> image_units;
 
+  // decoded image units whose SEI hashes are still being verified, not output yet
+  std::vector<image_unit*> hash_check_units;
+
   bool flush_reorder_buffer_at_this_frame;
 
  private:
   void init_thread_context(class thread_context* tctx);
   void add_task_decode_CTB_row(thread_context* tctx, bool firstSliceSubstream);
   void add_task_decode_slice_segment(thread_context* tctx, bool firstSliceSubstream);
+  void add_task_reconstruct(thread_context* tctx, recon_pipeline* pipeline);
 
 
   void process_picture_order_count(decoder_context* ctx, slice_segment_header* hdr);
@@ -430,7 +521,13 @@ class decoder_context : public error_queue {
   void remove_images_from_dpb(const std::vector<int>& removeImageList);
   void run_postprocessing_filters_sequential(de265_image* img);
   void run_postprocessing_filters_parallel(image_unit* img);
+  void build_tiled_reference(image_unit* imgunit);
 };
 
 
+int derive_PicOrderCntMsb(int slice_pic_order_cnt_lsb,
+                          int prevPicOrderCntLsb, int prevPicOrderCntMsb,
+                          int MaxPicOrderCntLsb);
+
+
 #endif
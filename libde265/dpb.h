@@ -80,6 +80,9 @@ struct decoded_picture_buffer {
 
   int num_pictures_in_output_queue() const { return image_output_queue.size(); }
 
+  // bypass the reorder buffer
+  void insert_image_into_output_queue(de265_image* img) { image_output_queue.push_back(img); }
+
   /* Get the next picture in the output queue, but do not remove it from the queue. */
   de265_image* get_next_picture_in_output_queue() const { return image_output_queue.front(); }
 
@@ -0,0 +1,70 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fallback-convert.h"
+
+
+void interleave_chroma_8_fallback(uint8_t* dst, const uint8_t* u, const uint8_t* v, int width)
+{
+  for (int x=0;x<width;x++) {
+    dst[2*x  ] = u[x];
+    dst[2*x+1] = v[x];
+  }
+}
+
+
+// The SIMD versions compute in 16 bit with saturation. Saturation can only occur
+// for values that are clipped to 0 or 255 afterwards anyway, but we emulate it here
+// to be on the safe side.
+
+static inline int sat16(int v)
+{
+  if (v < -32768) return -32768;
+  if (v >  32767) return  32767;
+  return v;
+}
+
+static inline uint8_t clip8(int v)
+{
+  if (v<0)   return 0;
+  if (v>255) return 255;
+  return v;
+}
+
+
+void yuv420_to_rgb_8_fallback(uint8_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                              int width, const int16_t* coeffs, int bytes_per_pixel)
+{
+  for (int x=0;x<width;x++) {
+    int Y = (y[x]-16)*coeffs[0] + 32;
+    int U = u[x>>1]-128;
+    int V = v[x>>1]-128;
+
+    dst[0] = clip8(sat16(Y + V*coeffs[1]) >> 6);
+    dst[1] = clip8(sat16(sat16(Y - U*coeffs[2]) - V*coeffs[3]) >> 6);
+    dst[2] = clip8(sat16(Y + U*coeffs[4]) >> 6);
+
+    if (bytes_per_pixel==4) {
+      dst[3] = 255;
+    }
+
+    dst += bytes_per_pixel;
+  }
+}
@@ -30,32 +30,56 @@
 #include <assert.h>
 
 
-void transform_skip_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride)
+template <class pixel_t>
+static void transform_skip(pixel_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth)
 {
   int nT = 4;
-  int bdShift2 = 20-8;
+  int bdShift2 = 20-bit_depth;
 
   for (int y=0;y<nT;y++)
     for (int x=0;x<nT;x++) {
       int32_t c = coeffs[x+y*nT] << 7;
       c = (c+(1<<(bdShift2-1)))>>bdShift2;
 
-      dst[y*stride+x] = Clip1_8bit(dst[y*stride+x] + c);
+      dst[y*stride+x] = Clip_BitDepth(dst[y*stride+x] + c, bit_depth);
     }
 }
 
 
-void transform_bypass_8_fallback(uint8_t *dst, int16_t *coeffs, int nT, ptrdiff_t stride)
+template <class pixel_t>
+static void transform_bypass(pixel_t *dst, int16_t *coeffs, int nT, ptrdiff_t stride,
+                             int bit_depth)
 {
-  int bdShift2 = 20-8;
-
   for (int y=0;y<nT;y++)
     for (int x=0;x<nT;x++) {
       int32_t c = coeffs[x+y*nT];
 
-      dst[y*stride+x] = Clip1_8bit(dst[y*stride+x] + c);
+      dst[y*stride+x] = Clip_BitDepth(dst[y*stride+x] + c, bit_depth);
     }
 }
+
+
+void transform_skip_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_skip(dst, coeffs, stride, 8);
+}
+
+void transform_bypass_8_fallback(uint8_t *dst, int16_t *coeffs, int nT, ptrdiff_t stride)
+{
+  transform_bypass(dst, coeffs, nT, stride, 8);
+}
+
+void transform_skip_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                int bit_depth)
+{
+  transform_skip(dst, coeffs, stride, bit_depth);
+}
+
+void transform_bypass_16_fallback(uint16_t *dst, int16_t *coeffs, int nT, ptrdiff_t stride,
+                                  int bit_depth)
+{
+  transform_bypass(dst, coeffs, nT, stride, bit_depth);
+}
         
 
 static int8_t mat_8_357[4][4] = {
@@ -67,11 +91,13 @@ static int8_t mat_8_357[4][4] = {
 
 
 
-void transform_4x4_luma_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride)
+template <class pixel_t>
+static void transform_4x4_luma_add(pixel_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                   int bit_depth)
 {
   int16_t g[4][4];
 
-  int postShift = 20-8; // 8 bit
+  int postShift = 20-bit_depth;
   int rndV = 1<<(7-1);
   int rndH = 1<<(postShift-1);
 
@@ -125,7 +151,7 @@ void transform_4x4_luma_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t
 
       int out = Clip3(-32768,32767, (sum+rndH)>>postShift);
 
-      dst[y*stride+i] = Clip1_8bit(dst[y*stride+i] + out);
+      dst[y*stride+i] = Clip_BitDepth(dst[y*stride+i] + out, bit_depth);
 
       logtrace(LogTransform,"*%d ",out);
     }
@@ -135,6 +161,18 @@ void transform_4x4_luma_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t
 }
 
 
+void transform_4x4_luma_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_4x4_luma_add(dst, coeffs, stride, 8);
+}
+
+void transform_4x4_luma_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                        int bit_depth)
+{
+  transform_4x4_luma_add(dst, coeffs, stride, bit_depth);
+}
+
+
 
 static int8_t mat_dct[32][32] = {
   { 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,      64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64},
@@ -174,10 +212,11 @@ static int8_t mat_dct[32][32] = {
 
 
 
-static void transform_dct_add_8(uint8_t *dst, ptrdiff_t stride,
-                                int nT, int16_t *coeffs)
+template <class pixel_t>
+static void transform_dct_add(pixel_t *dst, ptrdiff_t stride,
+                              int nT, int16_t *coeffs, int bit_depth)
 {
-  int postShift = 20-8; // 8 bit
+  int postShift = 20-bit_depth;
   int rnd1 = 1<<(7-1);
   int rnd2 = 1<<(postShift-1);
   int fact = (1<<(5-Log2(nT)));
@@ -260,7 +299,7 @@ static void transform_dct_add_8(uint8_t *dst, ptrdiff_t stride,
 
       //fprintf(stderr,"%d*%d+%d = %d\n",y,stride,i,y*stride+i);
       //fprintf(stderr,"[%p]=%d\n",&dst[y*stride+i], Clip1_8bit(dst[y*stride+i]));
-      dst[y*stride+i] = Clip1_8bit(dst[y*stride+i] + out);
+      dst[y*stride+i] = Clip_BitDepth(dst[y*stride+i] + out, bit_depth);
 
       logtrace(LogTransform,"*%d ",out);
     }
@@ -271,20 +310,72 @@ static void transform_dct_add_8(uint8_t *dst, ptrdiff_t stride,
 
 void transform_4x4_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride)
 {
-  transform_dct_add_8(dst,stride,  4, coeffs);
+  transform_dct_add(dst,stride,  4, coeffs, 8);
 }
 
 void transform_8x8_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride)
 {
-  transform_dct_add_8(dst,stride,  8, coeffs);
+  transform_dct_add(dst,stride,  8, coeffs, 8);
 }
 
 void transform_16x16_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride)
 {
-  transform_dct_add_8(dst,stride,  16, coeffs);
+  transform_dct_add(dst,stride,  16, coeffs, 8);
 }
 
 void transform_32x32_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride)
 {
-  transform_dct_add_8(dst,stride,  32, coeffs);
+  transform_dct_add(dst,stride,  32, coeffs, 8);
+}
+
+
+void transform_4x4_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                   int bit_depth)
+{
+  transform_dct_add(dst,stride,  4, coeffs, bit_depth);
+}
+
+void transform_8x8_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                   int bit_depth)
+{
+  transform_dct_add(dst,stride,  8, coeffs, bit_depth);
+}
+
+void transform_16x16_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                     int bit_depth)
+{
+  transform_dct_add(dst,stride,  16, coeffs, bit_depth);
+}
+
+void transform_32x32_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                     int bit_depth)
+{
+  transform_dct_add(dst,stride,  32, coeffs, bit_depth);
+}
+
+
+static inline int16_t dequant_coefficient(int32_t c, int shift)
+{
+  if (shift>0) {
+    return Clip3(-32768,32767, (c + (1<<(shift-1))) >> shift);
+  }
+  else {
+    return Clip3(-32768,32767, Clip3(-32768,32767, c) << -shift);
+  }
+}
+
+
+void dequant_flat_fallback(int16_t *coeffs, int n, int fact, int shift)
+{
+  for (int i=0;i<n;i++) {
+    coeffs[i] = dequant_coefficient(coeffs[i] * fact, shift);
+  }
+}
+
+
+void dequant_scaled_fallback(int16_t *coeffs, const uint8_t *m, int n, int fact, int shift)
+{
+  for (int i=0;i<n;i++) {
+    coeffs[i] = dequant_coefficient(coeffs[i] * (m[i] * fact), shift);
+  }
 }
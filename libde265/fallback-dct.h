@@ -34,4 +34,23 @@ void transform_8x8_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t strid
 void transform_16x16_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride);
 void transform_32x32_add_8_fallback(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride);
 
+void transform_skip_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                int bit_depth);
+void transform_bypass_16_fallback(uint16_t *dst, int16_t *coeffs, int nT, ptrdiff_t stride,
+                                  int bit_depth);
+
+void transform_4x4_luma_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                        int bit_depth);
+void transform_4x4_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                   int bit_depth);
+void transform_8x8_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                   int bit_depth);
+void transform_16x16_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                     int bit_depth);
+void transform_32x32_add_16_fallback(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride,
+                                     int bit_depth);
+
+void dequant_flat_fallback(int16_t *coeffs, int n, int fact, int shift);
+void dequant_scaled_fallback(int16_t *coeffs, const uint8_t *m, int n, int fact, int shift);
+
 #endif
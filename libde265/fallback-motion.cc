@@ -159,16 +159,96 @@ void put_weighted_pred_avg_8_fallback(uint8_t *dst, ptrdiff_t dststride,
 
 
 
-void put_epel_8_fallback(int16_t *out, ptrdiff_t out_stride,
-                         uint8_t *src, ptrdiff_t src_stride,
-                         int width, int height,
-                         int mx, int my, int16_t* mcbuffer)
+void put_unweighted_pred_16_fallback(uint16_t *dst, ptrdiff_t dststride,
+                                     int16_t *src, ptrdiff_t srcstride,
+                                     int width, int height, int bit_depth)
+{
+  int shift1 = 14-bit_depth;
+  int offset1 = 1<<(shift1-1);
+
+  for (int y=0;y<height;y++) {
+    int16_t*  in  = &src[y*srcstride];
+    uint16_t* out = &dst[y*dststride];
+
+    for (int x=0;x<width;x++) {
+      out[x] = Clip_BitDepth((in[x] + offset1)>>shift1, bit_depth);
+    }
+  }
+}
+
+
+void put_weighted_pred_16_fallback(uint16_t *dst, ptrdiff_t dststride,
+                                   int16_t *src, ptrdiff_t srcstride,
+                                   int width, int height,
+                                   int w,int o,int log2WD, int bit_depth)
+{
+  assert(log2WD>=1); // TODO
+
+  const int rnd = (1<<(log2WD-1));
+
+  for (int y=0;y<height;y++) {
+    int16_t*  in  = &src[y*srcstride];
+    uint16_t* out = &dst[y*dststride];
+
+    for (int x=0;x<width;x++) {
+      out[x] = Clip_BitDepth(((in[x]*w + rnd)>>log2WD) + o, bit_depth);
+    }
+  }
+}
+
+
+void put_weighted_bipred_16_fallback(uint16_t *dst, ptrdiff_t dststride,
+                                     int16_t *src1, int16_t *src2, ptrdiff_t srcstride,
+                                     int width, int height,
+                                     int w1,int o1, int w2,int o2, int log2WD, int bit_depth)
+{
+  assert(log2WD>=1); // TODO
+
+  const int rnd = ((o1+o2+1) << log2WD);
+
+  for (int y=0;y<height;y++) {
+    int16_t*  in1 = &src1[y*srcstride];
+    int16_t*  in2 = &src2[y*srcstride];
+    uint16_t* out = &dst[y*dststride];
+
+    for (int x=0;x<width;x++) {
+      out[x] = Clip_BitDepth((in1[x]*w1 + in2[x]*w2 + rnd)>>(log2WD+1), bit_depth);
+    }
+  }
+}
+
+
+void put_weighted_pred_avg_16_fallback(uint16_t *dst, ptrdiff_t dststride,
+                                       int16_t *src1, int16_t *src2,
+                                       ptrdiff_t srcstride, int width,
+                                       int height, int bit_depth)
+{
+  int shift2 = 15-bit_depth;
+  int offset2 = 1<<(shift2-1);
+
+  for (int y=0;y<height;y++) {
+    int16_t*  in1 = &src1[y*srcstride];
+    int16_t*  in2 = &src2[y*srcstride];
+    uint16_t* out = &dst[y*dststride];
+
+    for (int x=0;x<width;x++) {
+      out[x] = Clip_BitDepth((in1[x] + in2[x] + offset2)>>shift2, bit_depth);
+    }
+  }
+}
+
+
+
+template <class pixel_t>
+static void put_epel(int16_t *out, ptrdiff_t out_stride,
+                     pixel_t *src, ptrdiff_t src_stride,
+                     int width, int height, int bit_depth)
 {
-  int shift3 = 6;
+  int shift3 = 14-bit_depth;
 
   for (int y=0;y<height;y++) {
     int16_t* o = &out[y*out_stride];
-    uint8_t* i = &src[y*src_stride];
+    pixel_t* i = &src[y*src_stride];
 
     for (int x=0;x<width;x++) {
       *o = *i << shift3;
@@ -179,12 +259,31 @@ void put_epel_8_fallback(int16_t *out, ptrdiff_t out_stride,
 }
 
 
-void put_epel_hv_8_fallback(int16_t *dst, ptrdiff_t dst_stride,
-                            uint8_t *src, ptrdiff_t src_stride,
-                            int nPbWC, int nPbHC,
-                            int xFracC, int yFracC, int16_t* mcbuffer)
+void put_epel_8_fallback(int16_t *out, ptrdiff_t out_stride,
+                         uint8_t *src, ptrdiff_t src_stride,
+                         int width, int height,
+                         int mx, int my, int16_t* mcbuffer)
 {
-  const int shift1 = 0;
+  put_epel(out,out_stride, src,src_stride, width,height, 8);
+}
+
+
+void put_epel_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t src_stride,
+                          int width, int height,
+                          int mx, int my, int16_t* mcbuffer, int bit_depth)
+{
+  put_epel(out,out_stride, src,src_stride, width,height, bit_depth);
+}
+
+
+template <class pixel_t>
+static void put_epel_hv(int16_t *dst, ptrdiff_t dst_stride,
+                        pixel_t *src, ptrdiff_t src_stride,
+                        int nPbWC, int nPbHC,
+                        int xFracC, int yFracC, int bit_depth)
+{
+  const int shift1 = bit_depth-8;
   const int shift2 = 6;
   //const int shift3 = 6;
 
@@ -224,7 +323,7 @@ void put_epel_hv_8_fallback(int16_t *dst, ptrdiff_t dst_stride,
   //printf("---H---(%d)\n",xFracC);
 
   for (int y=-extra_top;y<nPbHC+extra_bottom;y++) {
-    uint8_t* p = &src[y*src_stride - extra_left];
+    pixel_t* p = &src[y*src_stride - extra_left];
 
     for (int x=0;x<nPbWC;x++) {
       int16_t v;
@@ -291,6 +390,24 @@ void put_epel_hv_8_fallback(int16_t *dst, ptrdiff_t dst_stride,
 }
 
 
+void put_epel_hv_8_fallback(int16_t *dst, ptrdiff_t dst_stride,
+                            uint8_t *src, ptrdiff_t src_stride,
+                            int nPbWC, int nPbHC,
+                            int xFracC, int yFracC, int16_t* mcbuffer)
+{
+  put_epel_hv(dst,dst_stride, src,src_stride, nPbWC,nPbHC, xFracC,yFracC, 8);
+}
+
+
+void put_epel_hv_16_fallback(int16_t *dst, ptrdiff_t dst_stride,
+                             uint16_t *src, ptrdiff_t src_stride,
+                             int nPbWC, int nPbHC,
+                             int xFracC, int yFracC, int16_t* mcbuffer, int bit_depth)
+{
+  put_epel_hv(dst,dst_stride, src,src_stride, nPbWC,nPbHC, xFracC,yFracC, bit_depth);
+}
+
+
 
 
 void put_qpel_0_0_fallback(int16_t *out, ptrdiff_t out_stride,
@@ -334,10 +451,11 @@ void put_qpel_0_0_fallback(int16_t *out, ptrdiff_t out_stride,
 static int extra_before[4] = { 0,3,3,2 };
 static int extra_after [4] = { 0,3,4,4 };
 
-void put_qpel_fallback(int16_t *out, ptrdiff_t out_stride,
-                       uint8_t *src, ptrdiff_t srcstride,
-                       int nPbW, int nPbH, int16_t* mcbuffer,
-                       int xFracL, int yFracL)
+template <class pixel_t>
+static void put_qpel(int16_t *out, ptrdiff_t out_stride,
+                     pixel_t *src, ptrdiff_t srcstride,
+                     int nPbW, int nPbH, int16_t* mcbuffer,
+                     int xFracL, int yFracL, int bit_depth)
 {
   int extra_left   = extra_before[xFracL];
   //int extra_right  = extra_after [xFracL];
@@ -347,7 +465,7 @@ void put_qpel_fallback(int16_t *out, ptrdiff_t out_stride,
   //int nPbW_extra = extra_left + nPbW + extra_right;
   int nPbH_extra = extra_top  + nPbH + extra_bottom;
 
-  const int shift1 = 0; // sps->BitDepth_Y-8;
+  const int shift1 = bit_depth-8;
   const int shift2 = 6;
 
 
@@ -356,7 +474,7 @@ void put_qpel_fallback(int16_t *out, ptrdiff_t out_stride,
   switch (xFracL) {
   case 0:
     for (int y=-extra_top;y<nPbH+extra_bottom;y++) {
-      uint8_t* p = src + srcstride*y - extra_left;
+      pixel_t* p = src + srcstride*y - extra_left;
       int16_t* o = &mcbuffer[y+extra_top];
 
       for (int x=0;x<nPbW;x++) {
@@ -368,7 +486,7 @@ void put_qpel_fallback(int16_t *out, ptrdiff_t out_stride,
     break;
   case 1:
     for (int y=-extra_top;y<nPbH+extra_bottom;y++) {
-      uint8_t* p = src + srcstride*y - extra_left;
+      pixel_t* p = src + srcstride*y - extra_left;
       int16_t* o = &mcbuffer[y+extra_top];
 
       for (int x=0;x<nPbW;x++) {
@@ -380,7 +498,7 @@ void put_qpel_fallback(int16_t *out, ptrdiff_t out_stride,
     break;
   case 2:
     for (int y=-extra_top;y<nPbH+extra_bottom;y++) {
-      uint8_t* p = src + srcstride*y - extra_left;
+      pixel_t* p = src + srcstride*y - extra_left;
       int16_t* o = &mcbuffer[y+extra_top];
 
       for (int x=0;x<nPbW;x++) {
@@ -392,7 +510,7 @@ void put_qpel_fallback(int16_t *out, ptrdiff_t out_stride,
     break;
   case 3:
     for (int y=-extra_top;y<nPbH+extra_bottom;y++) {
-      uint8_t* p = src + srcstride*y - extra_left;
+      pixel_t* p = src + srcstride*y - extra_left;
       int16_t* o = &mcbuffer[y+extra_top];
 
       for (int x=0;x<nPbW;x++) {
@@ -483,9 +601,40 @@ void put_qpel_fallback(int16_t *out, ptrdiff_t out_stride,
 #define QPEL(x,y) void put_qpel_ ## x ## _ ## y ## _fallback(int16_t *out, ptrdiff_t out_stride,    \
                                              uint8_t *src, ptrdiff_t srcstride,     \
                                              int nPbW, int nPbH, int16_t* mcbuffer) \
-{ put_qpel_fallback(out,out_stride, src,srcstride, nPbW,nPbH,mcbuffer,x,y ); }
+{ put_qpel(out,out_stride, src,srcstride, nPbW,nPbH,mcbuffer,x,y, 8); }
 
 /*     */ QPEL(0,1) QPEL(0,2) QPEL(0,3)
 QPEL(1,0) QPEL(1,1) QPEL(1,2) QPEL(1,3)
 QPEL(2,0) QPEL(2,1) QPEL(2,2) QPEL(2,3)
 QPEL(3,0) QPEL(3,1) QPEL(3,2) QPEL(3,3)
+
+
+void put_qpel_0_0_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth)
+{
+  const int shift2 = 14-bit_depth;
+
+  // straight copy
+
+  for (int y=0;y<nPbH;y++) {
+    uint16_t* p = src + srcstride*y;
+    int16_t*  o = out + out_stride*y;
+
+    for (int x=0;x<nPbW;x++) {
+      o[x] = p[x] << shift2;
+    }
+  }
+}
+
+
+#define QPEL16(x,y) void put_qpel_ ## x ## _ ## y ## _16_fallback(int16_t *out, ptrdiff_t out_stride, \
+                                             uint16_t *src, ptrdiff_t srcstride,    \
+                                             int nPbW, int nPbH, int16_t* mcbuffer, \
+                                             int bit_depth)                         \
+{ put_qpel(out,out_stride, src,srcstride, nPbW,nPbH,mcbuffer,x,y, bit_depth); }
+
+/*       */ QPEL16(0,1) QPEL16(0,2) QPEL16(0,3)
+QPEL16(1,0) QPEL16(1,1) QPEL16(1,2) QPEL16(1,3)
+QPEL16(2,0) QPEL16(2,1) QPEL16(2,2) QPEL16(2,3)
+QPEL16(3,0) QPEL16(3,1) QPEL16(3,2) QPEL16(3,3)
@@ -101,4 +101,81 @@ void put_qpel_3_3_fallback(int16_t *out, ptrdiff_t out_stride,
                            uint8_t *src, ptrdiff_t srcstride,
                            int nPbW, int nPbH, int16_t* mcbuffer);
 
+
+void put_weighted_pred_avg_16_fallback(uint16_t *dst, ptrdiff_t dststride,
+                                       int16_t *src1, int16_t *src2,
+                                       ptrdiff_t srcstride, int width,
+                                       int height, int bit_depth);
+
+void put_unweighted_pred_16_fallback(uint16_t *_dst, ptrdiff_t dststride,
+                                     int16_t *src, ptrdiff_t srcstride,
+                                     int width, int height, int bit_depth);
+
+void put_weighted_pred_16_fallback(uint16_t *_dst, ptrdiff_t dststride,
+                                   int16_t *src, ptrdiff_t srcstride,
+                                   int width, int height,
+                                   int w,int o,int log2WD, int bit_depth);
+void put_weighted_bipred_16_fallback(uint16_t *_dst, ptrdiff_t dststride,
+                                     int16_t *src1, int16_t *src2, ptrdiff_t srcstride,
+                                     int width, int height,
+                                     int w1,int o1, int w2,int o2, int log2WD, int bit_depth);
+
+void put_epel_16_fallback(int16_t *dst, ptrdiff_t dststride,
+                          uint16_t *_src, ptrdiff_t srcstride,
+                          int width, int height,
+                          int mx, int my, int16_t* mcbuffer, int bit_depth);
+void put_epel_hv_16_fallback(int16_t *dst, ptrdiff_t dststride,
+                             uint16_t *_src, ptrdiff_t srcstride,
+                             int width, int height,
+                             int mx, int my, int16_t* mcbuffer, int bit_depth);
+
+void put_qpel_0_0_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_0_1_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_0_2_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_0_3_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_1_0_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_1_1_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_1_2_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_1_3_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_2_0_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_2_1_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_2_2_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_2_3_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_3_0_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_3_1_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_3_2_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_3_3_16_fallback(int16_t *out, ptrdiff_t out_stride,
+                              uint16_t *src, ptrdiff_t srcstride,
+                              int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+
 #endif
@@ -21,6 +21,7 @@
 #include "fallback.h"
 #include "fallback-motion.h"
 #include "fallback-dct.h"
+#include "fallback-convert.h"
 
 
 void init_acceleration_functions_fallback(struct acceleration_functions* accel)
@@ -53,6 +54,34 @@ void init_acceleration_functions_fallback(struct acceleration_functions* accel)
   accel->put_hevc_qpel_8[3][2] = put_qpel_3_2_fallback;
   accel->put_hevc_qpel_8[3][3] = put_qpel_3_3_fallback;
 
+  accel->put_weighted_pred_avg_16 = put_weighted_pred_avg_16_fallback;
+  accel->put_unweighted_pred_16   = put_unweighted_pred_16_fallback;
+
+  accel->put_weighted_pred_16 = put_weighted_pred_16_fallback;
+  accel->put_weighted_bipred_16 = put_weighted_bipred_16_fallback;
+
+  accel->put_hevc_epel_16    = put_epel_16_fallback;
+  accel->put_hevc_epel_h_16  = put_epel_hv_16_fallback;
+  accel->put_hevc_epel_v_16  = put_epel_hv_16_fallback;
+  accel->put_hevc_epel_hv_16 = put_epel_hv_16_fallback;
+
+  accel->put_hevc_qpel_16[0][0] = put_qpel_0_0_16_fallback;
+  accel->put_hevc_qpel_16[0][1] = put_qpel_0_1_16_fallback;
+  accel->put_hevc_qpel_16[0][2] = put_qpel_0_2_16_fallback;
+  accel->put_hevc_qpel_16[0][3] = put_qpel_0_3_16_fallback;
+  accel->put_hevc_qpel_16[1][0] = put_qpel_1_0_16_fallback;
+  accel->put_hevc_qpel_16[1][1] = put_qpel_1_1_16_fallback;
+  accel->put_hevc_qpel_16[1][2] = put_qpel_1_2_16_fallback;
+  accel->put_hevc_qpel_16[1][3] = put_qpel_1_3_16_fallback;
+  accel->put_hevc_qpel_16[2][0] = put_qpel_2_0_16_fallback;
+  accel->put_hevc_qpel_16[2][1] = put_qpel_2_1_16_fallback;
+  accel->put_hevc_qpel_16[2][2] = put_qpel_2_2_16_fallback;
+  accel->put_hevc_qpel_16[2][3] = put_qpel_2_3_16_fallback;
+  accel->put_hevc_qpel_16[3][0] = put_qpel_3_0_16_fallback;
+  accel->put_hevc_qpel_16[3][1] = put_qpel_3_1_16_fallback;
+  accel->put_hevc_qpel_16[3][2] = put_qpel_3_2_16_fallback;
+  accel->put_hevc_qpel_16[3][3] = put_qpel_3_3_16_fallback;
+
   accel->transform_skip_8 = transform_skip_8_fallback;
   accel->transform_bypass_8 = transform_bypass_8_fallback;
   accel->transform_4x4_luma_add_8 = transform_4x4_luma_add_8_fallback;
@@ -60,4 +89,18 @@ void init_acceleration_functions_fallback(struct acceleration_functions* accel)
   accel->transform_8x8_add_8   = transform_8x8_add_8_fallback;
   accel->transform_16x16_add_8 = transform_16x16_add_8_fallback;
   accel->transform_32x32_add_8 = transform_32x32_add_8_fallback;
+
+  accel->transform_skip_16 = transform_skip_16_fallback;
+  accel->transform_bypass_16 = transform_bypass_16_fallback;
+  accel->transform_4x4_luma_add_16 = transform_4x4_luma_add_16_fallback;
+  accel->transform_4x4_add_16   = transform_4x4_add_16_fallback;
+  accel->transform_8x8_add_16   = transform_8x8_add_16_fallback;
+  accel->transform_16x16_add_16 = transform_16x16_add_16_fallback;
+  accel->transform_32x32_add_16 = transform_32x32_add_16_fallback;
+
+  accel->dequant_flat   = dequant_flat_fallback;
+  accel->dequant_scaled = dequant_scaled_fallback;
+
+  accel->interleave_chroma_8 = interleave_chroma_8_fallback;
+  accel->yuv420_to_rgb_8     = yuv420_to_rgb_8_fallback;
 }
@@ -22,10 +22,12 @@
 #include "decctx.h"
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 
 #include <limits>
+#include <algorithm>
 
 
 #ifdef HAVE_MALLOC_H
@@ -58,37 +60,76 @@ static inline void *ALLOC_ALIGNED(size_t alignment, size_t size) {
 #define FREE_ALIGNED(mem)                   free((mem))
 #endif
 
-#define ALLOC_ALIGNED_16(size)              ALLOC_ALIGNED(16, size)
 
-static const int alignment = 16;
+/* With a stride that is a multiple of a large power of two, vertically neighboring samples
+   map into the same few cache sets. Such strides get one more cache line, so that the
+   rows of a prediction block are spread over all sets. */
+#define CACHE_ALIAS_PERIOD 1024
+
+static int alias_free_bytes_per_line(int width, int bytesPerSample, int alignment)
+{
+  int bpl = (width*bytesPerSample + alignment-1) / alignment * alignment;
+
+  if (bpl % CACHE_ALIAS_PERIOD == 0) {
+    bpl += alignment;
+  }
+
+  return bpl;
+}
 
 
+/* The three planes of a picture are allocated in one block, each plane starting at a cache
+   line. Large pictures are aligned to huge pages and use transparent huge pages where
+   available, to reduce the TLB misses of motion compensation. */
 static int  de265_image_get_buffer(de265_decoder_context* ctx,
                                    de265_image_spec* spec, de265_image* img, void* userdata)
 {
-  int luma_stride   = (spec->width   + spec->alignment-1) / spec->alignment * spec->alignment;
-  int chroma_stride = (spec->width/2 + spec->alignment-1) / spec->alignment * spec->alignment;
+  // images allocated outside of a decoder (ctx==NULL) use the default settings
+
+  decoder_context* decctx = (decoder_context*)ctx;
+  bool useHugePages = (decctx ? decctx->param_huge_pages : true);
+  int  numa_node    = (decctx ? decctx->param_numa_node  : -1);
 
   int luma_height   = spec->height;
+  int chroma_width  = (spec->width +1)/2;
   int chroma_height = (spec->height+1)/2;
 
-  uint8_t* p[3] = { 0,0,0 };
-  p[0] = (uint8_t *)ALLOC_ALIGNED_16(luma_stride   * luma_height   + MEMORY_PADDING);
-  p[1] = (uint8_t *)ALLOC_ALIGNED_16(chroma_stride * chroma_height + MEMORY_PADDING);
-  p[2] = (uint8_t *)ALLOC_ALIGNED_16(chroma_stride * chroma_height + MEMORY_PADDING);
+  if (spec->format == de265_image_format_YUV422P8 ||
+      spec->format == de265_image_format_YUV422P16) {
+    chroma_height = spec->height;
+  }
 
-  if (p[0]==NULL || p[1]==NULL || p[2]==NULL) {
-    for (int i=0;i<3;i++)
-      if (p[i]) {
-        FREE_ALIGNED(p[i]);
-      }
+  const int alignment = spec->alignment;
+
+  int luma_bpl   = alias_free_bytes_per_line(spec->width,  img->get_bytes_per_pixel(0), alignment);
+  int chroma_bpl = alias_free_bytes_per_line(chroma_width, img->get_bytes_per_pixel(1), alignment);
+
+  size_t luma_size   = ((size_t)luma_bpl   * luma_height   + MEMORY_PADDING + alignment-1) & ~(size_t)(alignment-1);
+  size_t chroma_size = ((size_t)chroma_bpl * chroma_height + MEMORY_PADDING + alignment-1) & ~(size_t)(alignment-1);
+
+  size_t total_size = luma_size + 2*chroma_size;
 
+  bool hugePages = (useHugePages && total_size >= DE265_HUGE_PAGE_SIZE);
+
+  uint8_t* mem = (uint8_t *)ALLOC_ALIGNED(hugePages ? DE265_HUGE_PAGE_SIZE : alignment,
+                                          total_size);
+  if (mem==NULL) {
     return 0;
   }
 
-  img->set_image_plane(0, p[0], luma_stride, NULL);
-  img->set_image_plane(1, p[1], chroma_stride, NULL);
-  img->set_image_plane(2, p[2], chroma_stride, NULL);
+  if (hugePages) {
+    de265_advise_huge_pages(mem, total_size);
+  }
+
+  // place the planes on the node of the decoding threads
+
+  if (numa_node >= 0) {
+    de265_numa_bind_memory(mem, total_size, numa_node);
+  }
+
+  img->set_image_plane(0, mem,                        luma_bpl   / img->get_bytes_per_pixel(0), NULL);
+  img->set_image_plane(1, mem+luma_size,              chroma_bpl / img->get_bytes_per_pixel(1), NULL);
+  img->set_image_plane(2, mem+luma_size+chroma_size,  chroma_bpl / img->get_bytes_per_pixel(2), NULL);
 
   return 1;
 }
@@ -96,11 +137,11 @@ static int  de265_image_get_buffer(de265_decoder_context* ctx,
 static void de265_image_release_buffer(de265_decoder_context* ctx,
                                        de265_image* img, void* userdata)
 {
-  for (int i=0;i<3;i++) {
-    uint8_t* p = (uint8_t*)img->get_image_plane(i);
-    assert(p);
-    FREE_ALIGNED(p);
-  }
+  // the chroma planes are part of the luma allocation
+
+  uint8_t* p = (uint8_t*)img->get_image_plane(0);
+  assert(p);
+  FREE_ALIGNED(p);
 }
 
 
@@ -140,12 +181,16 @@ de265_image::de265_image()
 
   width=height=0;
 
+  BitDepth_Y = BitDepth_C = 8;
+  bpp_shift[0] = bpp_shift[1] = bpp_shift[2] = 0;
+
   pts = 0;
   user_data = NULL;
 
   ctb_progress = NULL;
 
   integrity = INTEGRITY_NOT_DECODED;
+  tiles_skipped = false;
 
   picture_order_cnt_lsb = -1; // undefined
   PicOrderCntVal = -1; // undefined
@@ -160,6 +205,18 @@ de265_image::de265_image()
 
   de265_mutex_init(&mutex);
   de265_cond_init(&finished_cond);
+
+  rows_output = 0;
+  row_output_progress = CTB_PROGRESS_PREFILTER;
+  row_output_pixels = this;
+  de265_mutex_init(&row_output_mutex);
+
+  for (int c=0;c<3;c++) {
+    tiled_pixels[c] = NULL;
+    tiled_width[c] = 0;
+    tiled_size[c] = 0;
+  }
+  tiled_planes_valid = false;
 }
 
 
@@ -187,6 +244,9 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
   this->user_data = user_data;
   this->pts = pts;
 
+  tiled_planes_valid = false;
+  tiles_skipped = false;
+
   de265_image_spec spec;
 
   int WinUnitX, WinUnitY;
@@ -200,15 +260,25 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
     assert(0);
   }
 
+  // samples with more than 8 bits are stored in 16 bit
+
+  BitDepth_Y = sps ? sps->BitDepth_Y : 8;
+  BitDepth_C = sps ? sps->BitDepth_C : 8;
+
+  bpp_shift[0] = (BitDepth_Y > 8);
+  bpp_shift[1] = bpp_shift[2] = (BitDepth_C > 8);
+
+  bool wide = (BitDepth_Y > 8 || BitDepth_C > 8);
+
   switch (chroma_format) {
   case de265_chroma_420:
-    spec.format = de265_image_format_YUV420P8;
+    spec.format = wide ? de265_image_format_YUV420P16 : de265_image_format_YUV420P8;
     chroma_width  = (chroma_width +1)/2;
     chroma_height = (chroma_height+1)/2;
     break;
 
   case de265_chroma_422:
-    spec.format = de265_image_format_YUV422P8;
+    spec.format = wide ? de265_image_format_YUV422P16 : de265_image_format_YUV422P8;
     chroma_height = (chroma_height+1)/2;
     break;
 
@@ -219,7 +289,7 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
 
   spec.width  = w;
   spec.height = h;
-  spec.alignment = 16;
+  spec.alignment = 64;  // a cache line, sufficient for AVX-512 loads
 
 
   // conformance window cropping
@@ -233,6 +303,7 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
   height_confwin= height- (top+bottom)*WinUnitY;
   chroma_width_confwin = chroma_width -left-right;
   chroma_height_confwin= chroma_height-top-bottom;
+  confwin_top = top*WinUnitY;
 
   spec.crop_left  = left *WinUnitX;
   spec.crop_right = right*WinUnitX;
@@ -245,8 +316,8 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
 
   // allocate memory and set conformance window pointers
 
-  void* alloc_userdata = decctx->param_image_allocation_userdata;
-  if (isOutputImage) {
+  void* alloc_userdata = (decctx ? decctx->param_image_allocation_userdata : NULL);
+  if (isOutputImage && decctx) {
     image_allocation_functions = decctx->param_image_allocation_functions;
   }
   else {
@@ -255,9 +326,9 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
   bool mem_alloc_success = image_allocation_functions.get_buffer(decctx, &spec, this,
                                                                  alloc_userdata);
 
-  pixels_confwin[0] = pixels[0] + left*WinUnitX + top*WinUnitY*stride;
-  pixels_confwin[1] = pixels[1] + left + top*chroma_stride;
-  pixels_confwin[2] = pixels[2] + left + top*chroma_stride;
+  pixels_confwin[0] = get_image_plane_at_pos(0, left*WinUnitX, top*WinUnitY);
+  pixels_confwin[1] = get_image_plane_at_pos(1, left, top);
+  pixels_confwin[2] = get_image_plane_at_pos(2, left, top);
 
 
   // check for memory shortage
@@ -290,6 +361,11 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
 
     mem_alloc_success &= pb_info.alloc(puWidth,puHeight, 2);
 
+    // compressed motion field for TMVP
+
+    mem_alloc_success &= colmv_info.alloc((sps->pic_width_in_luma_samples +15)/16,
+                                          (sps->pic_height_in_luma_samples+15)/16, 4);
+
 
     // tu info
 
@@ -322,6 +398,38 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
       {
         return DE265_ERROR_OUT_OF_MEMORY;
       }
+
+
+    if (decctx->param_numa_node >= 0) {
+      int node = decctx->param_numa_node;
+
+      intraPredMode.bind_to_numa_node(node);
+      cb_info   .bind_to_numa_node(node);
+      pb_info   .bind_to_numa_node(node);
+      colmv_info.bind_to_numa_node(node);
+      tu_info   .bind_to_numa_node(node);
+      deblk_info.bind_to_numa_node(node);
+      ctb_info  .bind_to_numa_node(node);
+    }
+
+
+    // a CTB row is final after the last filter stage that is applied to it
+
+    rows_output = 0;
+    row_output_pixels = this;
+
+    if (decctx->param_parse_only) {
+      row_output_progress = CTB_PROGRESS_PREFILTER;
+    }
+    else if (!decctx->param_disable_sao && sps->sample_adaptive_offset_enabled_flag) {
+      row_output_progress = CTB_PROGRESS_SAO;
+    }
+    else if (!decctx->param_disable_deblocking) {
+      row_output_progress = CTB_PROGRESS_DEBLK_H;
+    }
+    else {
+      row_output_progress = CTB_PROGRESS_PREFILTER;
+    }
   }
 
   return DE265_OK;
@@ -340,6 +448,7 @@ de265_image::~de265_image()
 
   de265_cond_destroy(&finished_cond);
   de265_mutex_destroy(&mutex);
+  de265_mutex_destroy(&row_output_mutex);
 }
 
 
@@ -359,6 +468,8 @@ void de265_image::release()
         }
     }
 
+  free_tiled_planes();
+
   // free slices
 
   for (int i=0;i<slices.size();i++) {
@@ -368,18 +479,141 @@ void de265_image::release()
 }
 
 
+bool de265_image::alloc_tiled_planes()
+{
+  tiled_planes_valid = false;
+
+  const int T = REF_TILE_LOG2_SIZE;
+
+  for (int c=0;c<3;c++) {
+    if (pixels[c]==NULL) {
+      continue;
+    }
+
+    int widthInTiles  = (get_width(c)  + (1<<T)-1) >> T;
+    int heightInTiles = (get_height(c) + (1<<T)-1) >> T;
+
+    size_t size = ((size_t)(widthInTiles*heightInTiles) << (2*T)) << bpp_shift[c];
+
+    if (size != tiled_size[c]) {
+      if (tiled_pixels[c]) {
+        FREE_ALIGNED(tiled_pixels[c]);
+      }
+
+      // tiles start at cache line boundaries
+
+      tiled_pixels[c] = (uint8_t*)ALLOC_ALIGNED(64, size);
+      if (tiled_pixels[c]==NULL) {
+        tiled_size[c] = 0;
+        return false;
+      }
+
+      tiled_size[c] = size;
+
+      if (decctx && decctx->param_huge_pages) {
+        de265_advise_huge_pages(tiled_pixels[c], size);
+      }
+
+      if (decctx && decctx->param_numa_node >= 0) {
+        de265_numa_bind_memory(tiled_pixels[c], size, decctx->param_numa_node);
+      }
+    }
+
+    tiled_width[c] = widthInTiles;
+  }
+
+  return true;
+}
+
+
+void de265_image::free_tiled_planes()
+{
+  for (int c=0;c<3;c++) {
+    if (tiled_pixels[c]) {
+      FREE_ALIGNED(tiled_pixels[c]);
+    }
+
+    tiled_pixels[c] = NULL;
+    tiled_width[c] = 0;
+    tiled_size[c] = 0;
+  }
+
+  tiled_planes_valid = false;
+}
+
+
+template <class pixel_t>
+static void tile_plane_rows(pixel_t* dst, int tiledWidth,
+                            const pixel_t* src, int stride, int width,
+                            int firstRow, int endRow)
+{
+  const int tileSize = 1<<REF_TILE_LOG2_SIZE;
+
+  for (int y=firstRow;y<endRow;y++) {
+    const pixel_t* srcRow = src + y*stride;
+
+    for (int x=0;x<width;x+=tileSize) {
+      int n = std::min(tileSize, width-x);
+      memcpy(dst + de265_image::get_tiled_offset(x,y,tiledWidth), srcRow+x, n*sizeof(pixel_t));
+    }
+  }
+}
+
+
+void de265_image::tile_ctb_rows(int firstCtbRow, int endCtbRow)
+{
+  const int ctbSize = sps.CtbSizeY;
+
+  for (int c=0;c<3;c++) {
+    if (tiled_pixels[c]==NULL) {
+      continue;
+    }
+
+    int rowsPerCtb = (c==0 ? ctbSize : ctbSize / sps.SubHeightC);
+
+    int first = firstCtbRow * rowsPerCtb;
+    int end   = std::min(get_height(c), endCtbRow * rowsPerCtb);
+
+    if (high_bit_depth(c)) {
+      tile_plane_rows((uint16_t*)tiled_pixels[c], tiled_width[c],
+                      (const uint16_t*)pixels[c], get_image_stride(c), get_width(c),
+                      first, end);
+    }
+    else {
+      tile_plane_rows(tiled_pixels[c], tiled_width[c],
+                      pixels[c], get_image_stride(c), get_width(c),
+                      first, end);
+    }
+  }
+}
+
+
+static void fill_plane(uint8_t* p, int value, int nSamples, int bpp_shift)
+{
+  if (bpp_shift==0) {
+    memset(p, value, nSamples);
+  }
+  else {
+    uint16_t* p16 = (uint16_t*)p;
+    for (int i=0;i<nSamples;i++) {
+      p16[i] = value;
+    }
+  }
+}
+
+
 void de265_image::fill_image(int y,int cb,int cr)
 {
   if (y>=0) {
-    memset(pixels[0], y, stride * height);
+    fill_plane(pixels[0], y, stride * height, bpp_shift[0]);
   }
 
   if (cb>=0) {
-    memset(pixels[1], cb, chroma_stride * chroma_height);
+    fill_plane(pixels[1], cb, chroma_stride * chroma_height, bpp_shift[1]);
   }
 
   if (cr>=0) {
-    memset(pixels[2], cr, chroma_stride * chroma_height);
+    fill_plane(pixels[2], cr, chroma_stride * chroma_height, bpp_shift[2]);
   }
 }
 
@@ -412,14 +646,18 @@ void de265_image::copy_lines_from(const de265_image* src, int first, int end)
   assert(first % 2 == 0);
   assert(end   % 2 == 0);
 
+  assert(src->bpp_shift[0] == bpp_shift[0]);
+  assert(src->bpp_shift[1] == bpp_shift[1]);
+
   if (src->stride == stride) {
-    memcpy(pixels[0]      + first*stride,
-           src->pixels[0] + first*src->stride,
-           (end-first)*stride);
+    memcpy(get_image_plane_at_pos(0,0,first),
+           src->get_image_plane_at_pos(0,0,first),
+           (end-first)*stride << bpp_shift[0]);
   }
   else {
     for (int yp=first;yp<end;yp++) {
-      memcpy(pixels[0]+yp*stride, src->pixels[0]+yp*src->stride, src->width);
+      memcpy(get_image_plane_at_pos(0,0,yp), src->get_image_plane_at_pos(0,0,yp),
+             src->width << bpp_shift[0]);
     }
   }
 
@@ -427,18 +665,17 @@ void de265_image::copy_lines_from(const de265_image* src, int first, int end)
   int end_chroma   = end>>1;
 
   if (src->chroma_format != de265_chroma_mono) {
-    if (src->chroma_stride == chroma_stride) {
-      memcpy(pixels[1]      + first_chroma*chroma_stride,
-             src->pixels[1] + first_chroma*chroma_stride,
-             (end_chroma-first_chroma) * chroma_stride);
-      memcpy(pixels[2]      + first_chroma*chroma_stride,
-             src->pixels[2] + first_chroma*chroma_stride,
-             (end_chroma-first_chroma) * chroma_stride);
-    }
-    else {
-      for (int y=first_chroma;y<end_chroma;y++) {
-        memcpy(pixels[1]+y*chroma_stride, src->pixels[1]+y*src->chroma_stride, src->chroma_width);
-        memcpy(pixels[2]+y*chroma_stride, src->pixels[2]+y*src->chroma_stride, src->chroma_width);
+    for (int c=1;c<=2;c++) {
+      if (src->chroma_stride == chroma_stride) {
+        memcpy(get_image_plane_at_pos(c,0,first_chroma),
+               src->get_image_plane_at_pos(c,0,first_chroma),
+               (end_chroma-first_chroma) * chroma_stride << bpp_shift[c]);
+      }
+      else {
+        for (int y=first_chroma;y<end_chroma;y++) {
+          memcpy(get_image_plane_at_pos(c,0,y), src->get_image_plane_at_pos(c,0,y),
+                 src->chroma_width << bpp_shift[c]);
+        }
       }
     }
   }
@@ -529,13 +766,80 @@ void de265_image::wait_for_progress(thread_task* task, int ctbAddrRS, int progre
        Simplest concealment: do not block.
     */
 
-    progresslock->wait_for_progress(progress);
+    if (task->blocked_time) {
+      int64_t start = de265_get_time_usec();
+      progresslock->wait_for_progress(progress);
+      *task->blocked_time += de265_get_time_usec() - start;
+    }
+    else {
+      progresslock->wait_for_progress(progress);
+    }
+
     task->state = thread_task::Running;
     thread_unblocks();
   }
 }
 
 
+void de265_image::mark_tile_skipped(int tileID)
+{
+  tiles_skipped = true;
+
+  int col = tileID % pps.num_tile_columns;
+  int row = tileID / pps.num_tile_columns;
+
+  for (int y=pps.rowBd[row]; y<pps.rowBd[row+1]; y++)
+    for (int x=pps.colBd[col]; x<pps.colBd[col+1]; x++) {
+      ctb_progress[x + y*sps.PicWidthInCtbsY].set_progress(CTB_PROGRESS_PREFILTER);
+    }
+}
+
+
+void de265_image::output_finished_rows(bool all)
+{
+  if (decctx==NULL || decctx->param_row_output_callback==NULL) {
+    return;
+  }
+
+  de265_mutex_lock(&row_output_mutex);
+
+  const int nRows    = sps.PicHeightInCtbsY;
+  const int ctbW     = sps.PicWidthInCtbsY;
+  const int ctbSize  = sps.CtbSizeY;
+
+  while (rows_output < nRows) {
+    int row = rows_output;
+
+    if (!all) {
+      int lastCtb = (row+1)*ctbW -1;
+
+      if (ctb_progress[lastCtb].get_progress() < row_output_progress) {
+        break;
+      }
+
+      // horizontal deblocking of the row below also modifies the last lines of this row
+
+      if (row_output_progress == CTB_PROGRESS_DEBLK_H && row+1 < nRows &&
+          ctb_progress[lastCtb+ctbW].get_progress() < CTB_PROGRESS_DEBLK_H) {
+        break;
+      }
+    }
+
+    int first = std::max(0,              row   *ctbSize - confwin_top);
+    int end   = std::min(height_confwin, (row+1)*ctbSize - confwin_top);
+
+    if (end > first) {
+      decctx->param_row_output_callback(decctx->param_row_output_userdata,
+                                        row_output_pixels, first, end);
+    }
+
+    rows_output++;
+  }
+
+  de265_mutex_unlock(&row_output_mutex);
+}
+
+
 void de265_image::wait_for_completion()
 {
   de265_mutex_lock(&mutex);
@@ -561,6 +865,7 @@ void de265_image::clear_metadata()
   tu_info.clear();
   ctb_info.clear();
   deblk_info.clear();
+  colmv_info.clear();
 
   // --- reset CTB progresses ---
 
@@ -589,6 +894,109 @@ void de265_image::set_mv_info(int x,int y, int nPbW,int nPbH, const PredVectorIn
 }
 
 
+// the exported element types have to match the internal metadata
+
+typedef char check_motion_info_layout[ (sizeof(de265_motion_info) == sizeof(PredVectorInfo) &&
+                                        offsetof(de265_motion_info, mv) ==
+                                        offsetof(PredVectorInfo, mv)) ? 1 : -1 ];
+typedef char check_pb_info_layout[ sizeof(PB_ref_info) == sizeof(PredVectorInfo) ? 1 : -1 ];
+typedef char check_colmv_info_layout[ offsetof(ColMV_ref_info, mvi) == 0 ? 1 : -1 ];
+
+template <class DataUnit>
+static const void* get_metadata_array(const MetaDataArray<DataUnit>& array,
+                                      de265_metadata_layout* layout)
+{
+  if (array.data == NULL) {
+    return NULL;
+  }
+
+  if (layout) {
+    layout->element_size   = sizeof(DataUnit);
+    layout->stride         = sizeof(DataUnit) * array.width_in_units;
+    layout->log2_unit_size = array.log2unitSize;
+    layout->width          = array.width_in_units;
+    layout->height         = array.height_in_units;
+  }
+
+  return array.data;
+}
+
+
+const void* de265_image::get_metadata(enum de265_metadata_type type,
+                                      de265_metadata_layout* layout) const
+{
+  switch (type) {
+  case de265_metadata_motion:            return get_metadata_array(pb_info,       layout);
+  case de265_metadata_compressed_motion: return get_metadata_array(colmv_info,    layout);
+  case de265_metadata_coding_blocks:     return get_metadata_array(cb_info,       layout);
+  case de265_metadata_intra_modes:       return get_metadata_array(intraPredMode, layout);
+  }
+
+  return NULL;
+}
+
+
+void de265_image::compress_motion_field(bool keep_full_motion_field)
+{
+  if (pb_info.data == NULL) {
+    return;
+  }
+
+  for (int y=0;y<colmv_info.height_in_units;y++)
+    for (int x=0;x<colmv_info.width_in_units;x++)
+      {
+        int xL = x<<colmv_info.log2unitSize;
+        int yL = y<<colmv_info.log2unitSize;
+
+        ColMV_ref_info& col = colmv_info[ x + y*colmv_info.width_in_units ];
+
+        if (get_pred_mode(xL,yL) == MODE_INTRA) {
+          col.mvi.predFlag[0] = 0;
+          col.mvi.predFlag[1] = 0;
+        }
+        else {
+          col.mvi = pb_info.get(xL,yL).mvi;
+
+          const slice_segment_header* shdr = get_SliceHeader(xL,yL);
+
+          for (int l=0;l<2;l++) {
+            if (col.mvi.predFlag[l]) {
+              col.refPOC[l]        = shdr->RefPicList_POC[l][ col.mvi.refIdx[l] ];
+              col.refIsLongTerm[l] = shdr->LongTermRefPic[l][ col.mvi.refIdx[l] ];
+            }
+          }
+        }
+      }
+
+  if (!keep_full_motion_field) {
+    pb_info.free_data();
+  }
+}
+
+
+void de265_image::release_metadata(bool keep_motion_field)
+{
+  if (!keep_motion_field) {
+    colmv_info.free_data();
+  }
+
+  intraPredMode.free_data();
+  cb_info   .free_data();
+  pb_info   .free_data();
+  tu_info   .free_data();
+  deblk_info.free_data();
+  ctb_info  .free_data();
+
+  delete[] ctb_progress;
+  ctb_progress = NULL;
+
+  for (size_t i=0;i<slices.size();i++) {
+    delete slices[i];
+  }
+  slices.clear();
+}
+
+
 bool de265_image::available_zscan(int xCurr,int yCurr, int xN,int yN) const
 {
   if (xN<0 || yN<0) return false;
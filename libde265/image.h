@@ -70,6 +70,8 @@ enum PictureState {
 #define DEBLOCK_PB_EDGE_VERTI (1<<6)
 #define DEBLOCK_PB_EDGE_HORIZ (1<<7)
 #define DEBLOCK_BS_MASK     0x03
+#define DEBLOCK_BS_SHIFT_VERTI 0  // bS of the vertical edge in bits [0;1]
+#define DEBLOCK_BS_SHIFT_HORIZ 2  // bS of the horizontal edge in bits [2;3]
 
 
 #define CTB_PROGRESS_NONE      0
@@ -78,6 +80,9 @@ enum PictureState {
 #define CTB_PROGRESS_DEBLK_H   3
 #define CTB_PROGRESS_SAO       4
 
+// reference pictures can be stored in blocks of (1<<REF_TILE_LOG2_SIZE)^2 samples
+#define REF_TILE_LOG2_SIZE 4
+
 template <class DataUnit> class MetaDataArray
 {
  public:
@@ -104,6 +109,15 @@ template <class DataUnit> class MetaDataArray
     if (data) memset(data, 0, sizeof(DataUnit) * data_size);
   }
 
+  void free_data() {
+    free(data);
+    data=NULL; data_size=0; width_in_units=0; height_in_units=0;
+  }
+
+  void bind_to_numa_node(int node) {
+    if (data) de265_numa_bind_memory(data, sizeof(DataUnit) * data_size, node);
+  }
+
   const DataUnit& get(int x,int y) const {
     int unitX = x>>log2unitSize;
     int unitY = y>>log2unitSize;
@@ -158,25 +172,26 @@ typedef struct {
 } CTB_info;
 
 
-typedef struct {
-  uint8_t log2CbSize : 3;   // [0;6] (1<<log2CbSize) = 64
-  uint8_t PartMode : 3;     // (enum PartMode)  [0;7] set only in top-left of CB
-                            // TODO: could be removed if prediction-block-boundaries would be
-                            // set during decoding
-  uint8_t ctDepth : 2;      // [0:3]? (0:64, 1:32, 2:16, 3:8)
-  uint8_t PredMode : 2;     // (enum PredMode)  [0;2] must be saved for past images
-  uint8_t pcm_flag : 1;     //
-  uint8_t cu_transquant_bypass : 1;
+// The CB metadata is exported in this layout through de265_get_image_metadata().
+//  log2CbSize : [0;6] (1<<log2CbSize) = 64
+//  PartMode   : (enum PartMode)  [0;7] set only in top-left of CB
+//               TODO: could be removed if prediction-block-boundaries would be
+//               set during decoding
+//  ctDepth    : [0:3]? (0:64, 1:32, 2:16, 3:8)
+//  PredMode   : (enum PredMode)  [0;2] must be saved for past images
+typedef de265_coding_block_info CB_ref_info;
 
-  int8_t  QP_Y;
 
-  // uint8_t pcm_flag;  // TODO
-} CB_ref_info;
+typedef struct {
+  PredVectorInfo mvi;
+} PB_ref_info;
 
 
 typedef struct {
-  PredVectorInfo mvi; // TODO: this can be done in 16x16 grid
-} PB_ref_info;
+  PredVectorInfo mvi;
+  int32_t refPOC[2];        // POC of the reference picture used in each list
+  uint8_t refIsLongTerm[2]; // reference picture was marked as long-term
+} ColMV_ref_info;
 
 
 
@@ -204,26 +219,34 @@ struct de265_image {
   /* */ uint8_t* get_image_plane(int cIdx)       { return pixels[cIdx]; }
   const uint8_t* get_image_plane(int cIdx) const { return pixels[cIdx]; }
 
+  // 'stride' in samples
   void set_image_plane(int cIdx, uint8_t* mem, int stride, void *userdata);
 
+  /* Address of the sample at (xpos,ypos). For high bit depths, the planes store
+     uint16_t samples and the returned pointer has to be cast accordingly. */
   uint8_t* get_image_plane_at_pos(int cIdx, int xpos,int ypos)
   {
     int stride = get_image_stride(cIdx);
-    return pixels[cIdx] + xpos + ypos*stride;
+    return pixels[cIdx] + ((xpos + ypos*stride) << bpp_shift[cIdx]);
   }
 
   const uint8_t* get_image_plane_at_pos(int cIdx, int xpos,int ypos) const
   {
     int stride = get_image_stride(cIdx);
-    return pixels[cIdx] + xpos + ypos*stride;
+    return pixels[cIdx] + ((xpos + ypos*stride) << bpp_shift[cIdx]);
   }
 
+  // stride in samples (not bytes)
   int get_image_stride(int cIdx) const
   {
     if (cIdx==0) return stride;
     else         return chroma_stride;
   }
 
+  int  get_bit_depth(int cIdx) const { return cIdx==0 ? BitDepth_Y : BitDepth_C; }
+  bool high_bit_depth(int cIdx) const { return get_bit_depth(cIdx) > 8; } // uint16_t samples
+  int  get_bytes_per_pixel(int cIdx) const { return 1<<bpp_shift[cIdx]; }
+
   int get_luma_stride() const { return stride; }
   int get_chroma_stride() const { return chroma_stride; }
 
@@ -264,6 +287,9 @@ private:
   int chroma_width, chroma_height;
   int stride, chroma_stride;
 
+  int BitDepth_Y, BitDepth_C;
+  int bpp_shift[3];  // log2 of the bytes per sample
+
 public:
   std::vector<slice_segment_header*> slices;
 
@@ -275,6 +301,7 @@ public:
 
   int width_confwin, height_confwin;
   int chroma_width_confwin, chroma_height_confwin;
+  int confwin_top;  // luma lines cropped at the top
 
   // --- decoding info ---
 
@@ -295,7 +322,8 @@ public:
 private:
   MetaDataArray<CTB_info>    ctb_info;
   MetaDataArray<CB_ref_info> cb_info;
-  MetaDataArray<PB_ref_info> pb_info;
+  MetaDataArray<PB_ref_info> pb_info;    // 4x4 grid, freed after decoding unless kept for export
+  MetaDataArray<ColMV_ref_info> colmv_info; // 16x16 grid, kept for collocated MV lookup
   MetaDataArray<uint8_t>     intraPredMode;
   MetaDataArray<uint8_t>     tu_info;
   MetaDataArray<uint8_t>     deblk_info;
@@ -313,6 +341,7 @@ public:
                         and changed on decoding errors.
                       */
   bool sei_hash_check_result;
+  bool tiles_skipped; // tiles outside of the region of interest have not been decoded
 
   nal_header nal_hdr;
 
@@ -326,6 +355,9 @@ public:
     }
   }
 
+  // a tile outside of the region of interest is not decoded, but counts as reconstructed
+  void mark_tile_skipped(int tileID);
+
 
   void thread_start(int nThreads);
   void thread_run();
@@ -353,6 +385,54 @@ public:
   de265_mutex mutex;
   de265_cond  finished_cond;
 
+
+  // --- low-latency output of finished CTB rows ---
+
+  /* Pass all CTB rows that have reached their final state to the decoder's row output
+     callback, in top-to-bottom order. Call this whenever a CTB row has made progress.
+     With 'all', the remaining rows are output regardless of their progress. */
+  void output_finished_rows(bool all=false);
+
+  int rows_output;          // number of CTB rows passed to the row output callback
+  int row_output_progress;  // CTB progress at which a CTB row is final
+  const de265_image* row_output_pixels; // holds the final pixels (SAO output while SAO runs)
+  de265_mutex row_output_mutex;
+
+
+  // --- block-tiled copy of a reference picture for motion compensation ---
+
+  /* With DE265_DECODER_PARAM_TILED_REFERENCES, the final pixels of pictures that may be
+     referenced are copied into a block-linear layout: each 16x16 block of samples is
+     stored contiguously, the blocks in raster order. A prediction block fetch then
+     touches a few neighboring blocks instead of one cache line per row at a large
+     stride. The raster planes are kept for output and for the in-loop filters. */
+
+  bool alloc_tiled_planes(); // also marks the tiled copy as outdated
+  void free_tiled_planes();
+
+  // copy the CTB rows [firstCtbRow;endCtbRow) of all planes into the tiled planes
+  void tile_ctb_rows(int firstCtbRow, int endCtbRow);
+
+  bool has_tiled_planes() const { return tiled_planes_valid; }
+  void set_tiled_planes_valid() { tiled_planes_valid = true; }
+
+  const uint8_t* get_tiled_plane(int cIdx) const { return tiled_pixels[cIdx]; }
+  int get_tiled_width(int cIdx) const { return tiled_width[cIdx]; } // width in tiles
+
+  // offset in samples of (x,y) in a tiled plane that is 'tiledWidth' tiles wide
+  static int get_tiled_offset(int x,int y, int tiledWidth)
+  {
+    const int T = REF_TILE_LOG2_SIZE;
+    return ((((y>>T)*tiledWidth + (x>>T)) << (2*T)) +
+            ((y & ((1<<T)-1)) << T) + (x & ((1<<T)-1)));
+  }
+
+private:
+  uint8_t* tiled_pixels[3];
+  int      tiled_width[3];
+  size_t   tiled_size[3];   // allocated bytes
+  bool     tiled_planes_valid;
+
 public:
 
   /* Clear all CTB/CB/PB decoding data of this image.
@@ -360,6 +440,16 @@ public:
   */
   void clear_metadata();
 
+  /* Free all decoding data. The compressed motion field is kept for TMVP if
+     'keep_motion_field' is set. Call after compress_motion_field() when the picture
+     is completely filtered. The CB/TU/CTB metadata and slice headers cannot be
+     accessed afterwards, the next alloc_image() allocates them again.
+  */
+  void release_metadata(bool keep_motion_field);
+
+  // read-only view of a metadata array, NULL if not allocated
+  const void* get_metadata(enum de265_metadata_type type, de265_metadata_layout* layout) const;
+
 
   // --- CB metadata access ---
 
@@ -627,16 +717,18 @@ public:
     return deblk_info[xd + yd*deblk_info.width_in_units];
   }
 
-  void    set_deblk_bS(int x0,int y0, uint8_t bS)
+  void    set_deblk_bS(int x0,int y0, bool vertical, uint8_t bS)
   {
+    int shift = vertical ? DEBLOCK_BS_SHIFT_VERTI : DEBLOCK_BS_SHIFT_HORIZ;
     uint8_t* data = &deblk_info[x0/4 + y0/4*deblk_info.width_in_units];
-    *data &= ~DEBLOCK_BS_MASK;
-    *data |= bS;
+    *data &= ~(DEBLOCK_BS_MASK << shift);
+    *data |= bS << shift;
   }
 
-  uint8_t get_deblk_bS(int x0,int y0) const
+  uint8_t get_deblk_bS(int x0,int y0, bool vertical) const
   {
-    return deblk_info[x0/4 + y0/4*deblk_info.width_in_units] & DEBLOCK_BS_MASK;
+    int shift = vertical ? DEBLOCK_BS_SHIFT_VERTI : DEBLOCK_BS_SHIFT_HORIZ;
+    return (deblk_info[x0/4 + y0/4*deblk_info.width_in_units] >> shift) & DEBLOCK_BS_MASK;
   }
 
 
@@ -649,6 +741,24 @@ public:
 
   void set_mv_info(int x,int y, int nPbW,int nPbH, const PredVectorInfo* mv);
 
+  bool has_mv_info() const { return pb_info.data != NULL; }
+
+  /* Motion data of the 16x16 block containing (x,y), as used for TMVP.
+     Intra blocks are stored with both predFlags cleared.
+     The POCs of the reference pictures are stored along with the vectors, such that
+     the slice headers of the collocated picture are not needed anymore.
+   */
+  const ColMV_ref_info* get_collocated_mv_info(int x,int y) const
+  {
+    return &colmv_info.get(x,y);
+  }
+
+  /* Subsample the motion field into the 16x16 grid (8.5.3.2.8) and
+     release the full-resolution field, unless it is kept for export.
+     Call when the picture is completely decoded.
+   */
+  void compress_motion_field(bool keep_full_motion_field);
+
 // --- value logging ---
 
 };
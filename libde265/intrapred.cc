@@ -29,7 +29,8 @@
 
 
 #ifdef DE265_LOG_TRACE
-void print_border(uint8_t* data, uint8_t* available, int nT)
+template <class pixel_t>
+void print_border(pixel_t* data, uint8_t* available, int nT)
 {
   for (int i=-2*nT ; i<=2*nT ; i++) {
     if (i==0 || i==1 || i==-nT || i==nT+1) {
@@ -52,9 +53,10 @@ void print_border(uint8_t* data, uint8_t* available, int nT)
 
 
 // (8.4.4.2.2)
+template <class pixel_t>
 void fill_border_samples(de265_image* img, int xB,int yB,
                          int nT, int cIdx,
-                         uint8_t* out_border)
+                         pixel_t* out_border)
 {
   const seq_parameter_set* sps = &img->sps;
   const pic_parameter_set* pps = &img->pps;
@@ -62,9 +64,9 @@ void fill_border_samples(de265_image* img, int xB,int yB,
   uint8_t available_data[2*64 + 1];
   uint8_t* available = &available_data[64];
 
-  uint8_t* image;
+  pixel_t* image;
   int stride;
-  image  = img->get_image_plane(cIdx);
+  image  = (pixel_t*)img->get_image_plane(cIdx);
   stride = img->get_image_stride(cIdx);
 
   const int chromaShift = (cIdx==0) ? 0 : 1;
@@ -148,7 +150,7 @@ void fill_border_samples(de265_image* img, int xB,int yB,
 
   int nAvail=0;
 
-  uint8_t firstValue;
+  pixel_t firstValue;
 
   memset(available-2*nT, 0, 4*nT+1);
 
@@ -243,7 +245,10 @@ void fill_border_samples(de265_image* img, int xB,int yB,
 
     if (nAvail!=4*nT+1) {
       if (nAvail==0) {
-        memset(out_border-2*nT, 1<<(sps->bit_depth_luma-1), 4*nT+1);
+        const pixel_t defaultValue = 1<<(img->get_bit_depth(cIdx)-1);
+        for (int i=-2*nT; i<=2*nT; i++) {
+          out_border[i] = defaultValue;
+        }
       }
       else {
         if (!available[-2*nT]) {
@@ -269,8 +274,9 @@ void fill_border_samples(de265_image* img, int xB,int yB,
 
 
 // (8.4.4.2.3)
+template <class pixel_t>
 void intra_prediction_sample_filtering(de265_image* img,
-                                       uint8_t* p,
+                                       pixel_t* p,
                                        int nT,
                                        enum IntraPredMode intraPredMode)
 {
@@ -298,8 +304,8 @@ void intra_prediction_sample_filtering(de265_image* img,
                      abs_value(p[0]+p[-64]-2*p[-32]) < (1<<(img->sps.bit_depth_luma-5)))
       ? 1 : 0;
 
-    uint8_t  pF_mem[2*64+1];
-    uint8_t* pF = &pF_mem[64];
+    pixel_t  pF_mem[2*64+1];
+    pixel_t* pF = &pF_mem[64];
 
     if (biIntFlag) {
       pF[-2*nT] = p[-2*nT];
@@ -323,7 +329,7 @@ void intra_prediction_sample_filtering(de265_image* img,
 
     // copy back to original array
 
-    memcpy(p-2*nT, pF-2*nT, 4*nT+1);
+    memcpy(p-2*nT, pF-2*nT, (4*nT+1)*sizeof(pixel_t));
   }
   else {
     // do nothing ?
@@ -345,23 +351,20 @@ static const int invAngle_table[25-10] =
     -315,-390,-482,-630,-910,-1638,-4096 };
 
 
-// TODO: clip to read BitDepthY
-LIBDE265_INLINE static int Clip1Y(int x) { if (x<0) return 0; else if (x>255) return 255; else return x; }
-
-
 // (8.4.4.2.6)
+template <class pixel_t>
 void intra_prediction_angular(de265_image* img,
                               int xB0,int yB0,
                               enum IntraPredMode intraPredMode,
                               int nT,int cIdx,
-                              uint8_t* border)
+                              pixel_t* border)
 {
-  uint8_t  ref_mem[2*64+1];
-  uint8_t* ref=&ref_mem[64];
+  pixel_t  ref_mem[2*64+1];
+  pixel_t* ref=&ref_mem[64];
 
-  uint8_t* pred;
+  pixel_t* pred;
   int      stride;
-  pred   = img->get_image_plane_at_pos(cIdx,xB0,yB0);
+  pred   = (pixel_t*)img->get_image_plane_at_pos(cIdx,xB0,yB0);
   stride = img->get_image_stride(cIdx);
 
   int intraPredAngle = intraPredAngle_table[intraPredMode];
@@ -400,7 +403,8 @@ void intra_prediction_angular(de265_image* img,
 
     if (intraPredMode==26 && cIdx==0 && nT<32) {
       for (int y=0;y<nT;y++) {
-        pred[0+y*stride] = Clip1Y(border[1] + ((border[-1-y] - border[0])>>1));
+        pred[0+y*stride] = Clip_BitDepth(border[1] + ((border[-1-y] - border[0])>>1),
+                                         img->get_bit_depth(cIdx));
       }
     }
   }
@@ -438,7 +442,8 @@ void intra_prediction_angular(de265_image* img,
 
     if (intraPredMode==10 && cIdx==0 && nT<32) {  // DIFF 26->10
       for (int x=0;x<nT;x++) { // DIFF (x<->y)
-        pred[x] = Clip1Y(border[-1] + ((border[1+x] - border[0])>>1)); // DIFF (x<->y && neg)
+        pred[x] = Clip_BitDepth(border[-1] + ((border[1+x] - border[0])>>1), // DIFF (x<->y && neg)
+                                img->get_bit_depth(cIdx));
       }
     }
   }
@@ -456,12 +461,13 @@ void intra_prediction_angular(de265_image* img,
 }
 
 
+template <class pixel_t>
 void intra_prediction_planar(de265_image* img,int xB0,int yB0,int nT,int cIdx,
-                             uint8_t* border)
+                             pixel_t* border)
 {
-  uint8_t* pred;
+  pixel_t* pred;
   int      stride;
-  pred = img->get_image_plane_at_pos(cIdx,xB0,yB0);
+  pred = (pixel_t*)img->get_image_plane_at_pos(cIdx,xB0,yB0);
   stride = img->get_image_stride(cIdx);
 
   int Log2_nT = Log2(nT);
@@ -486,12 +492,13 @@ void intra_prediction_planar(de265_image* img,int xB0,int yB0,int nT,int cIdx,
 }
 
 
+template <class pixel_t>
 void intra_prediction_DC(de265_image* img,int xB0,int yB0,int nT,int cIdx,
-                         uint8_t* border)
+                         pixel_t* border)
 {
-  uint8_t* pred;
+  pixel_t* pred;
   int      stride;
-  pred = img->get_image_plane_at_pos(cIdx,xB0,yB0);
+  pred = (pixel_t*)img->get_image_plane_at_pos(cIdx,xB0,yB0);
   stride = img->get_image_stride(cIdx);
 
   int Log2_nT = Log2(nT);
@@ -539,11 +546,11 @@ void intra_prediction_DC(de265_image* img,int xB0,int yB0,int nT,int cIdx,
 
 
 
-// (8.4.4.2.1)
-void decode_intra_prediction(de265_image* img,
-                             int xB0,int yB0,
-                             enum IntraPredMode intraPredMode,
-                             int nT, int cIdx)
+template <class pixel_t>
+static void decode_intra_prediction_internal(de265_image* img,
+                                             int xB0,int yB0,
+                                             enum IntraPredMode intraPredMode,
+                                             int nT, int cIdx)
 {
   logtrace(LogIntraPred,"decode_intra_prediction xy0:%d/%d mode=%d nT=%d, cIdx=%d\n",
            xB0,yB0, intraPredMode, nT,cIdx);
@@ -552,8 +559,8 @@ void decode_intra_prediction(de265_image* img,
     xB0,yB0, intraPredMode, nT,cIdx);
   */
 
-  uint8_t  border_pixels_mem[2*64+1];
-  uint8_t* border_pixels = &border_pixels_mem[64];
+  pixel_t  border_pixels_mem[2*64+1];
+  pixel_t* border_pixels = &border_pixels_mem[64];
 
   fill_border_samples(img, xB0,yB0, nT, cIdx, border_pixels);
 
@@ -576,3 +583,16 @@ void decode_intra_prediction(de265_image* img,
 }
 
 
+// (8.4.4.2.1)
+void decode_intra_prediction(de265_image* img,
+                             int xB0,int yB0,
+                             enum IntraPredMode intraPredMode,
+                             int nT, int cIdx)
+{
+  if (img->high_bit_depth(cIdx)) {
+    decode_intra_prediction_internal<uint16_t>(img,xB0,yB0,intraPredMode,nT,cIdx);
+  }
+  else {
+    decode_intra_prediction_internal<uint8_t>(img,xB0,yB0,intraPredMode,nT,cIdx);
+  }
+}
@@ -28,6 +28,7 @@
 #include <sys/types.h>
 #include <signal.h>
 #include <string.h>
+#include <algorithm>
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
 # include <malloc.h>
@@ -44,16 +45,124 @@ static int extra_before[4] = { 0,3,3,2 };
 static int extra_after [4] = { 0,3,4,4 };
 
 
+// Dispatch of the interpolation functions to the 8 bit or high bit-depth versions.
 
+static inline void put_qpel(const decoder_context* ctx, int xFrac, int yFrac,
+                            int16_t* out, int out_stride, uint8_t* src, int src_stride,
+                            int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth)
+{
+  ctx->acceleration.put_hevc_qpel_8[xFrac][yFrac](out, out_stride, src, src_stride,
+                                                  nPbW,nPbH, mcbuffer);
+}
+
+static inline void put_qpel(const decoder_context* ctx, int xFrac, int yFrac,
+                            int16_t* out, int out_stride, uint16_t* src, int src_stride,
+                            int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth)
+{
+  ctx->acceleration.put_hevc_qpel_16[xFrac][yFrac](out, out_stride, src, src_stride,
+                                                   nPbW,nPbH, mcbuffer, bit_depth);
+}
+
+static inline void put_epel(const decoder_context* ctx, int xFrac, int yFrac,
+                            int16_t* out, int out_stride, uint8_t* src, int src_stride,
+                            int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth)
+{
+  if (xFrac && yFrac) {
+    ctx->acceleration.put_hevc_epel_hv_8(out, out_stride, src, src_stride,
+                                         nPbW,nPbH, xFrac,yFrac, mcbuffer);
+  }
+  else if (xFrac) {
+    ctx->acceleration.put_hevc_epel_h_8(out, out_stride, src, src_stride,
+                                        nPbW,nPbH, xFrac,yFrac, mcbuffer);
+  }
+  else if (yFrac) {
+    ctx->acceleration.put_hevc_epel_v_8(out, out_stride, src, src_stride,
+                                        nPbW,nPbH, xFrac,yFrac, mcbuffer);
+  }
+  else {
+    ctx->acceleration.put_hevc_epel_8(out, out_stride, src, src_stride,
+                                      nPbW,nPbH, 0,0, mcbuffer);
+  }
+}
+
+static inline void put_epel(const decoder_context* ctx, int xFrac, int yFrac,
+                            int16_t* out, int out_stride, uint16_t* src, int src_stride,
+                            int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth)
+{
+  if (xFrac && yFrac) {
+    ctx->acceleration.put_hevc_epel_hv_16(out, out_stride, src, src_stride,
+                                          nPbW,nPbH, xFrac,yFrac, mcbuffer, bit_depth);
+  }
+  else if (xFrac) {
+    ctx->acceleration.put_hevc_epel_h_16(out, out_stride, src, src_stride,
+                                         nPbW,nPbH, xFrac,yFrac, mcbuffer, bit_depth);
+  }
+  else if (yFrac) {
+    ctx->acceleration.put_hevc_epel_v_16(out, out_stride, src, src_stride,
+                                         nPbW,nPbH, xFrac,yFrac, mcbuffer, bit_depth);
+  }
+  else {
+    ctx->acceleration.put_hevc_epel_16(out, out_stride, src, src_stride,
+                                       nPbW,nPbH, 0,0, mcbuffer, bit_depth);
+  }
+}
+
+
+/* Copy the w x h block at (x0,y0) of plane cIdx from the tiled copy of 'refPic'.
+   Samples outside of the picture are replaced by the nearest border sample. */
+template <class pixel_t>
+static void fetch_tiled_block(const de265_image* refPic, int cIdx,
+                              pixel_t* dst, int dst_stride,
+                              int x0,int y0, int w,int h)
+{
+  const pixel_t* plane = (const pixel_t*)refPic->get_tiled_plane(cIdx);
+  const int tiledWidth = refPic->get_tiled_width(cIdx);
+  const int picW = refPic->get_width(cIdx);
+  const int picH = refPic->get_height(cIdx);
+  const int tileSize = 1<<REF_TILE_LOG2_SIZE;
+
+  const bool inside = (x0 >= 0 && x0+w <= picW);
+
+  for (int y=0;y<h;y++) {
+    int yA = Clip3(0,picH-1, y0+y);
+    pixel_t* out = dst + y*dst_stride;
+
+    if (inside) {
+      // copy the row in segments up to the next tile boundary
+
+      for (int x=0;x<w;) {
+        int xA = x0+x;
+        int n = std::min(w-x, tileSize - (xA & (tileSize-1)));
+
+        memcpy(out+x, plane + de265_image::get_tiled_offset(xA,yA,tiledWidth),
+               n*sizeof(pixel_t));
+        x += n;
+      }
+    }
+    else {
+      for (int x=0;x<w;x++) {
+        int xA = Clip3(0,picW-1, x0+x);
+        out[x] = plane[ de265_image::get_tiled_offset(xA,yA,tiledWidth) ];
+      }
+    }
+  }
+}
+
+
+template <class pixel_t>
 void mc_luma(const decoder_context* ctx,
              const de265_image* img, int mv_x, int mv_y,
              int xP,int yP,
              int16_t* out, int out_stride,
-             uint8_t* ref, int ref_stride,
+             const de265_image* refPic,
              int nPbW, int nPbH)
 {
   const seq_parameter_set* sps = &img->sps;
 
+  pixel_t* ref = (pixel_t*)refPic->get_image_plane(0);
+  int ref_stride = refPic->get_luma_stride();
+  const bool tiled = refPic->has_tiled_planes();
+
   int xFracL = mv_x & 3;
   int yFracL = mv_y & 3;
 
@@ -71,18 +180,22 @@ void mc_luma(const decoder_context* ctx,
 
   ALIGNED_16(int16_t) mcbuffer[MAX_CU_SIZE * (MAX_CU_SIZE+7)];
 
+  pixel_t padbuf[(MAX_CU_SIZE+16)*(MAX_CU_SIZE+7)];
+
   if (xFracL==0 && yFracL==0) {
-    if (xIntOffsL >= 0 && yIntOffsL >= 0 &&
-        nPbW+xIntOffsL <= w && nPbH+yIntOffsL <= h) {
-    }
+    if (tiled) {
+      fetch_tiled_block(refPic,0, padbuf,MAX_CU_SIZE+16, xIntOffsL,yIntOffsL, nPbW,nPbH);
 
-    if (xIntOffsL >= 0 && yIntOffsL >= 0 &&
+      put_qpel(ctx, 0,0, out, out_stride,
+               padbuf, MAX_CU_SIZE+16,
+               nPbW,nPbH, mcbuffer, sps->BitDepth_Y);
+    }
+    else if (xIntOffsL >= 0 && yIntOffsL >= 0 &&
         nPbW+xIntOffsL <= w && nPbH+yIntOffsL <= h) {
 
-      ctx->acceleration.put_hevc_qpel_8[0][0](out, out_stride,
-                                          &ref[yIntOffsL*ref_stride + xIntOffsL],
-                                          ref_stride,
-                                          nPbW,nPbH, mcbuffer);
+      put_qpel(ctx, 0,0, out, out_stride,
+               &ref[yIntOffsL*ref_stride + xIntOffsL], ref_stride,
+               nPbW,nPbH, mcbuffer, sps->BitDepth_Y);
     }
     else {
       for (int y=0;y<nPbH;y++)
@@ -130,12 +243,18 @@ void mc_luma(const decoder_context* ctx,
     //int nPbH_extra = extra_top  + nPbH + extra_bottom;
 
 
-    uint8_t padbuf[(MAX_CU_SIZE+16)*(MAX_CU_SIZE+7)];
-
-    uint8_t* src_ptr;
+    pixel_t* src_ptr;
     int src_stride;
 
-    if (-extra_left + xIntOffsL >= 0 &&
+    if (tiled) {
+      fetch_tiled_block(refPic,0, padbuf,MAX_CU_SIZE+16,
+                        xIntOffsL-extra_left, yIntOffsL-extra_top,
+                        extra_left+nPbW+extra_right, extra_top+nPbH+extra_bottom);
+
+      src_ptr = &padbuf[extra_top*(MAX_CU_SIZE+16) + extra_left];
+      src_stride = MAX_CU_SIZE+16;
+    }
+    else if (-extra_left + xIntOffsL >= 0 &&
         -extra_top  + yIntOffsL >= 0 &&
         nPbW+extra_right  + xIntOffsL < w &&
         nPbH+extra_bottom + yIntOffsL < h) {
@@ -157,9 +276,9 @@ void mc_luma(const decoder_context* ctx,
       src_stride = MAX_CU_SIZE+16;
     }
 
-    ctx->acceleration.put_hevc_qpel_8[xFracL][yFracL](out, out_stride,
-                                                  src_ptr, src_stride,
-                                                  nPbW,nPbH, mcbuffer);
+    put_qpel(ctx, xFracL,yFracL, out, out_stride,
+             src_ptr, src_stride,
+             nPbW,nPbH, mcbuffer, sps->BitDepth_Y);
 
 
     logtrace(LogMotion,"---V---\n");
@@ -174,16 +293,21 @@ void mc_luma(const decoder_context* ctx,
 
 
 
+template <class pixel_t>
 void mc_chroma(const decoder_context* ctx,
                const de265_image* img,
                int mv_x, int mv_y,
                int xP,int yP,
                int16_t* out, int out_stride,
-               uint8_t* ref, int ref_stride,
+               const de265_image* refPic, int cIdx,
                int nPbWC, int nPbHC)
 {
   const seq_parameter_set* sps = &img->sps;
 
+  pixel_t* ref = (pixel_t*)refPic->get_image_plane(cIdx);
+  int ref_stride = refPic->get_chroma_stride();
+  const bool tiled = refPic->has_tiled_planes();
+
   // chroma sample interpolation process (8.5.3.2.2.2)
 
   //const int shift1 = sps->BitDepth_C-8;
@@ -201,12 +325,21 @@ void mc_chroma(const decoder_context* ctx,
 
   ALIGNED_32(int16_t mcbuffer[MAX_CU_SIZE*(MAX_CU_SIZE+7)]);
 
+  pixel_t padbuf[(MAX_CU_SIZE+16)*(MAX_CU_SIZE+3)];
+
   if (xFracC == 0 && yFracC == 0) {
-    if (xIntOffsC>=0 && nPbWC+xIntOffsC<=wC &&
+    if (tiled) {
+      fetch_tiled_block(refPic,cIdx, padbuf,MAX_CU_SIZE+16, xIntOffsC,yIntOffsC, nPbWC,nPbHC);
+
+      put_epel(ctx, 0,0, out, out_stride,
+               padbuf, MAX_CU_SIZE+16,
+               nPbWC,nPbHC, NULL, sps->BitDepth_C);
+    }
+    else if (xIntOffsC>=0 && nPbWC+xIntOffsC<=wC &&
         yIntOffsC>=0 && nPbHC+yIntOffsC<=hC) {
-      ctx->acceleration.put_hevc_epel_8(out, out_stride,
-                                    &ref[xIntOffsC + yIntOffsC*ref_stride], ref_stride,
-                                    nPbWC,nPbHC, 0,0, NULL);
+      put_epel(ctx, 0,0, out, out_stride,
+               &ref[xIntOffsC + yIntOffsC*ref_stride], ref_stride,
+               nPbWC,nPbHC, NULL, sps->BitDepth_C);
     }
     else
       {
@@ -221,9 +354,7 @@ void mc_chroma(const decoder_context* ctx,
       }
   }
   else {
-    uint8_t padbuf[(MAX_CU_SIZE+16)*(MAX_CU_SIZE+3)];
-
-    uint8_t* src_ptr;
+    pixel_t* src_ptr;
     int src_stride;
 
     int extra_top  = 1;
@@ -231,7 +362,15 @@ void mc_chroma(const decoder_context* ctx,
     int extra_right  = 2;
     int extra_bottom = 2;
 
-    if (xIntOffsC>=1 && nPbWC+xIntOffsC<=wC-2 &&
+    if (tiled) {
+      fetch_tiled_block(refPic,cIdx, padbuf,MAX_CU_SIZE+16,
+                        xIntOffsC-extra_left, yIntOffsC-extra_top,
+                        extra_left+nPbWC+extra_right, extra_top+nPbHC+extra_bottom);
+
+      src_ptr = &padbuf[extra_left + extra_top*(MAX_CU_SIZE+16)];
+      src_stride = MAX_CU_SIZE+16;
+    }
+    else if (xIntOffsC>=1 && nPbWC+xIntOffsC<=wC-2 &&
         yIntOffsC>=1 && nPbHC+yIntOffsC<=hC-2) {
       src_ptr = &ref[xIntOffsC + yIntOffsC*ref_stride];
       src_stride = ref_stride;
@@ -252,24 +391,91 @@ void mc_chroma(const decoder_context* ctx,
     }
 
 
-    if (xFracC && yFracC) {
-      ctx->acceleration.put_hevc_epel_hv_8(out, out_stride,
-                                       src_ptr, src_stride,
-                                       nPbWC,nPbHC, xFracC,yFracC, mcbuffer);
-    }
-    else if (xFracC) {
-      ctx->acceleration.put_hevc_epel_h_8(out, out_stride,
-                                      src_ptr, src_stride,
-                                      nPbWC,nPbHC, xFracC,yFracC, mcbuffer);
-    }
-    else if (yFracC) {
-      ctx->acceleration.put_hevc_epel_v_8(out, out_stride,
-                                      src_ptr, src_stride,
-                                      nPbWC,nPbHC, xFracC,yFracC, mcbuffer);
-    }
-    else {
-      assert(false); // full-pel shifts are handled above
-    }
+    assert(xFracC || yFracC); // full-pel shifts are handled above
+
+    put_epel(ctx, xFracC,yFracC, out, out_stride,
+             src_ptr, src_stride,
+             nPbWC,nPbHC, mcbuffer, sps->BitDepth_C);
+  }
+}
+
+
+
+// Output of the (weighted) prediction into plane cIdx of the image.
+// These select the 8 bit or high bit-depth functions.
+
+static void put_unweighted_pred(const decoder_context* ctx, de265_image* img,
+                                int cIdx, int x,int y,
+                                int16_t* src, int srcstride, int width, int height)
+{
+  if (img->high_bit_depth(cIdx)) {
+    ctx->acceleration.put_unweighted_pred_16((uint16_t*)img->get_image_plane_at_pos(cIdx,x,y),
+                                             img->get_image_stride(cIdx),
+                                             src,srcstride, width,height,
+                                             img->get_bit_depth(cIdx));
+  }
+  else {
+    ctx->acceleration.put_unweighted_pred_8(img->get_image_plane_at_pos(cIdx,x,y),
+                                            img->get_image_stride(cIdx),
+                                            src,srcstride, width,height);
+  }
+}
+
+static void put_weighted_pred(const decoder_context* ctx, de265_image* img,
+                              int cIdx, int x,int y,
+                              int16_t* src, int srcstride, int width, int height,
+                              int w,int o,int log2WD)
+{
+  if (img->high_bit_depth(cIdx)) {
+    ctx->acceleration.put_weighted_pred_16((uint16_t*)img->get_image_plane_at_pos(cIdx,x,y),
+                                           img->get_image_stride(cIdx),
+                                           src,srcstride, width,height,
+                                           w,o,log2WD, img->get_bit_depth(cIdx));
+  }
+  else {
+    ctx->acceleration.put_weighted_pred_8(img->get_image_plane_at_pos(cIdx,x,y),
+                                          img->get_image_stride(cIdx),
+                                          src,srcstride, width,height,
+                                          w,o,log2WD);
+  }
+}
+
+static void put_weighted_pred_avg(const decoder_context* ctx, de265_image* img,
+                                  int cIdx, int x,int y,
+                                  int16_t* src1, int16_t* src2, int srcstride,
+                                  int width, int height)
+{
+  if (img->high_bit_depth(cIdx)) {
+    ctx->acceleration.put_weighted_pred_avg_16((uint16_t*)img->get_image_plane_at_pos(cIdx,x,y),
+                                               img->get_image_stride(cIdx),
+                                               src1,src2,srcstride, width,height,
+                                               img->get_bit_depth(cIdx));
+  }
+  else {
+    ctx->acceleration.put_weighted_pred_avg_8(img->get_image_plane_at_pos(cIdx,x,y),
+                                              img->get_image_stride(cIdx),
+                                              src1,src2,srcstride, width,height);
+  }
+}
+
+static void put_weighted_bipred(const decoder_context* ctx, de265_image* img,
+                                int cIdx, int x,int y,
+                                int16_t* src1, int16_t* src2, int srcstride,
+                                int width, int height,
+                                int w1,int o1, int w2,int o2, int log2WD)
+{
+  if (img->high_bit_depth(cIdx)) {
+    ctx->acceleration.put_weighted_bipred_16((uint16_t*)img->get_image_plane_at_pos(cIdx,x,y),
+                                             img->get_image_stride(cIdx),
+                                             src1,src2,srcstride, width,height,
+                                             w1,o1,w2,o2,log2WD,
+                                             img->get_bit_depth(cIdx));
+  }
+  else {
+    ctx->acceleration.put_weighted_bipred_8(img->get_image_plane_at_pos(cIdx,x,y),
+                                            img->get_image_stride(cIdx),
+                                            src1,src2,srcstride, width,height,
+                                            w1,o1,w2,o2,log2WD);
   }
 }
 
@@ -327,7 +533,9 @@ void generate_inter_prediction_samples(decoder_context* ctx,
 
       logtrace(LogMotion, "refIdx: %d -> dpb[%d]\n", vi->lum.refIdx[l], shdr->RefPicList[l][vi->lum.refIdx[l]]);
 
-      if (refPic->PicState == UnusedForReference) {
+      if (refPic->PicState == UnusedForReference ||
+          refPic->get_bit_depth(0) != img->get_bit_depth(0) ||
+          refPic->get_bit_depth(1) != img->get_bit_depth(1)) {
         img->integrity = INTEGRITY_DECODING_ERRORS;
         ctx->add_warning(DE265_WARNING_NONEXISTING_REFERENCE_PICTURE_ACCESSED, false);
       }
@@ -339,17 +547,25 @@ void generate_inter_prediction_samples(decoder_context* ctx,
 
 
         // TODO: must predSamples stride really be nCS or can it be somthing smaller like nPbW?
-        mc_luma(ctx, img, vi->lum.mv[l].x, vi->lum.mv[l].y, xP,yP,
-                predSamplesL[l],nCS,
-                refPic->get_image_plane(0),refPic->get_luma_stride(), nPbW,nPbH);
-
+        if (img->high_bit_depth(0)) {
+          mc_luma<uint16_t>(ctx, img, vi->lum.mv[l].x, vi->lum.mv[l].y, xP,yP,
+                            predSamplesL[l],nCS, refPic, nPbW,nPbH);
+        }
+        else {
+          mc_luma<uint8_t>(ctx, img, vi->lum.mv[l].x, vi->lum.mv[l].y, xP,yP,
+                           predSamplesL[l],nCS, refPic, nPbW,nPbH);
+        }
 
-        mc_chroma(ctx, img, vi->lum.mv[l].x, vi->lum.mv[l].y, xP,yP,
-                  predSamplesC[0][l],nCS, refPic->get_image_plane(1),
-                  refPic->get_chroma_stride(), nPbW/2,nPbH/2);
-        mc_chroma(ctx, img, vi->lum.mv[l].x, vi->lum.mv[l].y, xP,yP,
-                  predSamplesC[1][l],nCS, refPic->get_image_plane(2),
-                  refPic->get_chroma_stride(), nPbW/2,nPbH/2);
+        for (int c=0;c<2;c++) {
+          if (img->high_bit_depth(1+c)) {
+            mc_chroma<uint16_t>(ctx, img, vi->lum.mv[l].x, vi->lum.mv[l].y, xP,yP,
+                                predSamplesC[c][l],nCS, refPic,1+c, nPbW/2,nPbH/2);
+          }
+          else {
+            mc_chroma<uint8_t>(ctx, img, vi->lum.mv[l].x, vi->lum.mv[l].y, xP,yP,
+                               predSamplesC[c][l],nCS, refPic,1+c, nPbW/2,nPbH/2);
+          }
+        }
       }
     }
   }
@@ -357,23 +573,22 @@ void generate_inter_prediction_samples(decoder_context* ctx,
 
   // weighted sample prediction  (8.5.3.2.3)
 
-  //const int shift1 = 6; // TODO
-  //const int offset1= 1<<(shift1-1);
+  const int shift1_L = 14 - img->sps.BitDepth_Y;
+  const int shift1_C = 14 - img->sps.BitDepth_C;
+  const int offsetShift_L = img->sps.BitDepth_Y - 8;
+  const int offsetShift_C = img->sps.BitDepth_C - 8;
 
   logtrace(LogMotion,"predFlags (modified): %d %d\n", predFlag[0], predFlag[1]);
 
   if (shdr->slice_type == SLICE_TYPE_P) {
     if (img->pps.weighted_pred_flag==0) {
       if (predFlag[0]==1 && predFlag[1]==0) {
-        ctx->acceleration.put_unweighted_pred_8(img->get_image_plane_at_pos(0,xP,yP),
-                                                img->get_image_stride(0),
-                                                predSamplesL[0],nCS, nPbW,nPbH);
-        ctx->acceleration.put_unweighted_pred_8(img->get_image_plane_at_pos(1,xP/2,yP/2),
-                                                img->get_image_stride(1),
-                                                predSamplesC[0][0],nCS, nPbW/2,nPbH/2);
-        ctx->acceleration.put_unweighted_pred_8(img->get_image_plane_at_pos(2,xP/2,yP/2),
-                                                img->get_image_stride(2),
-                                                predSamplesC[1][0],nCS, nPbW/2,nPbH/2);
+        put_unweighted_pred(ctx, img, 0, xP,yP,
+                            predSamplesL[0],nCS, nPbW,nPbH);
+        put_unweighted_pred(ctx, img, 1, xP/2,yP/2,
+                            predSamplesC[0][0],nCS, nPbW/2,nPbH/2);
+        put_unweighted_pred(ctx, img, 2, xP/2,yP/2,
+                            predSamplesC[1][0],nCS, nPbW/2,nPbH/2);
       }
       else {
         ctx->add_warning(DE265_WARNING_BOTH_PREDFLAGS_ZERO, false);
@@ -387,31 +602,28 @@ void generate_inter_prediction_samples(decoder_context* ctx,
 
         int refIdx0 = vi->lum.refIdx[0];
 
-        int luma_log2WD   = shdr->luma_log2_weight_denom + (14-8); // TODO: bitDepth
-        int chroma_log2WD = shdr->ChromaLog2WeightDenom + (14-8); // TODO: bitDepth
+        int luma_log2WD   = shdr->luma_log2_weight_denom + shift1_L;
+        int chroma_log2WD = shdr->ChromaLog2WeightDenom  + shift1_C;
 
         int luma_w0 = shdr->LumaWeight[0][refIdx0];
-        int luma_o0 = shdr->luma_offset[0][refIdx0] * (1<<(8-8)); // TODO: bitDepth
+        int luma_o0 = shdr->luma_offset[0][refIdx0] * (1<<offsetShift_L);
 
         int chroma0_w0 = shdr->ChromaWeight[0][refIdx0][0];
-        int chroma0_o0 = shdr->ChromaOffset[0][refIdx0][0] * (1<<(8-8)); // TODO: bitDepth
+        int chroma0_o0 = shdr->ChromaOffset[0][refIdx0][0] * (1<<offsetShift_C);
         int chroma1_w0 = shdr->ChromaWeight[0][refIdx0][1];
-        int chroma1_o0 = shdr->ChromaOffset[0][refIdx0][1] * (1<<(8-8)); // TODO: bitDepth
+        int chroma1_o0 = shdr->ChromaOffset[0][refIdx0][1] * (1<<offsetShift_C);
 
         logtrace(LogMotion,"weighted-0 [%d] %d %d %d  %dx%d\n", refIdx0, luma_log2WD-6,luma_w0,luma_o0,nPbW,nPbH);
 
-        ctx->acceleration.put_weighted_pred_8(img->get_image_plane_at_pos(0,xP,yP),
-                                              img->get_image_stride(0),
-                                              predSamplesL[0],nCS, nPbW,nPbH,
-                                              luma_w0, luma_o0, luma_log2WD);
-        ctx->acceleration.put_weighted_pred_8(img->get_image_plane_at_pos(1,xP/2,yP/2),
-                                              img->get_image_stride(1),
-                                              predSamplesC[0][0],nCS, nPbW/2,nPbH/2,
-                                              chroma0_w0, chroma0_o0, chroma_log2WD);
-        ctx->acceleration.put_weighted_pred_8(img->get_image_plane_at_pos(2,xP/2,yP/2),
-                                              img->get_image_stride(2),
-                                              predSamplesC[1][0],nCS, nPbW/2,nPbH/2,
-                                              chroma1_w0, chroma1_o0, chroma_log2WD);
+        put_weighted_pred(ctx, img, 0, xP,yP,
+                          predSamplesL[0],nCS, nPbW,nPbH,
+                          luma_w0, luma_o0, luma_log2WD);
+        put_weighted_pred(ctx, img, 1, xP/2,yP/2,
+                          predSamplesC[0][0],nCS, nPbW/2,nPbH/2,
+                          chroma0_w0, chroma0_o0, chroma_log2WD);
+        put_weighted_pred(ctx, img, 2, xP/2,yP/2,
+                          predSamplesC[1][0],nCS, nPbW/2,nPbH/2,
+                          chroma1_w0, chroma1_o0, chroma_log2WD);
       }
       else {
         ctx->add_warning(DE265_WARNING_BOTH_PREDFLAGS_ZERO, false);
@@ -424,27 +636,12 @@ void generate_inter_prediction_samples(decoder_context* ctx,
 
     if (predFlag[0]==1 && predFlag[1]==1) {
       if (img->pps.weighted_bipred_flag==0) {
-        //const int shift2  = 15-8; // TODO: real bit depth
-        //const int offset2 = 1<<(shift2-1);
-
-        int16_t* in0 = predSamplesL[0];
-        int16_t* in1 = predSamplesL[1];
-        uint8_t* out = img->get_image_plane_at_pos(0, xP,yP);
-
-        ctx->acceleration.put_weighted_pred_avg_8(out, img->get_luma_stride(),
-                                              in0,in1, nCS, nPbW, nPbH);
-
-        int16_t* in00 = predSamplesC[0][0];
-        int16_t* in01 = predSamplesC[0][1];
-        int16_t* in10 = predSamplesC[1][0];
-        int16_t* in11 = predSamplesC[1][1];
-        uint8_t* out0 = img->get_image_plane_at_pos(1,xP/2,yP/2);
-        uint8_t* out1 = img->get_image_plane_at_pos(2,xP/2,yP/2);
-
-        ctx->acceleration.put_weighted_pred_avg_8(out0, img->get_chroma_stride(),
-                                              in00,in01, nCS, nPbW/2, nPbH/2);
-        ctx->acceleration.put_weighted_pred_avg_8(out1, img->get_chroma_stride(),
-                                              in10,in11, nCS, nPbW/2, nPbH/2);
+        put_weighted_pred_avg(ctx, img, 0, xP,yP,
+                              predSamplesL[0],predSamplesL[1], nCS, nPbW, nPbH);
+        put_weighted_pred_avg(ctx, img, 1, xP/2,yP/2,
+                              predSamplesC[0][0],predSamplesC[0][1], nCS, nPbW/2, nPbH/2);
+        put_weighted_pred_avg(ctx, img, 2, xP/2,yP/2,
+                              predSamplesC[1][0],predSamplesC[1][1], nCS, nPbW/2, nPbH/2);
       }
       else {
         // weighted prediction
@@ -452,97 +649,79 @@ void generate_inter_prediction_samples(decoder_context* ctx,
         int refIdx0 = vi->lum.refIdx[0];
         int refIdx1 = vi->lum.refIdx[1];
 
-        int luma_log2WD   = shdr->luma_log2_weight_denom + (14-8); // TODO: bitDepth
-        int chroma_log2WD = shdr->ChromaLog2WeightDenom + (14-8); // TODO: bitDepth
+        int luma_log2WD   = shdr->luma_log2_weight_denom + shift1_L;
+        int chroma_log2WD = shdr->ChromaLog2WeightDenom  + shift1_C;
 
         int luma_w0 = shdr->LumaWeight[0][refIdx0];
-        int luma_o0 = shdr->luma_offset[0][refIdx0] * (1<<(8-8)); // TODO: bitDepth
+        int luma_o0 = shdr->luma_offset[0][refIdx0] * (1<<offsetShift_L);
         int luma_w1 = shdr->LumaWeight[1][refIdx1];
-        int luma_o1 = shdr->luma_offset[1][refIdx1] * (1<<(8-8)); // TODO: bitDepth
+        int luma_o1 = shdr->luma_offset[1][refIdx1] * (1<<offsetShift_L);
 
         int chroma0_w0 = shdr->ChromaWeight[0][refIdx0][0];
-        int chroma0_o0 = shdr->ChromaOffset[0][refIdx0][0] * (1<<(8-8)); // TODO: bitDepth
+        int chroma0_o0 = shdr->ChromaOffset[0][refIdx0][0] * (1<<offsetShift_C);
         int chroma1_w0 = shdr->ChromaWeight[0][refIdx0][1];
-        int chroma1_o0 = shdr->ChromaOffset[0][refIdx0][1] * (1<<(8-8)); // TODO: bitDepth
+        int chroma1_o0 = shdr->ChromaOffset[0][refIdx0][1] * (1<<offsetShift_C);
         int chroma0_w1 = shdr->ChromaWeight[1][refIdx1][0];
-        int chroma0_o1 = shdr->ChromaOffset[1][refIdx1][0] * (1<<(8-8)); // TODO: bitDepth
+        int chroma0_o1 = shdr->ChromaOffset[1][refIdx1][0] * (1<<offsetShift_C);
         int chroma1_w1 = shdr->ChromaWeight[1][refIdx1][1];
-        int chroma1_o1 = shdr->ChromaOffset[1][refIdx1][1] * (1<<(8-8)); // TODO: bitDepth
+        int chroma1_o1 = shdr->ChromaOffset[1][refIdx1][1] * (1<<offsetShift_C);
 
         logtrace(LogMotion,"weighted-BI-0 [%d] %d %d %d  %dx%d\n", refIdx0, luma_log2WD-6,luma_w0,luma_o0,nPbW,nPbH);
         logtrace(LogMotion,"weighted-BI-1 [%d] %d %d %d  %dx%d\n", refIdx1, luma_log2WD-6,luma_w1,luma_o1,nPbW,nPbH);
 
-        int16_t* in0 = predSamplesL[0];
-        int16_t* in1 = predSamplesL[1];
-        uint8_t* out = img->get_image_plane_at_pos(0, xP,yP);
-
-        ctx->acceleration.put_weighted_bipred_8(out, img->get_luma_stride(),
-                                            in0,in1, nCS, nPbW, nPbH,
-                                            luma_w0,luma_o0,
-                                            luma_w1,luma_o1,
-                                            luma_log2WD);
-
-        int16_t* in00 = predSamplesC[0][0];
-        int16_t* in01 = predSamplesC[0][1];
-        int16_t* in10 = predSamplesC[1][0];
-        int16_t* in11 = predSamplesC[1][1];
-        uint8_t* out0 = img->get_image_plane_at_pos(1,xP/2,yP/2);
-        uint8_t* out1 = img->get_image_plane_at_pos(2,xP/2,yP/2);
-
-        ctx->acceleration.put_weighted_bipred_8(out0, img->get_chroma_stride(),
-                                            in00,in01, nCS, nPbW/2, nPbH/2,
-                                            chroma0_w0,chroma0_o0,
-                                            chroma0_w1,chroma0_o1,
-                                            chroma_log2WD);
-        ctx->acceleration.put_weighted_bipred_8(out1, img->get_chroma_stride(),
-                                            in10,in11, nCS, nPbW/2, nPbH/2,
-                                            chroma1_w0,chroma1_o0,
-                                            chroma1_w1,chroma1_o1,
-                                            chroma_log2WD);
+        put_weighted_bipred(ctx, img, 0, xP,yP,
+                            predSamplesL[0],predSamplesL[1], nCS, nPbW, nPbH,
+                            luma_w0,luma_o0,
+                            luma_w1,luma_o1,
+                            luma_log2WD);
+        put_weighted_bipred(ctx, img, 1, xP/2,yP/2,
+                            predSamplesC[0][0],predSamplesC[0][1], nCS, nPbW/2, nPbH/2,
+                            chroma0_w0,chroma0_o0,
+                            chroma0_w1,chroma0_o1,
+                            chroma_log2WD);
+        put_weighted_bipred(ctx, img, 2, xP/2,yP/2,
+                            predSamplesC[1][0],predSamplesC[1][1], nCS, nPbW/2, nPbH/2,
+                            chroma1_w0,chroma1_o0,
+                            chroma1_w1,chroma1_o1,
+                            chroma_log2WD);
       }
     }
     else if (predFlag[0]==1 || predFlag[1]==1) {
       int l = predFlag[0] ? 0 : 1;
 
       if (img->pps.weighted_bipred_flag==0) {
-        ctx->acceleration.put_unweighted_pred_8(img->get_image_plane_at_pos(0,xP,yP),
-                                                img->get_image_stride(0),
-                                                predSamplesL[l],nCS, nPbW,nPbH);
-        ctx->acceleration.put_unweighted_pred_8(img->get_image_plane_at_pos(1,xP/2,yP/2),
-                                                img->get_image_stride(1),
-                                                predSamplesC[0][l],nCS, nPbW/2,nPbH/2);
-        ctx->acceleration.put_unweighted_pred_8(img->get_image_plane_at_pos(2,xP/2,yP/2),
-                                                img->get_image_stride(2),
-                                                predSamplesC[1][l],nCS, nPbW/2,nPbH/2);
+        put_unweighted_pred(ctx, img, 0, xP,yP,
+                            predSamplesL[l],nCS, nPbW,nPbH);
+        put_unweighted_pred(ctx, img, 1, xP/2,yP/2,
+                            predSamplesC[0][l],nCS, nPbW/2,nPbH/2);
+        put_unweighted_pred(ctx, img, 2, xP/2,yP/2,
+                            predSamplesC[1][l],nCS, nPbW/2,nPbH/2);
       }
       else {
         int refIdx = vi->lum.refIdx[l];
 
-        int luma_log2WD   = shdr->luma_log2_weight_denom + (14-8); // TODO: bitDepth
-        int chroma_log2WD = shdr->ChromaLog2WeightDenom + (14-8); // TODO: bitDepth
+        int luma_log2WD   = shdr->luma_log2_weight_denom + shift1_L;
+        int chroma_log2WD = shdr->ChromaLog2WeightDenom  + shift1_C;
 
         int luma_w = shdr->LumaWeight[l][refIdx];
-        int luma_o = shdr->luma_offset[l][refIdx] * (1<<(8-8)); // TODO: bitDepth
+        int luma_o = shdr->luma_offset[l][refIdx] * (1<<offsetShift_L);
 
         int chroma0_w = shdr->ChromaWeight[l][refIdx][0];
-        int chroma0_o = shdr->ChromaOffset[l][refIdx][0] * (1<<(8-8)); // TODO: bitDepth
+        int chroma0_o = shdr->ChromaOffset[l][refIdx][0] * (1<<offsetShift_C);
         int chroma1_w = shdr->ChromaWeight[l][refIdx][1];
-        int chroma1_o = shdr->ChromaOffset[l][refIdx][1] * (1<<(8-8)); // TODO: bitDepth
+        int chroma1_o = shdr->ChromaOffset[l][refIdx][1] * (1<<offsetShift_C);
 
         logtrace(LogMotion,"weighted-B-L%d [%d] %d %d %d  %dx%d\n", l, refIdx, luma_log2WD-6,luma_w,luma_o,nPbW,nPbH);
 
-        ctx->acceleration.put_weighted_pred_8(img->get_image_plane_at_pos(0,xP,yP),
-                                              img->get_image_stride(0),
-                                              predSamplesL[l],nCS, nPbW,nPbH,
-                                              luma_w, luma_o, luma_log2WD);
-        ctx->acceleration.put_weighted_pred_8(img->get_image_plane_at_pos(1,xP/2,yP/2),
-                                              img->get_image_stride(1),
-                                              predSamplesC[0][l],nCS, nPbW/2,nPbH/2,
-                                              chroma0_w, chroma0_o, chroma_log2WD);
-        ctx->acceleration.put_weighted_pred_8(img->get_image_plane_at_pos(2,xP/2,yP/2),
-                                              img->get_image_stride(2),
-                                              predSamplesC[1][l],nCS, nPbW/2,nPbH/2,
-                                              chroma1_w, chroma1_o, chroma_log2WD);
+        put_weighted_pred(ctx, img, 0, xP,yP,
+                          predSamplesL[l],nCS, nPbW,nPbH,
+                          luma_w, luma_o, luma_log2WD);
+        put_weighted_pred(ctx, img, 1, xP/2,yP/2,
+                          predSamplesC[0][l],nCS, nPbW/2,nPbH/2,
+                          chroma0_w, chroma0_o, chroma_log2WD);
+        put_weighted_pred(ctx, img, 2, xP/2,yP/2,
+                          predSamplesC[1][l],nCS, nPbW/2,nPbH/2,
+                          chroma1_w, chroma1_o, chroma_log2WD);
       }
     }
     else {
@@ -971,9 +1150,20 @@ void derive_collocated_motion_vectors(decoder_context* ctx,
 
   assert(ctx->has_image(colPic));
   const de265_image* colImg = ctx->get_image(colPic);
-  enum PredMode predMode = colImg->get_pred_mode(xColPb,yColPb);
 
-  if (predMode == MODE_INTRA) {
+  if (colImg->integrity == INTEGRITY_UNAVAILABLE_REFERENCE) {
+    out_mvLXCol->x = 0;
+    out_mvLXCol->y = 0;
+    *out_availableFlagLXCol = 0;
+    return;
+  }
+
+  // intra blocks are stored without any prediction flags in the compressed motion field
+
+  const ColMV_ref_info* colInfo = colImg->get_collocated_mv_info(xColPb,yColPb);
+  const PredVectorInfo* mvi = &colInfo->mvi;
+
+  if (mvi->predFlag[0]==0 && mvi->predFlag[1]==0) {
     out_mvLXCol->x = 0;
     out_mvLXCol->y = 0;
     *out_availableFlagLXCol = 0;
@@ -985,16 +1175,7 @@ void derive_collocated_motion_vectors(decoder_context* ctx,
              colImg->PicOrderCntVal,
              X,refIdxLX,shdr->RefPicList[X][refIdxLX]);
 
-    if (colImg->integrity == INTEGRITY_UNAVAILABLE_REFERENCE) {
-      out_mvLXCol->x = 0;
-      out_mvLXCol->y = 0;
-      *out_availableFlagLXCol = 0;
-      return;
-    }
-
-    const PredVectorInfo* mvi = colImg->get_mv_info(xColPb,yColPb);
     int listCol;
-    int refIdxCol;
     MotionVector mvCol;
 
     logtrace(LogMotion,"read MVI %d;%d:\n",xColPb,yColPb);
@@ -1002,13 +1183,11 @@ void derive_collocated_motion_vectors(decoder_context* ctx,
 
     if (mvi->predFlag[0]==0) {
       mvCol = mvi->mv[1];
-      refIdxCol = mvi->refIdx[1];
       listCol = 1;
     }
     else {
       if (mvi->predFlag[1]==0) {
         mvCol = mvi->mv[0];
-        refIdxCol = mvi->refIdx[0];
         listCol = 0;
       }
       else {
@@ -1038,13 +1217,11 @@ void derive_collocated_motion_vectors(decoder_context* ctx,
 
         if (AllDiffPicOrderCntLEZero) {
           mvCol = mvi->mv[X];
-          refIdxCol = mvi->refIdx[X];
           listCol = X;
         }
         else {
           int N = shdr->collocated_from_l0_flag;
           mvCol = mvi->mv[N];
-          refIdxCol = mvi->refIdx[N];
           listCol = N;
         }
       }
@@ -1052,10 +1229,8 @@ void derive_collocated_motion_vectors(decoder_context* ctx,
 
 
 
-    const slice_segment_header* colShdr = colImg->slices[ colImg->get_SliceHeaderIndex(xColPb,yColPb) ];
-
     if (shdr->LongTermRefPic[X][refIdxLX] !=
-        colShdr->LongTermRefPic[listCol][refIdxCol]) {
+        colInfo->refIsLongTerm[listCol]) {
       *out_availableFlagLXCol = 0;
       out_mvLXCol->x = 0;
       out_mvLXCol->y = 0;
@@ -1065,11 +1240,11 @@ void derive_collocated_motion_vectors(decoder_context* ctx,
 
       const bool isLongTerm = shdr->LongTermRefPic[X][refIdxLX];
 
-      int colDist  = colImg->PicOrderCntVal - colShdr->RefPicList_POC[listCol][refIdxCol];
+      int colDist  = colImg->PicOrderCntVal - colInfo->refPOC[listCol];
       int currDist = img->PicOrderCntVal - shdr->RefPicList_POC[X][refIdxLX];
 
       logtrace(LogMotion,"COLPOCDIFF %d %d [%d %d / %d %d]\n",colDist, currDist,
-               colImg->PicOrderCntVal, colShdr->RefPicList_POC[listCol][refIdxCol],
+               colImg->PicOrderCntVal, colInfo->refPOC[listCol],
                img->PicOrderCntVal, shdr->RefPicList_POC[X][refIdxLX]
                );
 
@@ -1818,7 +1993,15 @@ void decode_prediction_unit(thread_context* tctx,
 
   // 2.
 
-  generate_inter_prediction_samples(tctx->decctx,tctx->img, shdr, xC,yC, xB,yB, nCS, nPbW,nPbH, &vi);
+  if (tctx->decctx->param_parse_only) {
+    // motion vectors only
+  }
+  else if (tctx->syntax_buffer) {
+    tctx->syntax_buffer->add_inter_prediction(xC,yC, xB,yB, nCS, nPbW,nPbH, &vi);
+  }
+  else {
+    generate_inter_prediction_samples(tctx->decctx,tctx->img, shdr, xC,yC, xB,yB, nCS, nPbW,nPbH, &vi);
+  }
 
 
   tctx->img->set_mv_info(xC+xB,yC+yB,nPbW,nPbH, &vi.lum);
@@ -51,4 +51,12 @@ void decode_prediction_unit(struct thread_context* shdr,
 void inter_prediction(struct decoder_context* ctx,struct slice_segment_header* shdr,
                       int xC,int yC, int log2CbSize);
 
+void generate_inter_prediction_samples(struct decoder_context* ctx,
+                                       struct de265_image* img,
+                                       struct slice_segment_header* shdr,
+                                       int xC,int yC,
+                                       int xB,int yB,
+                                       int nCS, int nPbW,int nPbH,
+                                       const VectorInfo* vi);
+
 #endif
@@ -0,0 +1,248 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pipeline.h"
+#include "decctx.h"
+#include "intrapred.h"
+#include "transform.h"
+
+#include <assert.h>
+#include <string.h>
+
+
+void ctb_syntax_buffer::add_inter_prediction(int xC,int yC, int xB,int yB, int nCS,
+                                             int nPbW,int nPbH, const VectorInfo* vi)
+{
+  recon_command cmd;
+  cmd.type = RECON_INTER_PREDICTION;
+  cmd.x  = xC;
+  cmd.y  = yC;
+  cmd.xB = xB;
+  cmd.yB = yB;
+  cmd.nT = nCS;
+  cmd.nPbW = nPbW;
+  cmd.nPbH = nPbH;
+  cmd.vi = *vi;
+
+  cmds.push_back(cmd);
+}
+
+
+void ctb_syntax_buffer::add_intra_prediction(int xB0,int yB0, enum IntraPredMode mode,
+                                             int nT, int cIdx)
+{
+  recon_command cmd;
+  cmd.type = RECON_INTRA_PREDICTION;
+  cmd.x  = xB0;
+  cmd.y  = yB0;
+  cmd.nT = nT;
+  cmd.cIdx = cIdx;
+  cmd.intraPredMode = mode;
+
+  cmds.push_back(cmd);
+}
+
+
+void ctb_syntax_buffer::add_residual(const thread_context* tctx,
+                                     int xT,int yT, int x0,int y0, int nT, int cIdx,
+                                     bool transform_skip_flag, bool intra)
+{
+  recon_command cmd;
+  cmd.type = RECON_RESIDUAL;
+  cmd.x  = xT;
+  cmd.y  = yT;
+  cmd.xB = x0;
+  cmd.yB = y0;
+  cmd.nT = nT;
+  cmd.cIdx = cIdx;
+  cmd.transform_skip_flag = transform_skip_flag;
+  cmd.cu_transquant_bypass_flag = tctx->cu_transquant_bypass_flag;
+  cmd.intra = intra;
+
+  switch (cIdx) {
+  case 0:  cmd.qP = tctx->qPYPrime;  break;
+  case 1:  cmd.qP = tctx->qPCbPrime; break;
+  default: cmd.qP = tctx->qPCrPrime; break;
+  }
+
+  int n = tctx->nCoeff[cIdx];
+  cmd.nCoeff = n;
+
+  coeffList.insert(coeffList.end(), tctx->coeffList[cIdx], tctx->coeffList[cIdx]+n);
+  coeffPos .insert(coeffPos .end(), tctx->coeffPos [cIdx], tctx->coeffPos [cIdx]+n);
+
+  cmds.push_back(cmd);
+}
+
+
+
+recon_pipeline::recon_pipeline()
+{
+  nFilled  = 0;
+  writeIdx = 0;
+  readIdx  = 0;
+  eod = false;
+
+  de265_mutex_init(&mutex);
+  de265_cond_init(&cond);
+}
+
+
+recon_pipeline::~recon_pipeline()
+{
+  de265_mutex_destroy(&mutex);
+  de265_cond_destroy(&cond);
+}
+
+
+ctb_syntax_buffer* recon_pipeline::begin_CTB(int ctbAddrRS, slice_segment_header* shdr)
+{
+  de265_mutex_lock(&mutex);
+  while (nFilled == RECON_PIPELINE_DEPTH) {
+    de265_cond_wait(&cond, &mutex);
+  }
+  de265_mutex_unlock(&mutex);
+
+  ctb_syntax_buffer* buf = &buffers[writeIdx];
+  buf->clear();
+  buf->ctbAddrRS = ctbAddrRS;
+  buf->shdr = shdr;
+
+  return buf;
+}
+
+
+void recon_pipeline::end_CTB()
+{
+  de265_mutex_lock(&mutex);
+  writeIdx = (writeIdx+1) % RECON_PIPELINE_DEPTH;
+  nFilled++;
+  de265_cond_broadcast(&cond, &mutex);
+  de265_mutex_unlock(&mutex);
+}
+
+
+void recon_pipeline::end_of_data()
+{
+  de265_mutex_lock(&mutex);
+  eod = true;
+  de265_cond_broadcast(&cond, &mutex);
+  de265_mutex_unlock(&mutex);
+}
+
+
+ctb_syntax_buffer* recon_pipeline::next_CTB()
+{
+  de265_mutex_lock(&mutex);
+  while (nFilled == 0 && !eod) {
+    de265_cond_wait(&cond, &mutex);
+  }
+
+  ctb_syntax_buffer* buf = (nFilled>0) ? &buffers[readIdx] : NULL;
+  de265_mutex_unlock(&mutex);
+
+  return buf;
+}
+
+
+void recon_pipeline::release_CTB()
+{
+  de265_mutex_lock(&mutex);
+  readIdx = (readIdx+1) % RECON_PIPELINE_DEPTH;
+  nFilled--;
+  de265_cond_broadcast(&cond, &mutex);
+  de265_mutex_unlock(&mutex);
+}
+
+
+
+void reconstruct_CTB(thread_context* tctx, const ctb_syntax_buffer* buf)
+{
+  int coeffIdx = 0;
+
+  for (size_t i=0;i<buf->cmds.size();i++) {
+    const recon_command& cmd = buf->cmds[i];
+
+    switch (cmd.type) {
+    case RECON_INTER_PREDICTION:
+      generate_inter_prediction_samples(tctx->decctx, tctx->img, buf->shdr,
+                                        cmd.x,cmd.y, cmd.xB,cmd.yB,
+                                        cmd.nT, cmd.nPbW,cmd.nPbH, &cmd.vi);
+      break;
+
+    case RECON_INTRA_PREDICTION:
+      decode_intra_prediction(tctx->img, cmd.x,cmd.y,
+                              (enum IntraPredMode)cmd.intraPredMode, cmd.nT, cmd.cIdx);
+      break;
+
+    case RECON_RESIDUAL:
+      {
+        int cIdx = cmd.cIdx;
+
+        tctx->cu_transquant_bypass_flag = cmd.cu_transquant_bypass_flag;
+        tctx->qPYPrime  = cmd.qP;
+        tctx->qPCbPrime = cmd.qP;
+        tctx->qPCrPrime = cmd.qP;
+
+        tctx->nCoeff[cIdx] = cmd.nCoeff;
+        memcpy(tctx->coeffList[cIdx], &buf->coeffList[coeffIdx], cmd.nCoeff*sizeof(int16_t));
+        memcpy(tctx->coeffPos [cIdx], &buf->coeffPos [coeffIdx], cmd.nCoeff*sizeof(int16_t));
+        coeffIdx += cmd.nCoeff;
+
+        scale_coefficients(tctx, cmd.x,cmd.y, cmd.xB,cmd.yB, cmd.nT, cIdx,
+                           cmd.transform_skip_flag, cmd.intra);
+      }
+      break;
+    }
+  }
+}
+
+
+void thread_task_reconstruct::describe(task_trace_event* ev) const
+{
+  ev->name  = "reconstruction";
+  ev->index = -1;
+  ev->POC   = tctx->img->PicOrderCntVal;
+}
+
+
+void thread_task_reconstruct::work()
+{
+  de265_image* img = tctx->img;
+
+  state = Running;
+  img->thread_run();
+
+  for (;;) {
+    ctb_syntax_buffer* buf = pipeline->next_CTB();
+    if (buf==NULL) {
+      break;
+    }
+
+    reconstruct_CTB(tctx, buf);
+
+    img->ctb_progress[buf->ctbAddrRS].set_progress(CTB_PROGRESS_PREFILTER);
+
+    pipeline->release_CTB();
+  }
+
+  state = Finished;
+  img->thread_finishes();
+}
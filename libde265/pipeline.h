@@ -0,0 +1,143 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DE265_PIPELINE_H
+#define DE265_PIPELINE_H
+
+#include "libde265/threads.h"
+#include "libde265/motion.h"
+#include "libde265/slice.h"
+
+#include <vector>
+
+struct thread_context;
+
+
+/* Decoupled parsing and reconstruction.
+
+   The parser records, for each CTB, the prediction and residual operations in
+   decoding order into a ctb_syntax_buffer instead of executing them. A separate
+   reconstruction task replays the buffers in CTB order and marks the CTBs as decoded.
+   Reconstruction may lag up to RECON_PIPELINE_DEPTH CTBs behind the parser.
+ */
+
+#define RECON_PIPELINE_DEPTH 8
+
+enum recon_command_type {
+  RECON_INTER_PREDICTION,
+  RECON_INTRA_PREDICTION,
+  RECON_RESIDUAL
+};
+
+
+struct recon_command
+{
+  uint8_t type;  // enum recon_command_type
+  uint8_t cIdx;
+  uint8_t intraPredMode;
+  uint8_t transform_skip_flag : 1;
+  uint8_t cu_transquant_bypass_flag : 1;
+  uint8_t intra : 1;
+
+  int16_t x,y;   // inter: CB position,  intra/residual: TB position (chroma adapted)
+  int16_t xB,yB; // inter: PB offset in CB,  residual: CB position (chroma adapted)
+
+  uint8_t nT;    // inter: CB size,  intra/residual: TB size
+  uint8_t nPbW,nPbH;
+  int8_t  qP;
+
+  uint16_t nCoeff; // number of coefficients in ctb_syntax_buffer for this residual
+
+  VectorInfo vi;
+};
+
+
+class ctb_syntax_buffer
+{
+ public:
+  int ctbAddrRS;
+  slice_segment_header* shdr;
+
+  std::vector<recon_command> cmds;
+  std::vector<int16_t> coeffList;
+  std::vector<int16_t> coeffPos;
+
+  void clear() { cmds.clear(); coeffList.clear(); coeffPos.clear(); }
+
+  void add_inter_prediction(int xC,int yC, int xB,int yB, int nCS, int nPbW,int nPbH,
+                            const VectorInfo* vi);
+  void add_intra_prediction(int xB0,int yB0, enum IntraPredMode mode, int nT, int cIdx);
+
+  // takes the coefficients and quantization parameters from the parsing thread context
+  void add_residual(const thread_context* tctx,
+                    int xT,int yT, int x0,int y0, int nT, int cIdx,
+                    bool transform_skip_flag, bool intra);
+};
+
+
+class recon_pipeline
+{
+ public:
+  recon_pipeline();
+  ~recon_pipeline();
+
+  // --- parser side ---
+
+  // get an empty buffer for the next CTB, blocks while reconstruction is too far behind
+  ctb_syntax_buffer* begin_CTB(int ctbAddrRS, slice_segment_header* shdr);
+  void end_CTB();
+  void end_of_data();
+
+  // --- reconstruction side ---
+
+  // returns NULL when there are no more CTBs
+  ctb_syntax_buffer* next_CTB();
+  void release_CTB();
+
+ private:
+  ctb_syntax_buffer buffers[RECON_PIPELINE_DEPTH];
+
+  int  nFilled;  // number of buffers handed to reconstruction
+  int  writeIdx;
+  int  readIdx;
+  bool eod;
+
+  de265_mutex mutex;
+  de265_cond  cond;
+
+  recon_pipeline(const recon_pipeline&); // not allowed
+  const recon_pipeline& operator=(const recon_pipeline&); // not allowed
+};
+
+
+void reconstruct_CTB(thread_context* tctx, const ctb_syntax_buffer* buf);
+
+
+class thread_task_reconstruct : public thread_task
+{
+public:
+  struct thread_context* tctx; // context for reconstruction, not the parser context
+  recon_pipeline* pipeline;
+
+  virtual void work();
+  virtual void describe(task_trace_event*) const;
+};
+
+#endif
@@ -25,10 +25,11 @@
 #include <string.h>
 
 
-void apply_sao(de265_image* img, int xCtb,int yCtb,
-               const slice_segment_header* shdr, int cIdx, int nS,
-               const uint8_t* in_img,  int in_stride,
-               /* */ uint8_t* out_img, int out_stride)
+template <class pixel_t>
+static void apply_sao_internal(de265_image* img, int xCtb,int yCtb,
+                               const slice_segment_header* shdr, int cIdx, int nS,
+                               const pixel_t* in_img,  int in_stride,
+                               /* */ pixel_t* out_img, int out_stride)
 {
   const sao_info* saoinfo = img->get_sao_info(xCtb,yCtb);
 
@@ -99,8 +100,8 @@ void apply_sao(de265_image* img, int xCtb,int yCtb,
 
 
     for (int j=0;j<ctbH;j++) {
-      const uint8_t* in_ptr  = &in_img [xC+(yC+j)*in_stride];
-      /* */ uint8_t* out_ptr = &out_img[xC+(yC+j)*out_stride];
+      const pixel_t* in_ptr  = &in_img [xC+(yC+j)*in_stride];
+      /* */ pixel_t* out_ptr = &out_img[xC+(yC+j)*out_stride];
 
       for (int i=0;i<ctbW;i++) {
         int edgeIdx = -1;
@@ -239,6 +240,25 @@ void apply_sao(de265_image* img, int xCtb,int yCtb,
 }
 
 
+// in_stride and out_stride are in samples
+void apply_sao(de265_image* img, int xCtb,int yCtb,
+               const slice_segment_header* shdr, int cIdx, int nS,
+               const uint8_t* in_img,  int in_stride,
+               /* */ uint8_t* out_img, int out_stride)
+{
+  if (img->high_bit_depth(cIdx)) {
+    apply_sao_internal(img, xCtb,yCtb, shdr, cIdx, nS,
+                       (const uint16_t*)in_img, in_stride,
+                       (uint16_t*)out_img, out_stride);
+  }
+  else {
+    apply_sao_internal(img, xCtb,yCtb, shdr, cIdx, nS,
+                       in_img, in_stride,
+                       out_img, out_stride);
+  }
+}
+
+
 void apply_sample_adaptive_offset(de265_image* img)
 {
   if (img->sps.sample_adaptive_offset_enabled_flag==0) {
@@ -283,7 +303,8 @@ void apply_sample_adaptive_offset_sequential(de265_image* img)
   }
 
 
-  uint8_t* inputCopy = new uint8_t[ img->get_image_stride(0) * img->get_height(0) ];
+  uint8_t* inputCopy = new uint8_t[ img->get_image_stride(0) * img->get_height(0) *
+                                    img->get_bytes_per_pixel(0) ];
   if (inputCopy == NULL) {
     img->decctx->add_warning(DE265_WARNING_CANNOT_APPLY_SAO_OUT_OF_MEMORY,false);
     return;
@@ -295,7 +316,8 @@ void apply_sample_adaptive_offset_sequential(de265_image* img)
     int stride = img->get_image_stride(cIdx);
     int height = img->get_height(cIdx);
 
-    memcpy(inputCopy, img->get_image_plane(cIdx), stride * height);
+    memcpy(inputCopy, img->get_image_plane(cIdx),
+           stride * height * img->get_bytes_per_pixel(cIdx));
 
     for (int yCtb=0; yCtb<img->sps.PicHeightInCtbsY; yCtb++)
       for (int xCtb=0; xCtb<img->sps.PicWidthInCtbsY; xCtb++)
@@ -335,6 +357,11 @@ public:
   int inputProgress;
 
   virtual void work();
+  virtual void describe(task_trace_event* ev) const {
+    ev->name  = "SAO";
+    ev->index = ctb_y;
+    ev->POC   = img->PicOrderCntVal;
+  }
 };
 
 
@@ -396,6 +423,8 @@ void thread_task_sao::work()
     img->ctb_progress[x+ctb_y*CtbWidth].set_progress(CTB_PROGRESS_SAO);
   }
 
+  img->output_finished_rows();
+
 
   state = Finished;
   img->thread_finishes();
@@ -421,6 +450,12 @@ bool add_sao_tasks(image_unit* imgunit, int saoInputProgress)
     return false;
   }
 
+  // finished rows are in the SAO output until the pixel data is exchanged below
+
+  de265_mutex_lock(&img->row_output_mutex);
+  img->row_output_pixels = &imgunit->sao_output;
+  de265_mutex_unlock(&img->row_output_mutex);
+
   int nRows = img->sps.PicHeightInCtbsY;
 
   int n=0;
@@ -428,7 +463,7 @@ bool add_sao_tasks(image_unit* imgunit, int saoInputProgress)
 
   for (int y=0;y<img->sps.PicHeightInCtbsY;y++)
     {
-      thread_task_sao* task = new thread_task_sao;
+      thread_task_sao* task = ctx->task_arena.get_task<thread_task_sao>();
 
       task->inputImg  = img;
       task->outputImg = &imgunit->sao_output;
@@ -447,5 +482,7 @@ bool add_sao_tasks(image_unit* imgunit, int saoInputProgress)
 
   img->exchange_pixel_data_with(imgunit->sao_output);
 
+  img->row_output_pixels = img;
+
   return true;
 }
@@ -20,133 +20,160 @@
 
 #include "scan.h"
 
-static position scan0 = { 0,0 };
-static position scan_h_1[ 2* 2], scan_v_1[ 2* 2], scan_d_1[ 2* 2];
-static position scan_h_2[ 4* 4], scan_v_2[ 4* 4], scan_d_2[ 4* 4];
-static position scan_h_3[ 8* 8], scan_v_3[ 8* 8], scan_d_3[ 8* 8];
-static position scan_h_4[16*16], scan_v_4[16*16], scan_d_4[16*16];
-static position scan_h_5[32*32], scan_v_5[32*32], scan_d_5[32*32];
-
-static position* scan_h[7] = { &scan0,scan_h_1,scan_h_2,scan_h_3,scan_h_4,scan_h_5 };
-static position* scan_v[7] = { &scan0,scan_v_1,scan_v_2,scan_v_3,scan_v_4,scan_v_5 };
-static position* scan_d[7] = { &scan0,scan_d_1,scan_d_2,scan_d_3,scan_d_4,scan_d_5 };
-
-static void init_scan_h(position* scan, int blkSize)
-{
-  int i=0;
-  for (int y=0;y<blkSize;y++)
-    for (int x=0;x<blkSize;x++)
-      {
-        scan[i].x = x;
-        scan[i].y = y;
-        i++;
-      }
-}
 
-static void init_scan_v(position* scan, int blkSize)
-{
-  int i=0;
-  for (int x=0;x<blkSize;x++)
-    for (int y=0;y<blkSize;y++)
-      {
-        scan[i].x = x;
-        scan[i].y = y;
-        i++;
-      }
-}
+/* Scan orders and their inverse for all block sizes up to 8x8.
+   Transform blocks are scanned in 4x4 sub-blocks, so larger scans are never needed.
+   The tables are constant data, nothing has to be initialized at runtime.
+ */
 
-static void init_scan_d(position* scan, int blkSize)
-{
-  int i=0;
-  int x=0,y=0;
-
-  do {
-    while (y>=0) {
-      if (x<blkSize && y<blkSize) {
-        scan[i].x = x;
-        scan[i].y = y;
-        i++;
-      }
-      y--;
-      x++;
-    }
-
-    y=x;
-    x=0;
-  } while (i < blkSize*blkSize);
-}
+static const position scan_d_0[1*1] = {
+  {0,0}
+};
+static const position scan_h_0[1*1] = {
+  {0,0}
+};
+static const position scan_v_0[1*1] = {
+  {0,0}
+};
+
+static const position scan_d_1[2*2] = {
+  {0,0},{0,1},{1,0},{1,1}
+};
+static const position scan_h_1[2*2] = {
+  {0,0},{1,0},{0,1},{1,1}
+};
+static const position scan_v_1[2*2] = {
+  {0,0},{0,1},{1,0},{1,1}
+};
+
+static const position scan_d_2[4*4] = {
+  {0,0},{0,1},{1,0},{0,2},{1,1},{2,0},{0,3},{1,2},
+  {2,1},{3,0},{1,3},{2,2},{3,1},{2,3},{3,2},{3,3}
+};
+static const position scan_h_2[4*4] = {
+  {0,0},{1,0},{2,0},{3,0},{0,1},{1,1},{2,1},{3,1},
+  {0,2},{1,2},{2,2},{3,2},{0,3},{1,3},{2,3},{3,3}
+};
+static const position scan_v_2[4*4] = {
+  {0,0},{0,1},{0,2},{0,3},{1,0},{1,1},{1,2},{1,3},
+  {2,0},{2,1},{2,2},{2,3},{3,0},{3,1},{3,2},{3,3}
+};
+
+static const position scan_d_3[8*8] = {
+  {0,0},{0,1},{1,0},{0,2},{1,1},{2,0},{0,3},{1,2},
+  {2,1},{3,0},{0,4},{1,3},{2,2},{3,1},{4,0},{0,5},
+  {1,4},{2,3},{3,2},{4,1},{5,0},{0,6},{1,5},{2,4},
+  {3,3},{4,2},{5,1},{6,0},{0,7},{1,6},{2,5},{3,4},
+  {4,3},{5,2},{6,1},{7,0},{1,7},{2,6},{3,5},{4,4},
+  {5,3},{6,2},{7,1},{2,7},{3,6},{4,5},{5,4},{6,3},
+  {7,2},{3,7},{4,6},{5,5},{6,4},{7,3},{4,7},{5,6},
+  {6,5},{7,4},{5,7},{6,6},{7,5},{6,7},{7,6},{7,7}
+};
+static const position scan_h_3[8*8] = {
+  {0,0},{1,0},{2,0},{3,0},{4,0},{5,0},{6,0},{7,0},
+  {0,1},{1,1},{2,1},{3,1},{4,1},{5,1},{6,1},{7,1},
+  {0,2},{1,2},{2,2},{3,2},{4,2},{5,2},{6,2},{7,2},
+  {0,3},{1,3},{2,3},{3,3},{4,3},{5,3},{6,3},{7,3},
+  {0,4},{1,4},{2,4},{3,4},{4,4},{5,4},{6,4},{7,4},
+  {0,5},{1,5},{2,5},{3,5},{4,5},{5,5},{6,5},{7,5},
+  {0,6},{1,6},{2,6},{3,6},{4,6},{5,6},{6,6},{7,6},
+  {0,7},{1,7},{2,7},{3,7},{4,7},{5,7},{6,7},{7,7}
+};
+static const position scan_v_3[8*8] = {
+  {0,0},{0,1},{0,2},{0,3},{0,4},{0,5},{0,6},{0,7},
+  {1,0},{1,1},{1,2},{1,3},{1,4},{1,5},{1,6},{1,7},
+  {2,0},{2,1},{2,2},{2,3},{2,4},{2,5},{2,6},{2,7},
+  {3,0},{3,1},{3,2},{3,3},{3,4},{3,5},{3,6},{3,7},
+  {4,0},{4,1},{4,2},{4,3},{4,4},{4,5},{4,6},{4,7},
+  {5,0},{5,1},{5,2},{5,3},{5,4},{5,5},{5,6},{5,7},
+  {6,0},{6,1},{6,2},{6,3},{6,4},{6,5},{6,6},{6,7},
+  {7,0},{7,1},{7,2},{7,3},{7,4},{7,5},{7,6},{7,7}
+};
+
+static const position* const scan_order[3][4] = {
+  { scan_d_0,scan_d_1,scan_d_2,scan_d_3 },
+  { scan_h_0,scan_h_1,scan_h_2,scan_h_3 },
+  { scan_v_0,scan_v_1,scan_v_2,scan_v_3 } };
 
 
 const position* get_scan_order(int log2BlockSize, int scanIdx)
 {
-  switch (scanIdx) {
-  case 0: return scan_d[log2BlockSize];
-  case 1: return scan_h[log2BlockSize];
-  case 2: return scan_v[log2BlockSize];
-  default: return 0; // should never happen
-  }
+  return scan_order[scanIdx][log2BlockSize];
 }
 
 
+// position in scan order of each (x,y), indexed with x+y*w
+
+static const uint8_t scanpos_d_0[1*1] = { 0 };
+static const uint8_t scanpos_h_0[1*1] = { 0 };
+static const uint8_t scanpos_v_0[1*1] = { 0 };
+
+static const uint8_t scanpos_d_1[2*2] = { 0,2,1,3 };
+static const uint8_t scanpos_h_1[2*2] = { 0,1,2,3 };
+static const uint8_t scanpos_v_1[2*2] = { 0,2,1,3 };
+
+static const uint8_t scanpos_d_2[4*4] = {
+   0, 2, 5, 9,
+   1, 4, 8,12,
+   3, 7,11,14,
+   6,10,13,15
+};
+static const uint8_t scanpos_h_2[4*4] = {
+   0, 1, 2, 3,
+   4, 5, 6, 7,
+   8, 9,10,11,
+  12,13,14,15
+};
+static const uint8_t scanpos_v_2[4*4] = {
+   0, 4, 8,12,
+   1, 5, 9,13,
+   2, 6,10,14,
+   3, 7,11,15
+};
+
+static const uint8_t scanpos_d_3[8*8] = {
+   0, 2, 5, 9,14,20,27,35,
+   1, 4, 8,13,19,26,34,42,
+   3, 7,12,18,25,33,41,48,
+   6,11,17,24,32,40,47,53,
+  10,16,23,31,39,46,52,57,
+  15,22,30,38,45,51,56,60,
+  21,29,37,44,50,55,59,62,
+  28,36,43,49,54,58,61,63
+};
+static const uint8_t scanpos_h_3[8*8] = {
+   0, 1, 2, 3, 4, 5, 6, 7,
+   8, 9,10,11,12,13,14,15,
+  16,17,18,19,20,21,22,23,
+  24,25,26,27,28,29,30,31,
+  32,33,34,35,36,37,38,39,
+  40,41,42,43,44,45,46,47,
+  48,49,50,51,52,53,54,55,
+  56,57,58,59,60,61,62,63
+};
+static const uint8_t scanpos_v_3[8*8] = {
+   0, 8,16,24,32,40,48,56,
+   1, 9,17,25,33,41,49,57,
+   2,10,18,26,34,42,50,58,
+   3,11,19,27,35,43,51,59,
+   4,12,20,28,36,44,52,60,
+   5,13,21,29,37,45,53,61,
+   6,14,22,30,38,46,54,62,
+   7,15,23,31,39,47,55,63
+};
+
+static const uint8_t* const scanpos[3][4] = {
+  { scanpos_d_0,scanpos_d_1,scanpos_d_2,scanpos_d_3 },
+  { scanpos_h_0,scanpos_h_1,scanpos_h_2,scanpos_h_3 },
+  { scanpos_v_0,scanpos_v_1,scanpos_v_2,scanpos_v_3 } };
 
-static scan_position scanpos_h_2[ 4* 4], scanpos_v_2[ 4* 4], scanpos_d_2[ 4* 4];
-static scan_position scanpos_h_3[ 8* 8], scanpos_v_3[ 8* 8], scanpos_d_3[ 8* 8];
-static scan_position scanpos_h_4[16*16], scanpos_v_4[16*16], scanpos_d_4[16*16];
-static scan_position scanpos_h_5[32*32], scanpos_v_5[32*32], scanpos_d_5[32*32];
-
-static scan_position* scanpos[3][6] =
-  { { 0,0,scanpos_d_2,scanpos_d_3,scanpos_d_4,scanpos_d_5 },
-    { 0,0,scanpos_h_2,scanpos_h_3,scanpos_h_4,scanpos_h_5 },
-    { 0,0,scanpos_v_2,scanpos_v_3,scanpos_v_4,scanpos_v_5 } };
-   
 
 scan_position get_scan_position(int x,int y, int scanIdx, int log2BlkSize)
 {
-  return scanpos[scanIdx][log2BlkSize][ y*(1<<log2BlkSize) + x ];
-}
+  const int log2SbSize = log2BlkSize-2;
 
-static void fill_scan_pos(scan_position* pos, int x,int y,int scanIdx, int log2TrafoSize)
-{
-  int lastScanPos = 16;
-  int lastSubBlock = (1<<(log2TrafoSize-2)) * (1<<(log2TrafoSize-2)) -1;
-
-  const position* ScanOrderSub = get_scan_order(log2TrafoSize-2, scanIdx);
-  const position* ScanOrderPos = get_scan_order(2, scanIdx);
-
-  int xC,yC;
-  do {
-    if (lastScanPos==0) {
-      lastScanPos=16;
-      lastSubBlock--;
-    }
-    lastScanPos--;
-
-    position S = ScanOrderSub[lastSubBlock];
-    xC = (S.x<<2) + ScanOrderPos[lastScanPos].x;
-    yC = (S.y<<2) + ScanOrderPos[lastScanPos].y;
-
-  } while ( (xC != x) || (yC != y));
-
-  pos->subBlock = lastSubBlock;
-  pos->scanPos  = lastScanPos;
-}
-
-
-void init_scan_orders()
-{
-  for (int log2size=1;log2size<=5;log2size++)
-    {
-      init_scan_h(scan_h[log2size], 1<<log2size);
-      init_scan_v(scan_v[log2size], 1<<log2size);
-      init_scan_d(scan_d[log2size], 1<<log2size);
-    }
-
-
-  for (int log2size=2;log2size<=5;log2size++)
-    for (int scanIdx=0;scanIdx<3;scanIdx++)
-      for (int y=0;y<(1<<log2size);y++)
-        for (int x=0;x<(1<<log2size);x++)
-          {
-            fill_scan_pos(&scanpos[scanIdx][log2size][ y*(1<<log2size) + x ],x,y,scanIdx,log2size);
-          }
+  scan_position pos;
+  pos.subBlock = scanpos[scanIdx][log2SbSize][ (x>>2) + ((y>>2)<<log2SbSize) ];
+  pos.scanPos  = scanpos[scanIdx][2][ (x&3) + ((y&3)<<2) ];
+  return pos;
 }
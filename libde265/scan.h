@@ -32,9 +32,8 @@ typedef struct {
   uint8_t scanPos;
 } scan_position;
 
-void init_scan_orders();
-
 /* scanIdx: 0 - diag, 1 - horiz, 2 - verti
+   log2BlockSize: 0-3 (sub-block scans and scans within a 4x4 sub-block)
  */
 const position* get_scan_order(int log2BlockSize, int scanIdx);
 
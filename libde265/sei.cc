@@ -96,7 +96,7 @@ static void dump_sei_decoded_picture_hash(const sei_message* sei,
 }
 
 
-static uint32_t compute_checksum_8bit(uint8_t* data,int w,int h,int stride)
+static uint32_t compute_checksum_8bit(const uint8_t* data,int w,int h,int stride)
 {
   uint32_t sum = 0;
   for (int y=0; y<h; y++)
@@ -115,6 +115,19 @@ static uint32_t compute_checksum_8bit(uint8_t* data,int w,int h,int stride)
   return sum & 0xFFFFFFFF;
 }
 
+static uint32_t compute_checksum_16bit(const uint16_t* data,int w,int h,int stride)
+{
+  uint32_t sum = 0;
+  for (int y=0; y<h; y++)
+    for(int x=0; x<w; x++) {
+      uint8_t xorMask = ( x & 0xFF ) ^ ( y & 0xFF ) ^ ( x  >>  8 ) ^ ( y  >>  8 );
+      uint16_t v = data[y*stride + x];
+      sum += ((v & 0xFF) ^ xorMask) + ((v >> 8) ^ xorMask);
+    }
+
+  return sum & 0xFFFFFFFF;
+}
+
 static inline uint16_t crc_process_byte(uint16_t crc, uint8_t byte)
 {
   for (int bit=0;bit<8;bit++) {
@@ -157,6 +170,24 @@ static inline uint16_t crc_process_byte_parallel(uint16_t crc, uint8_t byte)
 	   (t << 12)) & 0xFFFF;
 }
 
+/* CRC tables for processing four bytes at once (slicing-by-4).
+   crc_table[k][b] is the CRC contribution of byte b followed by k zero bytes.
+ */
+static uint16_t crc_table[4][256];
+
+void init_sei_crc_tables()
+{
+  for (int b=0;b<256;b++) {
+    crc_table[0][b] = crc_process_byte_parallel(0, b);
+  }
+
+  for (int k=1;k<4;k++)
+    for (int b=0;b<256;b++) {
+      uint16_t prev = crc_table[k-1][b];
+      crc_table[k][b] = (uint16_t)((prev<<8) ^ crc_table[0][prev>>8]);
+    }
+}
+
 static uint32_t compute_CRC_8bit_fast(const uint8_t* data,int w,int h,int stride)
 {
   uint16_t crc = 0xFFFF;
@@ -167,7 +198,16 @@ static uint32_t compute_CRC_8bit_fast(const uint8_t* data,int w,int h,int stride
   for (int y=0; y<h; y++) {
     const uint8_t* d = &data[y*stride];
 
-    for(int x=0; x<w; x++) {
+    int x=0;
+    for(; x+4<=w; x+=4) {
+      crc = (crc_table[3][(crc>>8) ^ d[0]] ^
+             crc_table[2][(crc&0xFF) ^ d[1]] ^
+             crc_table[1][d[2]] ^
+             crc_table[0][d[3]]);
+      d+=4;
+    }
+
+    for(; x<w; x++) {
       crc = crc_process_byte_parallel(crc, *d++);
     }
   }
@@ -175,19 +215,138 @@ static uint32_t compute_CRC_8bit_fast(const uint8_t* data,int w,int h,int stride
   return crc;
 }
 
-static void compute_MD5_8bit(uint8_t* data,int w,int h,int stride, uint8_t* result)
+static void compute_MD5_8bit(const uint8_t* data,int w,int h,int stride, uint8_t* result)
 {
   MD5_CTX md5;
   MD5_Init(&md5);
 
   for (int y=0; y<h; y++) {
-    MD5_Update(&md5, &data[y*stride], w);
+    MD5_Update(&md5, (void*)&data[y*stride], w);
   }
 
   MD5_Final(result, &md5);
 }
 
 
+/* For bit depths larger than 8, each sample is hashed as two bytes,
+   least significant byte first (D.3.19). */
+
+static uint32_t compute_CRC_16bit(const uint16_t* data,int w,int h,int stride)
+{
+  uint16_t crc = 0xFFFF;
+
+  crc = crc_process_byte_parallel(crc, 0);
+  crc = crc_process_byte_parallel(crc, 0);
+
+  for (int y=0; y<h; y++) {
+    const uint16_t* d = &data[y*stride];
+
+    for (int x=0; x<w; x++) {
+      crc = (crc_table[1][(crc>>8) ^ (d[x] & 0xFF)] ^
+             crc_table[0][(crc&0xFF) ^ (d[x] >> 8)]);
+    }
+  }
+
+  return crc;
+}
+
+static void compute_MD5_16bit(const uint16_t* data,int w,int h,int stride, uint8_t* result)
+{
+  MD5_CTX md5;
+  MD5_Init(&md5);
+
+  uint8_t* row = new uint8_t[2*w];
+
+  for (int y=0; y<h; y++) {
+    const uint16_t* d = &data[y*stride];
+
+    for (int x=0; x<w; x++) {
+      row[2*x  ] = d[x] & 0xFF;
+      row[2*x+1] = d[x] >> 8;
+    }
+
+    MD5_Update(&md5, row, 2*w);
+  }
+
+  delete[] row;
+
+  MD5_Final(result, &md5);
+}
+
+
+static de265_error check_decoded_picture_hash_plane(const sei_decoded_picture_hash* seihash,
+                                                    const de265_image* img, int cIdx)
+{
+  const uint8_t* data = img->get_image_plane(cIdx);
+  int w = img->get_width(cIdx);
+  int h = img->get_height(cIdx);
+  int stride = img->get_image_stride(cIdx);
+  const bool high_bit_depth = img->high_bit_depth(cIdx);
+
+  switch (seihash->hash_type) {
+  case sei_decoded_picture_hash_type_MD5:
+    {
+      uint8_t md5[16];
+      if (high_bit_depth) {
+        compute_MD5_16bit((const uint16_t*)data,w,h,stride,md5);
+      }
+      else {
+        compute_MD5_8bit(data,w,h,stride,md5);
+      }
+
+/*
+      fprintf(stderr,"computed MD5: ");
+      for (int b=0;b<16;b++) {
+        fprintf(stderr,"%02x", md5[b]);
+      }
+      fprintf(stderr,"\n");
+*/
+
+      for (int b=0;b<16;b++) {
+        if (md5[b] != seihash->md5[cIdx][b]) {
+          fprintf(stderr,"SEI decoded picture MD5 mismatch (POC=%d)\n", img->PicOrderCntVal);
+          return DE265_ERROR_CHECKSUM_MISMATCH;
+        }
+      }
+    }
+    break;
+
+  case sei_decoded_picture_hash_type_CRC:
+    {
+      uint16_t crc = (high_bit_depth ?
+                      compute_CRC_16bit((const uint16_t*)data,w,h,stride) :
+                      compute_CRC_8bit_fast(data,w,h,stride));
+
+      logtrace(LogSEI,"SEI decoded picture hash: %04x <-[%d]-> decoded picture: %04x\n",
+               seihash->crc[cIdx], cIdx, crc);
+
+      if (crc != seihash->crc[cIdx]) {
+        fprintf(stderr,"SEI decoded picture hash: %04x, decoded picture: %04x (POC=%d)\n",
+                seihash->crc[cIdx], crc, img->PicOrderCntVal);
+        return DE265_ERROR_CHECKSUM_MISMATCH;
+      }
+    }
+    break;
+
+  case sei_decoded_picture_hash_type_checksum:
+    {
+      uint32_t chksum = (high_bit_depth ?
+                         compute_checksum_16bit((const uint16_t*)data,w,h,stride) :
+                         compute_checksum_8bit(data,w,h,stride));
+
+      if (chksum != seihash->checksum[cIdx]) {
+        fprintf(stderr,"SEI decoded picture hash: %04x, decoded picture: %04x (POC=%d)\n",
+                seihash->checksum[cIdx], chksum, img->PicOrderCntVal);
+        return DE265_ERROR_CHECKSUM_MISMATCH;
+      }
+    }
+    break;
+  }
+
+  return DE265_OK;
+}
+
+
 static de265_error process_sei_decoded_picture_hash(const sei_message* sei, de265_image* img)
 {
   const sei_decoded_picture_hash* seihash = &sei->data.decoded_picture_hash;
@@ -200,75 +359,95 @@ static de265_error process_sei_decoded_picture_hash(const sei_message* sei, de26
     return DE265_OK;
   }
 
+  // parts of the picture outside of the region of interest have not been decoded
+  if (img->tiles_skipped) {
+    return DE265_OK;
+  }
+
   //write_picture(img);
 
   int nHashes = img->sps.chroma_format_idc==0 ? 1 : 3;
   for (int i=0;i<nHashes;i++) {
-    uint8_t* data;
-    int w,h,stride;
+    de265_error err = check_decoded_picture_hash_plane(seihash, img, i);
+    if (err != DE265_OK) {
+      return err;
+    }
+  }
 
-    w = img->get_width(i);
-    h = img->get_height(i);
+  loginfo(LogSEI,"decoded picture hash checked: OK\n");
+  //printf("checked picture %d SEI: OK\n", img->PicOrderCntVal);
 
-    data = img->get_image_plane(i);
-    stride = img->get_image_stride(i);
+  return DE265_OK;
+}
 
-    switch (seihash->hash_type) {
-    case sei_decoded_picture_hash_type_MD5:
-      {
-        uint8_t md5[16];
-        compute_MD5_8bit(data,w,h,stride,md5);
 
-/*
-        fprintf(stderr,"computed MD5: ");
-        for (int b=0;b<16;b++) {
-          fprintf(stderr,"%02x", md5[b]);
-        }
-        fprintf(stderr,"\n");
-*/
+class thread_task_sei_hash : public thread_task
+{
+public:
+  const sei_decoded_picture_hash* seihash;
+  de265_image* img;
+  int cIdx;
+
+  virtual void work();
+  virtual void describe(task_trace_event* ev) const {
+    ev->name  = "SEI hash";
+    ev->index = cIdx;
+    ev->POC   = img->PicOrderCntVal;
+  }
+};
 
-        for (int b=0;b<16;b++) {
-          if (md5[b] != seihash->md5[i][b]) {
-            fprintf(stderr,"SEI decoded picture MD5 mismatch (POC=%d)\n", img->PicOrderCntVal);
-            return DE265_ERROR_CHECKSUM_MISMATCH;
-          }
-        }
-      }
-      break;
 
-    case sei_decoded_picture_hash_type_CRC:
-      {
-        uint16_t crc = compute_CRC_8bit_fast(data,w,h,stride);
+void thread_task_sei_hash::work()
+{
+  state = Running;
+  img->thread_run();
 
-        logtrace(LogSEI,"SEI decoded picture hash: %04x <-[%d]-> decoded picture: %04x\n",
-                 seihash->crc[i], i, crc);
+  if (check_decoded_picture_hash_plane(seihash, img, cIdx) != DE265_OK) {
+    img->sei_hash_check_result = false;
+  }
 
-        if (crc != seihash->crc[i]) {
-          fprintf(stderr,"SEI decoded picture hash: %04x, decoded picture: %04x (POC=%d)\n",
-                  seihash->crc[i], crc, img->PicOrderCntVal);
-          return DE265_ERROR_CHECKSUM_MISMATCH;
-        }
-      }
-      break;
+  state = Finished;
+  img->thread_finishes();
+}
 
-    case sei_decoded_picture_hash_type_checksum:
-      {
-        uint32_t chksum = compute_checksum_8bit(data,w,h,stride);
 
-        if (chksum != seihash->checksum[i]) {
-          fprintf(stderr,"SEI decoded picture hash: %04x, decoded picture: %04x (POC=%d)\n",
-                  seihash->checksum[i], chksum, img->PicOrderCntVal);
-          return DE265_ERROR_CHECKSUM_MISMATCH;
-        }
-      }
-      break;
-    }
+bool add_sei_hash_tasks(image_unit* imgunit)
+{
+  de265_image* img = imgunit->img;
+  decoder_context* ctx = img->decctx;
+
+  img->sei_hash_check_result = true;
+
+  // see process_sei_decoded_picture_hash()
+  if (img->PicOutputFlag == false || img->tiles_skipped) {
+    return false;
   }
 
-  loginfo(LogSEI,"decoded picture hash checked: OK\n");
-  //printf("checked picture %d SEI: OK\n", img->PicOrderCntVal);
+  int nHashes = img->sps.chroma_format_idc==0 ? 1 : 3;
+  bool tasksAdded = false;
 
-  return DE265_OK;
+  for (size_t i=0;i<imgunit->suffix_SEIs.size();i++) {
+    const sei_message& sei = imgunit->suffix_SEIs[i];
+    if (sei.payload_type != sei_payload_type_decoded_picture_hash) {
+      continue;
+    }
+
+    img->thread_start(nHashes);
+
+    for (int c=0;c<nHashes;c++) {
+      thread_task_sei_hash* task = ctx->task_arena.get_task<thread_task_sei_hash>();
+      task->seihash = &sei.data.decoded_picture_hash;
+      task->img  = img;
+      task->cIdx = c;
+
+      imgunit->tasks.push_back(task);
+      add_task(&ctx->thread_pool, task);
+    }
+
+    tasksAdded = true;
+  }
+
+  return tasksAdded;
 }
 
 
@@ -333,7 +512,7 @@ de265_error process_sei(const sei_message* sei, de265_image* img)
 
   switch (sei->payload_type) {
   case sei_payload_type_decoded_picture_hash:
-    if (img->decctx->param_sei_check_hash) {
+    if (img->decctx->param_sei_check_hash && !img->decctx->param_parse_only) {
       err = process_sei_decoded_picture_hash(sei, img);
     }
 
@@ -87,4 +87,12 @@ de265_error read_sei(bitreader* reader, sei_message*, bool suffix, const seq_par
 void dump_sei(const sei_message*, const seq_parameter_set* sps);
 de265_error process_sei(const sei_message*, class de265_image* img);
 
+/* Verify the decoded picture hashes of the image unit on the worker threads, with one
+   task per color plane. Returns false if there is nothing to check. Otherwise, wait
+   with img->wait_for_completion() and then read img->sei_hash_check_result.
+ */
+bool add_sei_hash_tasks(struct image_unit* imgunit);
+
+void init_sei_crc_tables();
+
 #endif
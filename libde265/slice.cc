@@ -29,6 +29,7 @@
 #include "transform.h"
 #include "threads.h"
 #include "image.h"
+#include "deblock.h"
 
 #include <assert.h>
 #include <string.h>
@@ -207,6 +208,11 @@ de265_error slice_segment_header::read(bitreader* br, decoder_context* ctx,
         return DE265_OK;
       }
 
+      if (ctx->previous_slice_header == NULL) {
+        ctx->add_warning(DE265_WARNING_SLICEHEADER_INVALID, false);
+        return DE265_OK;
+      }
+
       *this = *ctx->previous_slice_header;
 
       first_slice_segment_in_pic_flag = 0;
@@ -1013,10 +1019,9 @@ static int decode_sao_type_idx(thread_context* tctx)
 }
 
 
-static int decode_sao_offset_abs(thread_context* tctx)
+static int decode_sao_offset_abs(thread_context* tctx, int bitDepth)
 {
   logtrace(LogSlice,"# sao_offset_abs\n");
-  int bitDepth = 8;
   int cMax = (1<<(libde265_min(bitDepth,10)-5))-1;
   int value = decode_CABAC_TU_bypass(&tctx->cabac_decoder, cMax);
   return value;
@@ -1356,392 +1361,39 @@ static int decode_last_significant_coeff_prefix(thread_context* tctx,
 }
 
 
-static const uint8_t ctxIdxMap[16] = {
-  0,1,4,5,
-  2,3,4,5,
-  6,6,8,8,
-  7,7,8,99
+/* sigCtx of significant_coeff_flag for the positions (xP+4*yP) in a 4x4 sub-block (9.3.4.2.5).
+   [0-3]: sub-blocks of 8x8 and larger transform blocks, depending on prevCsbf.
+          The transform block size, the sub-block position and cIdx only add an offset
+          (see sig_coeff_ctx_offset()), except for the DC coefficient of the first sub-block.
+   [4]:   4x4 transform blocks (ctxIdxMap in the spec)
+ */
+static const uint8_t sigCtx_lookup[5][16] = {
+  { 2,1,1,0, 1,1,0,0, 1,0,0,0, 0,0,0,0 },
+  { 2,2,2,2, 1,1,1,1, 0,0,0,0, 0,0,0,0 },
+  { 2,1,0,0, 2,1,0,0, 2,1,0,0, 2,1,0,0 },
+  { 2,2,2,2, 2,2,2,2, 2,2,2,2, 2,2,2,2 },
+  { 0,1,4,5, 2,3,4,5, 6,6,8,8, 7,7,8,99 }
 };
 
-uint8_t* ctxIdxLookup[4 /* 4-log2-32 */][2 /* !!cIdx */][2 /* !!scanIdx */][4 /* prevCsbf */];
-
-bool alloc_and_init_significant_coeff_ctxIdx_lookupTable()
-{
-  int tableSize = 4*4*(2) + 8*8*(2*2*4) + 16*16*(2*4) + 32*32*(2*4);
-
-  uint8_t* p = (uint8_t*)malloc(tableSize);
-  if (p==NULL) {
-    return false;
-  }
-
-  memset(p,0xFF,tableSize);  // just for debugging
-
-
-  // --- Set pointers to memory areas. Note that some parameters share the same memory. ---
-
-  // 4x4
-
-  for (int cIdx=0;cIdx<2;cIdx++) {
-    for (int scanIdx=0;scanIdx<2;scanIdx++)
-      for (int prevCsbf=0;prevCsbf<4;prevCsbf++)
-        ctxIdxLookup[0][cIdx][scanIdx][prevCsbf] = p;
-
-    p += 4*4;
-  }
-
-  // 8x8
-
-  for (int cIdx=0;cIdx<2;cIdx++)
-    for (int scanIdx=0;scanIdx<2;scanIdx++)
-      for (int prevCsbf=0;prevCsbf<4;prevCsbf++) {
-        ctxIdxLookup[1][cIdx][scanIdx][prevCsbf] = p;
-        p += 8*8;
-      }
-
-  // 16x16
-
-  for (int cIdx=0;cIdx<2;cIdx++)
-    for (int prevCsbf=0;prevCsbf<4;prevCsbf++) {
-      for (int scanIdx=0;scanIdx<2;scanIdx++) {
-        ctxIdxLookup[2][cIdx][scanIdx][prevCsbf] = p;
-      }
-
-      p += 16*16;
-    }
-
-  // 32x32
-
-  for (int cIdx=0;cIdx<2;cIdx++)
-    for (int prevCsbf=0;prevCsbf<4;prevCsbf++) {
-      for (int scanIdx=0;scanIdx<2;scanIdx++) {
-        ctxIdxLookup[3][cIdx][scanIdx][prevCsbf] = p;
-      }
-
-      p += 32*32;
-    }
-
-
-  // --- precompute ctxIdx tables ---
-
-  for (int log2w=2; log2w<=5 ; log2w++)
-    for (int cIdx=0;cIdx<2;cIdx++)
-      for (int scanIdx=0;scanIdx<2;scanIdx++)
-        for (int prevCsbf=0;prevCsbf<4;prevCsbf++)
-          {
-            for (int yC=0;yC<(1<<log2w);yC++)
-              for (int xC=0;xC<(1<<log2w);xC++)
-                {
-                  int w = 1<<log2w;
-                  int sbWidth = w>>2;
-
-                  int sigCtx;
-
-                  // if log2TrafoSize==2
-                  if (sbWidth==1) {
-                    sigCtx = ctxIdxMap[(yC<<2) + xC];
-                  }
-                  else if (xC+yC==0) {
-                    sigCtx = 0;
-                  }
-                  else {
-                    int xS = xC>>2;
-                    int yS = yC>>2;
-                    /*
-                      int prevCsbf = 0;
-
-                      if (xS < sbWidth-1) { prevCsbf += coded_sub_block_flag[xS+1  +yS*sbWidth];    }
-                      if (yS < sbWidth-1) { prevCsbf += coded_sub_block_flag[xS+(1+yS)*sbWidth]<<1; }
-                    */
-                    int xP = xC & 3;
-                    int yP = yC & 3;
-
-                    //logtrace(LogSlice,"posInSubset: %d,%d\n",xP,yP);
-                    //logtrace(LogSlice,"prevCsbf: %d\n",prevCsbf);
-
-                    switch (prevCsbf) {
-                    case 0:
-                      sigCtx = (xP+yP>=3) ? 0 : (xP+yP>0) ? 1 : 2;
-                      break;
-                    case 1:
-                      sigCtx = (yP==0) ? 2 : (yP==1) ? 1 : 0;
-                      break;
-                    case 2:
-                      sigCtx = (xP==0) ? 2 : (xP==1) ? 1 : 0;
-                      break;
-                    default:
-                      sigCtx = 2;
-                      break;
-                    }
-
-                    //logtrace(LogSlice,"a) sigCtx=%d\n",sigCtx);
-
-                    if (cIdx==0) {
-                      if (xS+yS > 0) sigCtx+=3;
-
-                      //logtrace(LogSlice,"b) sigCtx=%d\n",sigCtx);
-
-                      // if log2TrafoSize==3
-                      if (sbWidth==2) { // 8x8 block
-                        sigCtx += (scanIdx==0) ? 9 : 15;
-                      } else {
-                        sigCtx += 21;
-                      }
-
-                      //logtrace(LogSlice,"c) sigCtx=%d\n",sigCtx);
-                    }
-                    else {
-                      // if log2TrafoSize==3
-                      if (sbWidth==2) { // 8x8 block
-                        sigCtx+=9;
-                      }
-                      else {
-                        sigCtx+=12;
-                      }
-                    }
-
-                  }
-
-                  int ctxIdxInc;
-                  if (cIdx==0) { ctxIdxInc=sigCtx; }
-                  else         { ctxIdxInc=27+sigCtx; }
-
-                  if (ctxIdxLookup[log2w-2][cIdx][scanIdx][prevCsbf][xC+(yC<<log2w)] != 0xFF) {
-                    assert(ctxIdxLookup[log2w-2][cIdx][scanIdx][prevCsbf][xC+(yC<<log2w)] == ctxIdxInc);
-                  }
-
-                  ctxIdxLookup[log2w-2][cIdx][scanIdx][prevCsbf][xC+(yC<<log2w)] = ctxIdxInc;
-
-                  //NOTE: when using this option, we have to include all three scanIdx in the table
-                  //ctxIdxLookup[log2w-2][cIdx][scanIdx][prevCsbf][s] = ctxIdxInc;
-                }
-          }
-
-  return true;
-}
 
-
-bool alloc_and_init_significant_coeff_ctxIdx_lookupTable_OLD()
+static inline int sig_coeff_ctx_offset(int log2TrafoSize, int cIdx, int scanIdx, int xS, int yS)
 {
-  int tableSize = 2*2*4*(4*4 + 8*8 + 16*16 + 32*32);
-  uint8_t* p = (uint8_t*)malloc(tableSize);
-  if (p==NULL) {
-    return false;
+  if (log2TrafoSize==2) {
+    return cIdx ? 27 : 0;
   }
 
-  for (int log2w=2; log2w<=5 ; log2w++)
-    for (int cIdx=0;cIdx<2;cIdx++)
-      for (int scanIdx=0;scanIdx<2;scanIdx++)
-        for (int prevCsbf=0;prevCsbf<4;prevCsbf++)
-          {
-            // assign pointer into reserved memory area
-
-            ctxIdxLookup[log2w-2][cIdx][scanIdx][prevCsbf] = p;
-            p += (1<<log2w)*(1<<log2w);
-
-            const position* ScanOrderSub = get_scan_order(log2w-2, scanIdx);
-            const position* ScanOrderPos = get_scan_order(2, scanIdx);
-
-            //for (int yC=0;yC<(1<<log2w);yC++)
-            // for (int xC=0;xC<(1<<log2w);xC++)
-            for (int s=0;s<(1<<log2w)*(1<<log2w);s++)
-              {
-                position S = ScanOrderSub[s>>4];
-                int x0 = S.x<<2;
-                int y0 = S.y<<2;
-
-                int subX = ScanOrderPos[s & 0xF].x;
-                int subY = ScanOrderPos[s & 0xF].y;
-                int xC = x0 + subX;
-                int yC = y0 + subY;
-
-
-                int w = 1<<log2w;
-                int sbWidth = w>>2;
-
-                int sigCtx;
-
-                // if log2TrafoSize==2
-                if (sbWidth==1) {
-                  sigCtx = ctxIdxMap[(yC<<2) + xC];
-                }
-                else if (xC+yC==0) {
-                  sigCtx = 0;
-                }
-                else {
-                  int xS = xC>>2;
-                  int yS = yC>>2;
-                  /*
-                    int prevCsbf = 0;
-
-                    if (xS < sbWidth-1) { prevCsbf += coded_sub_block_flag[xS+1  +yS*sbWidth];    }
-                    if (yS < sbWidth-1) { prevCsbf += coded_sub_block_flag[xS+(1+yS)*sbWidth]<<1; }
-                  */
-                  int xP = xC & 3;
-                  int yP = yC & 3;
-
-                  logtrace(LogSlice,"posInSubset: %d,%d\n",xP,yP);
-                  logtrace(LogSlice,"prevCsbf: %d\n",prevCsbf);
-
-                  //printf("%d | %d %d\n",prevCsbf,xP,yP);
-
-                  switch (prevCsbf) {
-                  case 0:
-                    //sigCtx = (xP+yP==0) ? 2 : (xP+yP<3) ? 1 : 0;
-                    sigCtx = (xP+yP>=3) ? 0 : (xP+yP>0) ? 1 : 2;
-                    break;
-                  case 1:
-                    sigCtx = (yP==0) ? 2 : (yP==1) ? 1 : 0;
-                    break;
-                  case 2:
-                    sigCtx = (xP==0) ? 2 : (xP==1) ? 1 : 0;
-                    break;
-                  default:
-                    sigCtx = 2;
-                    break;
-                  }
-
-                  logtrace(LogSlice,"a) sigCtx=%d\n",sigCtx);
-
-                  if (cIdx==0) {
-                    if (xS+yS > 0) sigCtx+=3;
-
-                    logtrace(LogSlice,"b) sigCtx=%d\n",sigCtx);
-
-                    // if log2TrafoSize==3
-                    if (sbWidth==2) { // 8x8 block
-                      sigCtx += (scanIdx==0) ? 9 : 15;
-                    } else {
-                      sigCtx += 21;
-                    }
-
-                    logtrace(LogSlice,"c) sigCtx=%d\n",sigCtx);
-                  }
-                  else {
-                    // if log2TrafoSize==3
-                    if (sbWidth==2) { // 8x8 block
-                      sigCtx+=9;
-                    }
-                    else {
-                      sigCtx+=12;
-                    }
-                  }
-                }
-
-                int ctxIdxInc;
-                if (cIdx==0) { ctxIdxInc=sigCtx; }
-                else         { ctxIdxInc=27+sigCtx; }
-
-
-                ctxIdxLookup[log2w-2][cIdx][scanIdx][prevCsbf][xC+(yC<<log2w)] = ctxIdxInc;
-
-                //NOTE: when using this option, we have to include all three scanIdx in the table
-                //ctxIdxLookup[log2w-2][cIdx][scanIdx][prevCsbf][s] = ctxIdxInc;
-              }
-          }
-
-  return true;
-}
-
-void free_significant_coeff_ctxIdx_lookupTable()
-{
-  free(ctxIdxLookup[0][0][0][0]);
-  ctxIdxLookup[0][0][0][0]=NULL;
-}
-
-
-
-
-#if 0
-static int decode_significant_coeff_flag(thread_context* tctx,
-					 int xC,int yC,
-					 const uint8_t* coded_sub_block_flag,
-					 int sbWidth,
-					 int cIdx,
-					 int scanIdx)
-{
-  logtrace(LogSlice,"# significant_coeff_flag (xC:%d yC:%d sbWidth:%d cIdx:%d scanIdx:%d)\n",
-           xC,yC,sbWidth,cIdx,scanIdx);
+  if (cIdx==0) {
+    int offset = (xS+yS > 0) ? 3 : 0;
 
-  int sigCtx;
+    if (log2TrafoSize==3) { offset += (scanIdx==0) ? 9 : 15; } // 8x8 block
+    else                  { offset += 21; }
 
-  // if log2TrafoSize==2
-  if (sbWidth==1) {
-    sigCtx = ctxIdxMap[(yC<<2) + xC];
-  }
-  else if (xC+yC==0) {
-    sigCtx = 0;
+    return offset;
   }
   else {
-    int xS = xC>>2;
-    int yS = yC>>2;
-    int prevCsbf = 0;
-    if (xS < sbWidth-1) { prevCsbf += coded_sub_block_flag[xS+1  +yS*sbWidth];    }
-    if (yS < sbWidth-1) { prevCsbf += coded_sub_block_flag[xS+(1+yS)*sbWidth]<<1; }
-
-    int xP = xC & 3;
-    int yP = yC & 3;
-
-    logtrace(LogSlice,"posInSubset: %d,%d\n",xP,yP);
-    logtrace(LogSlice,"prevCsbf: %d\n",prevCsbf);
-
-    //printf("%d | %d %d\n",prevCsbf,xP,yP);
-
-    switch (prevCsbf) {
-    case 0:
-      //sigCtx = (xP+yP==0) ? 2 : (xP+yP<3) ? 1 : 0;
-      sigCtx = (xP+yP>=3) ? 0 : (xP+yP>0) ? 1 : 2;
-      break;
-    case 1:
-      sigCtx = (yP==0) ? 2 : (yP==1) ? 1 : 0;
-      break;
-    case 2:
-      sigCtx = (xP==0) ? 2 : (xP==1) ? 1 : 0;
-      break;
-    default:
-      sigCtx = 2;
-      break;
-    }
-
-    logtrace(LogSlice,"a) sigCtx=%d\n",sigCtx);
-
-    if (cIdx==0) {
-      if (xS+yS > 0) sigCtx+=3;
-
-      logtrace(LogSlice,"b) sigCtx=%d\n",sigCtx);
-
-      // if log2TrafoSize==3
-      if (sbWidth==2) {
-        sigCtx += (scanIdx==0) ? 9 : 15;
-      } else {
-        sigCtx += 21;
-      }
-
-      logtrace(LogSlice,"c) sigCtx=%d\n",sigCtx);
-    }
-    else {
-      // if log2TrafoSize==3
-      if (sbWidth==2) {
-        sigCtx+=9;
-      }
-      else {
-        sigCtx+=12;
-      }
-    }
+    return 27 + ((log2TrafoSize==3) ? 9 : 12);
   }
-
-  int ctxIdxInc;
-  if (cIdx==0) { ctxIdxInc=sigCtx; }
-  else         { ctxIdxInc=27+sigCtx; }
-
-  int context = tctx->shdr->initType*42 + ctxIdxInc;
-  logtrace(LogSlice,"context: %d\n",context);
-
-  int bit = decode_CABAC_bit(&tctx->cabac_decoder,
-                             &tctx->ctx_model[CONTEXT_MODEL_SIGNIFICANT_COEFF_FLAG + context]);
-  return bit;
 }
-#endif
-
 
 
 static inline int decode_significant_coeff_flag_lookup(thread_context* tctx,
@@ -2161,7 +1813,7 @@ void read_sao(thread_context* tctx, int xCtb,int yCtb,
 
         if (SaoTypeIdx != 0) {
           for (int i=0;i<4;i++) {
-            saoinfo.saoOffsetVal[cIdx][i] = decode_sao_offset_abs(tctx);
+            saoinfo.saoOffsetVal[cIdx][i] = decode_sao_offset_abs(tctx, tctx->img->get_bit_depth(cIdx));
             logtrace(LogSlice,"saoOffsetVal[%d][%d] = %d\n",cIdx,i, saoinfo.saoOffsetVal[cIdx][i]);
           }
 
@@ -2505,9 +2157,12 @@ int residual_coding(thread_context* tctx,
       int x0 = S.x<<2;
       int y0 = S.y<<2;
 
-      int log2w = log2TrafoSize-2;
       int prevCsbf = coded_sub_block_neighbors[S.x+S.y*sbWidth];
-      uint8_t* ctxIdxMap = ctxIdxLookup[log2w][!!cIdx][!!scanIdx][prevCsbf];
+      const uint8_t* sigCtxMap = sigCtx_lookup[log2TrafoSize==2 ? 4 : prevCsbf];
+      int ctxIdxOffset = sig_coeff_ctx_offset(log2TrafoSize, cIdx, scanIdx, S.x, S.y);
+
+      // the DC coefficient of the first sub-block has its own context (sigCtx=0)
+      int dcCtxIdxInc = (i==0) ? (cIdx ? 27 : 0) : sigCtxMap[0] + ctxIdxOffset;
 
 
       // set the last coded coefficient in the last subblock
@@ -2534,8 +2189,7 @@ int residual_coding(thread_context* tctx,
         // for all AC coefficients in sub-block, a significant_coeff flag is coded
 
         int significant_coeff = decode_significant_coeff_flag_lookup(tctx,
-                                                                     ctxIdxMap[xC+(yC<<log2TrafoSize)]);
-                                                                     //ctxIdxMap[(i<<4)+n]);
+                                                                     sigCtxMap[subX+(subY<<2)] + ctxIdxOffset);
 
         if (significant_coeff) {
           coeff_value[nCoefficients] = 1;
@@ -2556,9 +2210,7 @@ int residual_coding(thread_context* tctx,
         {
           if (inferSbDcSigCoeffFlag==0) {
             // if we cannot infert the DC coefficient, it is coded
-            int significant_coeff = decode_significant_coeff_flag_lookup(tctx,
-                                                                         ctxIdxMap[x0+(y0<<log2TrafoSize)]);
-                                                                         //ctxIdxMap[(i<<4)+0]);
+            int significant_coeff = decode_significant_coeff_flag_lookup(tctx, dcCtxIdxInc);
 
 
             if (significant_coeff) {
@@ -2808,6 +2460,40 @@ int read_transform_unit(thread_context* tctx,
 }
 
 
+/* With decoupled reconstruction, the prediction and residual operations are only
+   recorded while parsing and executed later by the reconstruction task.
+ */
+static inline void intra_prediction_TB(thread_context* tctx, int xB0,int yB0,
+                                       enum IntraPredMode mode, int nT, int cIdx)
+{
+  if (tctx->decctx->param_parse_only) {
+    return;
+  }
+
+  if (tctx->syntax_buffer) {
+    tctx->syntax_buffer->add_intra_prediction(xB0,yB0, mode, nT, cIdx);
+  }
+  else {
+    decode_intra_prediction(tctx->img, xB0,yB0, mode, nT, cIdx);
+  }
+}
+
+static inline void residual_TB(thread_context* tctx, int xT,int yT, int x0,int y0,
+                               int nT, int cIdx, bool transform_skip_flag, bool intra)
+{
+  if (tctx->decctx->param_parse_only) {
+    return;
+  }
+
+  if (tctx->syntax_buffer) {
+    tctx->syntax_buffer->add_residual(tctx, xT,yT, x0,y0, nT, cIdx, transform_skip_flag, intra);
+  }
+  else {
+    scale_coefficients(tctx, xT,yT, x0,y0, nT, cIdx, transform_skip_flag, intra);
+  }
+}
+
+
 void read_transform_tree(thread_context* tctx,
                          int x0, int y0,        // position of TU in frame
                          int xBase, int yBase,  // position of parent TU in frame
@@ -2934,45 +2620,45 @@ void read_transform_tree(thread_context* tctx,
       {
         enum IntraPredMode intraPredMode = img->get_IntraPredMode(x0,y0);
 
-        decode_intra_prediction(img, x0,y0, intraPredMode, nT, 0);
+        intra_prediction_TB(tctx, x0,y0, intraPredMode, nT, 0);
 
         enum IntraPredMode chromaPredMode = tctx->IntraPredModeC;
 
         if (nT>=8) {
-          decode_intra_prediction(img, x0/2,y0/2, chromaPredMode, nT/2, 1);
-          decode_intra_prediction(img, x0/2,y0/2, chromaPredMode, nT/2, 2);
+          intra_prediction_TB(tctx, x0/2,y0/2, chromaPredMode, nT/2, 1);
+          intra_prediction_TB(tctx, x0/2,y0/2, chromaPredMode, nT/2, 2);
         }
         else if (blkIdx==3) {
-          decode_intra_prediction(img, xBase/2,yBase/2, chromaPredMode, nT, 1);
-          decode_intra_prediction(img, xBase/2,yBase/2, chromaPredMode, nT, 2);
+          intra_prediction_TB(tctx, xBase/2,yBase/2, chromaPredMode, nT, 1);
+          intra_prediction_TB(tctx, xBase/2,yBase/2, chromaPredMode, nT, 2);
         }
       }
 
     // NOTE: disable MC-mode residuals:
     { //if (cuPredMode == MODE_INTRA) {
       if (cbf_luma) {
-        scale_coefficients(tctx, x0,y0, xCUBase,yCUBase, nT, 0,
-                           tctx->transform_skip_flag[0], PredMode==MODE_INTRA);
+        residual_TB(tctx, x0,y0, xCUBase,yCUBase, nT, 0,
+                    tctx->transform_skip_flag[0], PredMode==MODE_INTRA);
       }
 
       if (nT>=8) {
         if (cbf_cb) {
-          scale_coefficients(tctx, x0/2,y0/2, xCUBase/2,yCUBase/2, nT/2, 1,
-                             tctx->transform_skip_flag[1], PredMode==MODE_INTRA);
+          residual_TB(tctx, x0/2,y0/2, xCUBase/2,yCUBase/2, nT/2, 1,
+                      tctx->transform_skip_flag[1], PredMode==MODE_INTRA);
         }
         if (cbf_cr) {
-          scale_coefficients(tctx, x0/2,y0/2, xCUBase/2,yCUBase/2, nT/2, 2,
-                             tctx->transform_skip_flag[2], PredMode==MODE_INTRA);
+          residual_TB(tctx, x0/2,y0/2, xCUBase/2,yCUBase/2, nT/2, 2,
+                      tctx->transform_skip_flag[2], PredMode==MODE_INTRA);
         }
       }
       else if (blkIdx==3) {
         if (cbf_cb) {
-          scale_coefficients(tctx, xBase/2,yBase/2, xCUBase/2,yCUBase/2, nT, 1,
-                             tctx->transform_skip_flag[1], PredMode==MODE_INTRA);
+          residual_TB(tctx, xBase/2,yBase/2, xCUBase/2,yCUBase/2, nT, 1,
+                      tctx->transform_skip_flag[1], PredMode==MODE_INTRA);
         }
         if (cbf_cr) {
-          scale_coefficients(tctx, xBase/2,yBase/2, xCUBase/2,yCUBase/2, nT, 2,
-                             tctx->transform_skip_flag[2], PredMode==MODE_INTRA);
+          residual_TB(tctx, xBase/2,yBase/2, xCUBase/2,yCUBase/2, nT, 2,
+                      tctx->transform_skip_flag[2], PredMode==MODE_INTRA);
         }
       }
     }
@@ -3165,6 +2851,19 @@ void read_prediction_unit(thread_context* tctx,
 
 
 
+template <class pixel_t>
+static void read_pcm_samples_internal(bitreader* br, pixel_t* ptr, int stride,
+                                      int w, int nBits, int shift)
+{
+  for (int y=0;y<w;y++)
+    for (int x=0;x<w;x++)
+      {
+        int value = get_bits(br, nBits);
+        ptr[y*stride+x] = value << shift;
+      }
+}
+
+
 static void read_pcm_samples(thread_context* tctx, int x0, int y0, int log2CbSize)
 {
   bitreader br;
@@ -3173,7 +2872,8 @@ static void read_pcm_samples(thread_context* tctx, int x0, int y0, int log2CbSiz
   br.nextbits = 0;
   br.nextbits_cnt = 0;
 
-  const seq_parameter_set* sps = &tctx->img->sps;
+  de265_image* img = tctx->img;
+  const seq_parameter_set* sps = &img->sps;
   //fprintf(stderr,"PCM pos: %d %d (POC=%d)\n",x0,y0,tctx->decctx->img->PicOrderCntVal);
 
   int nBitsY = sps->pcm_sample_bit_depth_luma;
@@ -3182,44 +2882,25 @@ static void read_pcm_samples(thread_context* tctx, int x0, int y0, int log2CbSiz
   int wY = 1<<log2CbSize;
   int wC = 1<<(log2CbSize-1);
 
-  uint8_t* yPtr;
-  uint8_t* cbPtr;
-  uint8_t* crPtr;
-  int stride;
-  int chroma_stride;
-  yPtr  = tctx->img->get_image_plane(0);
-  cbPtr = tctx->img->get_image_plane(1);
-  crPtr = tctx->img->get_image_plane(2);
-  stride = tctx->img->get_image_stride(0);
-  chroma_stride = tctx->img->get_image_stride(1);
-
-  yPtr  = &yPtr [y0*stride + x0];
-  cbPtr = &cbPtr[y0/2*chroma_stride + x0/2];
-  crPtr = &crPtr[y0/2*chroma_stride + x0/2];
-
   int shiftY = sps->BitDepth_Y - nBitsY;
   int shiftC = sps->BitDepth_C - nBitsC;
 
-  for (int y=0;y<wY;y++)
-    for (int x=0;x<wY;x++)
-      {
-        int value = get_bits(&br, nBitsY);
-        yPtr[y*stride+x] = value << shiftY;
-      }
-
-  for (int y=0;y<wC;y++)
-    for (int x=0;x<wC;x++)
-      {
-        int value = get_bits(&br, nBitsC);
-        cbPtr[y*chroma_stride+x] = value << shiftC;
-      }
+  for (int cIdx=0;cIdx<3;cIdx++) {
+    int x = (cIdx==0 ? x0 : x0/2);
+    int y = (cIdx==0 ? y0 : y0/2);
+    int w     = (cIdx==0 ? wY : wC);
+    int nBits = (cIdx==0 ? nBitsY : nBitsC);
+    int shift = (cIdx==0 ? shiftY : shiftC);
 
-  for (int y=0;y<wC;y++)
-    for (int x=0;x<wC;x++)
-      {
-        int value = get_bits(&br, nBitsC);
-        crPtr[y*chroma_stride+x] = value << shiftC;
-      }
+    if (img->high_bit_depth(cIdx)) {
+      read_pcm_samples_internal(&br, (uint16_t*)img->get_image_plane_at_pos(cIdx,x,y),
+                                img->get_image_stride(cIdx), w, nBits, shift);
+    }
+    else {
+      read_pcm_samples_internal(&br, img->get_image_plane_at_pos(cIdx,x,y),
+                                img->get_image_stride(cIdx), w, nBits, shift);
+    }
+  }
 
   prepare_for_CABAC(&br);
   tctx->cabac_decoder.bitstream_curr = br.data;
@@ -3582,6 +3263,12 @@ void read_coding_unit(thread_context* tctx,
       }
     } // !pcm
   }
+
+  // mark deblocking edges and derive their bS while the CU is still in the cache
+
+  if (!tctx->decctx->param_disable_deblocking && !tctx->decctx->param_parse_only) {
+    derive_deblocking_CU(img, shdr, x0,y0, log2CbSize);
+  }
 }
 
 
@@ -3661,6 +3348,146 @@ enum DecodeResult {
   Decode_Error
 };
 
+// --- CTB statistics ---
+
+// position in the CABAC bitstream, up to a constant offset
+static inline int CABAC_bit_position(const CABAC_decoder* decoder)
+{
+  return (decoder->bitstream_curr - decoder->bitstream_start)*8 + decoder->bits_needed;
+}
+
+#define MAX_CBS_PER_CTB ((64/8)*(64/8))
+#define MAX_PBS_PER_CTB (MAX_CBS_PER_CTB*2) // 8x8 CBs have at most two PBs
+
+struct ctb_statistics_collector
+{
+  const de265_image* img;
+
+  de265_cb_statistics cbs[MAX_CBS_PER_CTB];
+  de265_pb_statistics pbs[MAX_PBS_PER_CTB];
+  int nCBs, nPBs;
+
+  void add_PB(int x,int y, int w,int h)
+  {
+    const PredVectorInfo* mvi = img->get_mv_info(x,y);
+
+    de265_pb_statistics& pb = pbs[nPBs++];
+    pb.x = x;
+    pb.y = y;
+    pb.width  = w;
+    pb.height = h;
+
+    for (int l=0;l<2;l++) {
+      pb.refIdx[l] = mvi->predFlag[l] ? mvi->refIdx[l] : -1;
+      pb.mv[l][0]  = mvi->predFlag[l] ? mvi->mv[l].x : 0;
+      pb.mv[l][1]  = mvi->predFlag[l] ? mvi->mv[l].y : 0;
+    }
+  }
+
+  // walk the coding quadtree in decoding order, using the CB sizes stored in the metadata
+  void add_CBs(int x0,int y0, int log2Size)
+  {
+    const seq_parameter_set* sps = &img->sps;
+
+    if (x0 >= sps->pic_width_in_luma_samples ||
+        y0 >= sps->pic_height_in_luma_samples) {
+      return;
+    }
+
+    int log2CbSize = img->get_log2CbSize(x0,y0);
+    if (log2CbSize < log2Size && log2Size > sps->Log2MinCbSizeY) {
+      int half = 1<<(log2Size-1);
+      add_CBs(x0     ,y0     , log2Size-1);
+      add_CBs(x0+half,y0     , log2Size-1);
+      add_CBs(x0     ,y0+half, log2Size-1);
+      add_CBs(x0+half,y0+half, log2Size-1);
+      return;
+    }
+
+    enum PredMode predMode = img->get_pred_mode(x0,y0);
+    enum PartMode partMode = img->get_PartMode(x0,y0);
+
+    de265_cb_statistics& cb = cbs[nCBs++];
+    cb.x = x0;
+    cb.y = y0;
+    cb.log2_size = log2Size;
+    cb.pred_mode = predMode;
+    cb.part_mode = partMode;
+    cb.intra_pred_mode = (predMode==MODE_INTRA) ? img->get_IntraPredMode(x0,y0) : 0;
+    cb.QP_Y = img->get_QPY(x0,y0);
+
+    if (predMode==MODE_INTRA) {
+      return;
+    }
+
+    // prediction blocks as in read_coding_unit()
+
+    const int n = 1<<log2Size;
+
+    switch (partMode) {
+    case PART_2Nx2N:
+      add_PB(x0,y0, n,n);
+      break;
+    case PART_2NxN:
+      add_PB(x0,y0    , n,n/2);
+      add_PB(x0,y0+n/2, n,n/2);
+      break;
+    case PART_Nx2N:
+      add_PB(x0    ,y0, n/2,n);
+      add_PB(x0+n/2,y0, n/2,n);
+      break;
+    case PART_2NxnU:
+      add_PB(x0,y0    , n,n/4);
+      add_PB(x0,y0+n/4, n,n*3/4);
+      break;
+    case PART_2NxnD:
+      add_PB(x0,y0      , n,n*3/4);
+      add_PB(x0,y0+n*3/4, n,n/4);
+      break;
+    case PART_nLx2N:
+      add_PB(x0    ,y0, n/4,n);
+      add_PB(x0+n/4,y0, n*3/4,n);
+      break;
+    case PART_nRx2N:
+      add_PB(x0      ,y0, n*3/4,n);
+      add_PB(x0+n*3/4,y0, n/4,n);
+      break;
+    case PART_NxN:
+      add_PB(x0    ,y0    , n/2,n/2);
+      add_PB(x0+n/2,y0    , n/2,n/2);
+      add_PB(x0    ,y0+n/2, n/2,n/2);
+      add_PB(x0+n/2,y0+n/2, n/2,n/2);
+      break;
+    }
+  }
+};
+
+
+static void send_ctb_statistics(thread_context* tctx, int ctbx,int ctby, int bits)
+{
+  const seq_parameter_set* sps = &tctx->img->sps;
+
+  ctb_statistics_collector collector;
+  collector.img  = tctx->img;
+  collector.nCBs = 0;
+  collector.nPBs = 0;
+  collector.add_CBs(ctbx << sps->Log2CtbSizeY, ctby << sps->Log2CtbSizeY, sps->Log2CtbSizeY);
+
+  de265_ctb_statistics stat;
+  stat.POC = tctx->img->PicOrderCntVal;
+  stat.x = ctbx << sps->Log2CtbSizeY;
+  stat.y = ctby << sps->Log2CtbSizeY;
+  stat.bits = bits;
+  stat.num_cbs = collector.nCBs;
+  stat.cbs = collector.cbs;
+  stat.num_pbs = collector.nPBs;
+  stat.pbs = collector.pbs;
+
+  decoder_context* ctx = tctx->decctx;
+  ctx->param_ctb_statistics_callback(ctx->param_ctb_statistics_userdata, &stat);
+}
+
+
 /* Decode CTBs until the end of sub-stream, the end-of-slice, or some error occurs.
  */
 enum DecodeResult decode_substream(thread_context* tctx,
@@ -3712,8 +3539,19 @@ enum DecodeResult decode_substream(thread_context* tctx,
 
     // read and decode CTB
 
+    if (tctx->pipeline) {
+      tctx->syntax_buffer = tctx->pipeline->begin_CTB(ctbx+ctby*ctbW, tctx->shdr);
+    }
+
+    int bitPosition = CABAC_bit_position(&tctx->cabac_decoder);
+
     read_coding_tree_unit(tctx);
 
+    if (tctx->decctx->param_ctb_statistics_callback) {
+      send_ctb_statistics(tctx, ctbx,ctby,
+                          CABAC_bit_position(&tctx->cabac_decoder) - bitPosition);
+    }
+
 
     // save CABAC-model for WPP (except in last CTB row)
 
@@ -3744,7 +3582,14 @@ enum DecodeResult decode_substream(thread_context* tctx,
       }
     }
 
-    tctx->img->ctb_progress[ctbx+ctby*ctbW].set_progress(CTB_PROGRESS_PREFILTER);
+    if (tctx->pipeline) {
+      // the reconstruction task sets the CTB progress when it has finished this CTB
+      tctx->pipeline->end_CTB();
+      tctx->syntax_buffer = NULL;
+    }
+    else {
+      tctx->img->ctb_progress[ctbx+ctby*ctbW].set_progress(CTB_PROGRESS_PREFILTER);
+    }
 
     //printf("%p: decoded %d|%d\n",tctx, ctby,ctbx);
 
@@ -3805,8 +3650,6 @@ void initialize_CABAC_at_slice_segment_start(thread_context* tctx)
   if (shdr->dependent_slice_segment_flag) {
     int prevCtb = pps->CtbAddrTStoRS[ pps->CtbAddrRStoTS[shdr->slice_segment_address] -1 ];
 
-    slice_segment_header* prevCtbHdr = img->slices[ img->get_SliceHeaderIndex_atIndex(prevCtb) ];
-
     if (pps->is_tile_start_CTB(shdr->slice_segment_address % sps->PicWidthInCtbsY,
                                shdr->slice_segment_address / sps->PicWidthInCtbsY
                                )) {
@@ -3815,6 +3658,9 @@ void initialize_CABAC_at_slice_segment_start(thread_context* tctx)
     else {
       tctx->img->wait_for_progress(tctx->task, prevCtb, CTB_PROGRESS_PREFILTER);
 
+      // the slice header index of 'prevCtb' is only valid after it has been decoded
+      slice_segment_header* prevCtbHdr = img->slices[ img->get_SliceHeaderIndex_atIndex(prevCtb) ];
+
       memcpy(tctx->ctx_model,
              prevCtbHdr->ctx_model_storage,
              CONTEXT_MODEL_TABLE_LENGTH * sizeof(context_model));
@@ -3826,6 +3672,34 @@ void initialize_CABAC_at_slice_segment_start(thread_context* tctx)
 }
 
 
+void thread_task_slice_segment::describe(task_trace_event* ev) const
+{
+  const de265_image* img = tctx->img;
+  int ctbAddrRS = img->pps.CtbAddrTStoRS[tctx->CtbAddrInTS];
+
+  if (img->pps.tiles_enabled_flag) {
+    ev->name  = "tile";
+    ev->index = img->pps.TileIdRS[ctbAddrRS];
+  }
+  else {
+    ev->name  = "slice segment";
+    ev->index = ctbAddrRS;
+  }
+
+  ev->POC = img->PicOrderCntVal;
+}
+
+
+void thread_task_ctb_row::describe(task_trace_event* ev) const
+{
+  const de265_image* img = tctx->img;
+
+  ev->name  = "CTB row";
+  ev->index = img->pps.CtbAddrTStoRS[tctx->CtbAddrInTS] / img->sps.PicWidthInCtbsY;
+  ev->POC   = img->PicOrderCntVal;
+}
+
+
 void thread_task_slice_segment::work()
 {
   struct thread_task_slice_segment* data = this;
@@ -3902,11 +3776,63 @@ void thread_task_ctb_row::work()
   }
 #endif
 
+  img->output_finished_rows();
+
   state = Finished;
   img->thread_finishes();
 }
 
 
+/* If the tile at the current position is outside of the region of interest, continue at
+   the entry point of the next tile in the slice segment that is not. 'substream' is the
+   index of the substream at the current position and is updated.
+   Returns false if the rest of the slice segment is skipped.
+ */
+static bool skip_tiles_outside_ROI(thread_context* tctx, int* substream)
+{
+  de265_image* img = tctx->img;
+  const pic_parameter_set* pps = &img->pps;
+  const seq_parameter_set* sps = &img->sps;
+  const slice_segment_header* shdr = tctx->shdr;
+  CABAC_decoder* decoder = &tctx->cabac_decoder;
+
+  int tileID = pps->TileId[tctx->CtbAddrInTS];
+
+  if (!tctx->decctx->is_tile_outside_ROI(img, tileID)) {
+    return true;
+  }
+
+  do {
+    img->mark_tile_skipped(tileID);
+
+    if (*substream >= shdr->num_entry_point_offsets) {
+      return false; // no more tiles in this slice segment
+    }
+
+    (*substream)++;
+    tileID++;
+  } while (tctx->decctx->is_tile_outside_ROI(img, tileID));
+
+  int offset = shdr->entry_point_offset[*substream-1];
+  if (offset < 0 || offset >= decoder->bitstream_end - decoder->bitstream_start) {
+    tctx->decctx->add_warning(DE265_WARNING_INCORRECT_ENTRY_POINT_OFFSET, true);
+    return false;
+  }
+
+  int ctbX = pps->colBd[tileID % pps->num_tile_columns];
+  int ctbY = pps->rowBd[tileID / pps->num_tile_columns];
+  tctx->CtbAddrInTS = pps->CtbAddrRStoTS[ctbY*sps->PicWidthInCtbsY + ctbX];
+  setCtbAddrFromTS(tctx);
+
+  decoder->bitstream_curr = decoder->bitstream_start + offset;
+
+  initialize_CABAC(tctx);
+  init_CABAC_decoder_2(decoder);
+
+  return true;
+}
+
+
 de265_error read_slice_segment_data(thread_context* tctx)
 {
   setCtbAddrFromTS(tctx);
@@ -3916,15 +3842,25 @@ de265_error read_slice_segment_data(thread_context* tctx)
   const seq_parameter_set* sps = &img->sps;
   slice_segment_header* shdr = tctx->shdr;
 
-  initialize_CABAC_at_slice_segment_start(tctx);
+  int substream=0;
 
-  init_CABAC_decoder_2(&tctx->cabac_decoder);
+  // A slice segment starting inside of a skipped tile does not need the CABAC state of the
+  // preceding slice segment. Its decoding starts at the next tile that is not skipped.
 
-  // printf("-----\n");
+  if (tctx->decctx->is_tile_outside_ROI(img, pps->TileId[tctx->CtbAddrInTS])) {
+    if (!skip_tiles_outside_ROI(tctx, &substream)) {
+      return DE265_OK;
+    }
+  }
+  else {
+    initialize_CABAC_at_slice_segment_start(tctx);
 
-  bool first_slice_substream = !shdr->dependent_slice_segment_flag;
+    init_CABAC_decoder_2(&tctx->cabac_decoder);
+  }
 
-  int substream=0;
+  // printf("-----\n");
+
+  bool first_slice_substream = !shdr->dependent_slice_segment_flag && substream==0;
 
   enum DecodeResult result;
   do {
@@ -3956,6 +3892,10 @@ de265_error read_slice_segment_data(thread_context* tctx)
 
     if (pps->tiles_enabled_flag) {
       initialize_CABAC(tctx);
+
+      if (!skip_tiles_outside_ROI(tctx, &substream)) {
+        break;
+      }
     }
   } while (true);
 
@@ -263,9 +263,6 @@ typedef struct {
 
 de265_error read_slice_segment_data(struct thread_context* tctx);
 
-bool alloc_and_init_significant_coeff_ctxIdx_lookupTable();
-void free_significant_coeff_ctxIdx_lookupTable();
-
 
 class thread_task_ctb_row : public thread_task
 {
@@ -274,6 +271,7 @@ public:
   struct thread_context* tctx;
 
   virtual void work();
+  virtual void describe(task_trace_event*) const;
 };
 
 class thread_task_slice_segment : public thread_task
@@ -283,6 +281,7 @@ public:
   struct thread_context* tctx;
 
   virtual void work();
+  virtual void describe(task_trace_event*) const;
 };
 
 #endif
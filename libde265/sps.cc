@@ -148,6 +148,12 @@ de265_error seq_parameter_set::read(decoder_context* ctx, bitreader* br)
   READ_VLC_OFFSET(bit_depth_luma,  uvlc, 8);
   READ_VLC_OFFSET(bit_depth_chroma,uvlc, 8);
 
+  // samples are stored in 16 bit and the MC intermediate values have 14 bit
+  if (bit_depth_luma > 12 || bit_depth_chroma > 12) {
+    ctx->add_warning(DE265_WARNING_SPS_HEADER_INVALID, false);
+    return DE265_ERROR_CODED_PARAMETER_OUT_OF_RANGE;
+  }
+
   READ_VLC_OFFSET(log2_max_pic_order_cnt_lsb, uvlc, 4);
   MaxPicOrderCntLsb = 1<<(log2_max_pic_order_cnt_lsb);
 
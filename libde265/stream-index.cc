@@ -0,0 +1,615 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stream-index.h"
+#include "slice.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+
+/* Slice segment headers are parsed from this number of bytes at the start of the
+   slice NAL. Only longer headers (e.g. with many entry points) need the whole NAL. */
+#define SLICE_HEADER_PREFIX_SIZE 256
+
+
+stream_index::stream_index()
+{
+  nalStart  = -1;
+  nalOffset = 0;
+  scanPos   = 0;
+  bufferOffset = 0;
+
+  first_picture = true;
+  FirstAfterEndOfSequenceNAL = false;
+  prevPicOrderCntLsb = 0;
+  prevPicOrderCntMsb = 0;
+
+  stream_POC_offset = 0;
+  max_stream_POC = 0;
+
+  access_unit_start = -1;
+}
+
+
+void stream_index::push_data(const unsigned char* data, int len)
+{
+  buffer.insert(buffer.end(), data, data+len);
+
+  const int n = buffer.size();
+
+  int i;
+  for (i=scanPos; i+2<n; i++) {
+    if (buffer[i+2]>1) {
+      i+=2; // no start code can begin at i, i+1 or i+2
+      continue;
+    }
+
+    if (buffer[i]!=0 || buffer[i+1]!=0 || buffer[i+2]!=1) {
+      continue;
+    }
+
+    // start code found -> the previous NAL ends here (without trailing zero bytes)
+
+    if (nalStart>=0) {
+      int end = i;
+      while (end>nalStart && buffer[end-1]==0) {
+        end--;
+      }
+
+      process_NAL(&buffer[nalStart], end-nalStart, nalOffset);
+    }
+
+    // include the zero_byte of a 4-byte start code
+
+    int startCode = (i>0 && buffer[i-1]==0) ? i-1 : i;
+
+    nalOffset = bufferOffset + startCode;
+    nalStart  = i+3;
+    i += 2;
+  }
+
+  scanPos = i;
+
+
+  // remove processed data
+
+  int keep = (nalStart>=0) ? nalStart : scanPos;
+  if (keep>0) {
+    buffer.erase(buffer.begin(), buffer.begin()+keep);
+    bufferOffset += keep;
+    scanPos -= keep;
+    if (nalStart>=0) { nalStart -= keep; }
+  }
+}
+
+
+void stream_index::flush_data()
+{
+  if (nalStart>=0) {
+    int end = buffer.size();
+    while (end>nalStart && buffer[end-1]==0) {
+      end--;
+    }
+
+    process_NAL(&buffer[0] + nalStart, end-nalStart, nalOffset);
+  }
+
+  bufferOffset += buffer.size();
+  buffer.clear();
+  nalStart = -1;
+  scanPos  = 0;
+
+  if (!pictures.empty()) {
+    pictures.back().size = bufferOffset - pictures.back().byte_offset;
+  }
+}
+
+
+void stream_index::process_NAL(const unsigned char* data, int len, int64_t offset)
+{
+  if (len<2) {
+    return;
+  }
+
+  int nal_unit_type = (data[0]>>1) & 0x3F;
+
+  // 7.4.2.4.4: these NALs start a new access unit when they follow the last VCL NAL
+
+  if (access_unit_start<0 &&
+      ((nal_unit_type >= NAL_UNIT_VPS_NUT && nal_unit_type <= NAL_UNIT_PREFIX_SEI_NUT &&
+        nal_unit_type != NAL_UNIT_EOS_NUT && nal_unit_type != NAL_UNIT_EOB_NUT &&
+        nal_unit_type != NAL_UNIT_FD_NUT) ||
+       (nal_unit_type >= 41 && nal_unit_type <= 44) ||
+       (nal_unit_type >= 48 && nal_unit_type <= 55))) {
+    access_unit_start = offset;
+  }
+
+  if (nal_unit_type == NAL_UNIT_EOS_NUT) {
+    FirstAfterEndOfSequenceNAL = true;
+    return;
+  }
+
+  if (nal_unit_type == NAL_UNIT_VPS_NUT ||
+      nal_unit_type == NAL_UNIT_SPS_NUT ||
+      nal_unit_type == NAL_UNIT_PPS_NUT) {
+    add_parameter_set(data, len);
+
+    // the NAL is passed on to the NAL parser's free list
+
+    NAL_unit* nal = new NAL_unit;
+    nal->set_data(data, len);
+    nal->remove_stuffing_bytes();
+
+    ctx.decode_NAL(nal);
+  }
+  else if (nal_unit_type < 32) {
+    if (access_unit_start<0) {
+      access_unit_start = offset;
+    }
+
+    process_slice(data, len, access_unit_start);
+
+    access_unit_start = -1;
+  }
+}
+
+
+/* Returns NAL type and ID of a VPS, SPS or PPS NAL as (type<<8) | ID, -1 if it cannot be read.
+ */
+static int parameter_set_key(const unsigned char* data, int len)
+{
+  NAL_unit nal;
+  nal.set_data(data, len);
+  nal.remove_stuffing_bytes();
+
+  bitreader reader;
+  bitreader_init(&reader, nal.data(), nal.size());
+
+  nal_header nal_hdr;
+  nal_read_header(&reader, &nal_hdr);
+
+  int id;
+  switch (nal_hdr.nal_unit_type) {
+  case NAL_UNIT_VPS_NUT:
+    id = get_bits(&reader,4);
+    break;
+
+  case NAL_UNIT_SPS_NUT:
+    {
+      get_bits(&reader,4); // sps_video_parameter_set_id
+      int max_sub_layers = get_bits(&reader,3) +1;
+      if (max_sub_layers>7) {
+        return -1;
+      }
+      get_bits(&reader,1); // sps_temporal_id_nesting_flag
+
+      profile_tier_level ptl;
+      read_profile_tier_level(&reader, &ptl, max_sub_layers);
+
+      id = get_uvlc(&reader);
+    }
+    break;
+
+  case NAL_UNIT_PPS_NUT:
+    id = get_uvlc(&reader);
+    break;
+
+  default:
+    return -1;
+  }
+
+  if (id<0) { // UVLC_ERROR
+    return -1;
+  }
+
+  return (nal_hdr.nal_unit_type<<8) | id;
+}
+
+
+void stream_index::add_parameter_set(const unsigned char* data, int len)
+{
+  size_t idx;
+  for (idx=0; idx<parameter_sets.size(); idx++) {
+    if (parameter_sets[idx].size()==(size_t)len &&
+        memcmp(&parameter_sets[idx][0], data, len)==0) {
+      break;
+    }
+  }
+
+  if (idx==parameter_sets.size()) {
+    parameter_sets.push_back(std::vector<unsigned char>(data, data+len));
+  }
+
+  // Replace the active set with the same type and ID (or the same data, if the ID cannot be read).
+  // The active list thus holds at most one set of each ID.
+
+  int key = parameter_set_key(data, len);
+
+  for (size_t i=0;i<active_parameter_sets.size();i++) {
+    int active = active_parameter_sets[i];
+    const std::vector<unsigned char>& active_data = parameter_sets[active];
+
+    if (active==(int)idx ||
+        (key>=0 && parameter_set_key(&active_data[0], active_data.size())==key)) {
+      active_parameter_sets.erase(active_parameter_sets.begin()+i);
+      break;
+    }
+  }
+
+  active_parameter_sets.push_back(idx);
+}
+
+
+bool stream_index::read_slice_header(const unsigned char* data, int len,
+                                     nal_header* nal_hdr, slice_segment_header* shdr,
+                                     bool* complete)
+{
+  slice_nal.clear();
+  slice_nal.set_data(data, len);
+  slice_nal.remove_stuffing_bytes();
+
+  bitreader reader;
+  bitreader_init(&reader, slice_nal.data(), slice_nal.size());
+
+  nal_read_header(&reader, nal_hdr);
+  ctx.process_nal_hdr(nal_hdr);
+
+  if (nal_hdr->nal_unit_type > NAL_UNIT_CRA_NUT) {
+    return false; // reserved
+  }
+
+  ctx.previous_slice_header = &previous_shdr;
+
+  bool continueDecoding = false;
+  de265_error err = shdr->read(&reader, &ctx, &continueDecoding);
+
+  ctx.previous_slice_header = NULL;
+
+  if (err != DE265_OK || !continueDecoding ||
+      !ctx.get_pps(shdr->slice_pic_parameter_set_id)->pps_read) {
+    return false;
+  }
+
+  // If all input was loaded into the bitreader, the header may have been cut off.
+
+  *complete = (reader.bytes_remaining > 0);
+
+  return true;
+}
+
+
+void stream_index::start_sequence(const seq_parameter_set* sps)
+{
+  de265_sequence_info seq;
+  seq.first_picture = pictures.size();
+  seq.num_pictures  = 0;
+  seq.width  = sps->pic_width_in_luma_samples -
+    (sps->conf_win_left_offset + sps->conf_win_right_offset) * sps->SubWidthC;
+  seq.height = sps->pic_height_in_luma_samples -
+    (sps->conf_win_top_offset + sps->conf_win_bottom_offset) * sps->SubHeightC;
+  seq.chroma_format    = sps->chroma_format_idc;
+  seq.bit_depth_luma   = sps->BitDepth_Y;
+  seq.bit_depth_chroma = sps->BitDepth_C;
+  seq.profile_idc = sps->profile_tier_level.general_profile_idc;
+  seq.tier_flag   = sps->profile_tier_level.general_tier_flag;
+  seq.level_idc   = sps->profile_tier_level.general_level_idc;
+
+  sequences.push_back(seq);
+}
+
+
+void stream_index::process_slice(const unsigned char* data, int len, int64_t offset)
+{
+  // parse only the start of the NAL, slice data is never touched
+
+  nal_header nal_hdr;
+  slice_segment_header shdr;
+  bool complete;
+
+  int prefix = std::min(len, SLICE_HEADER_PREFIX_SIZE);
+  bool success = read_slice_header(data, prefix, &nal_hdr, &shdr, &complete);
+
+  // A long header may be cut off by the prefix or fail to parse. Retry with the whole NAL.
+
+  if ((!success || !complete) && prefix<len) {
+    success = read_slice_header(data, len, &nal_hdr, &shdr, &complete);
+  }
+
+  if (!success) {
+    return;
+  }
+
+  previous_shdr = shdr;
+
+  const uint8_t type = nal_hdr.nal_unit_type;
+
+
+  // further slice segments of the current picture
+
+  if (!shdr.first_slice_segment_in_pic_flag) {
+    if (!pictures.empty()) {
+      de265_picture_info& pic = pictures.back();
+      pic.num_slice_segments++;
+      pic.slice_types |= 1<<shdr.slice_type;
+    }
+
+    return;
+  }
+
+  const pic_parameter_set* pps = ctx.get_pps(shdr.slice_pic_parameter_set_id);
+  const seq_parameter_set* sps = ctx.get_sps(pps->seq_parameter_set_id);
+
+
+  // 8.3.1 picture order count, as in decoder_context::process_picture_order_count()
+
+  bool NoRaslOutputFlag = (isIRAP(type) &&
+                           (isIDR(type) || isBLA(type) ||
+                            first_picture || FirstAfterEndOfSequenceNAL));
+
+  int lsb = shdr.slice_pic_order_cnt_lsb;
+  int msb;
+  if (NoRaslOutputFlag) {
+    msb = 0;
+  }
+  else {
+    msb = derive_PicOrderCntMsb(lsb, prevPicOrderCntLsb, prevPicOrderCntMsb,
+                                sps->MaxPicOrderCntLsb);
+  }
+
+  int POC = msb + lsb;
+
+  if (nal_hdr.nuh_temporal_id==0 &&
+      isReferenceNALU(type) &&
+      !isRASL(type) && !isRADL(type)) {
+    prevPicOrderCntLsb = lsb;
+    prevPicOrderCntMsb = msb;
+  }
+
+
+  // a new coded video sequence continues the stream POC after all previous pictures
+
+  if (NoRaslOutputFlag) {
+    stream_POC_offset = first_picture ? 0 : max_stream_POC+1 - POC;
+  }
+
+  int32_t stream_POC = POC + stream_POC_offset;
+
+  if (first_picture || stream_POC > max_stream_POC) {
+    max_stream_POC = stream_POC;
+  }
+
+  first_picture = false;
+  FirstAfterEndOfSequenceNAL = false;
+
+
+  if (NoRaslOutputFlag || sequences.empty()) {
+    start_sequence(sps);
+  }
+
+  if (!pictures.empty()) {
+    pictures.back().size = offset - pictures.back().byte_offset;
+  }
+
+  de265_picture_info pic;
+  pic.byte_offset = offset;
+  pic.size        = 0;
+  pic.POC         = POC;
+  pic.stream_POC  = stream_POC;
+  pic.sequence    = sequences.size()-1;
+  pic.num_slice_segments = 1;
+  pic.nal_unit_type   = type;
+  pic.temporal_id     = nal_hdr.nuh_temporal_id;
+  pic.slice_types     = 1<<shdr.slice_type;
+  pic.pic_output_flag = shdr.pic_output_flag;
+
+  pictures.push_back(pic);
+  sequences.back().num_pictures++;
+
+
+  if (isIRAP(type)) {
+    de265_index_entry entry;
+    entry.byte_offset = offset;
+    entry.POC = POC;
+    entry.stream_POC = stream_POC;
+    entry.nal_unit_type = type;
+
+    entries.push_back(entry);
+    entry_parameter_sets.push_back(active_parameter_sets);
+  }
+}
+
+
+void stream_index::seek(decoder_context* decctx, int idx, int32_t target_stream_POC) const
+{
+  decctx->seek(target_stream_POC - entries[idx].stream_POC);
+
+  const std::vector<int>& ps = entry_parameter_sets[idx];
+  for (size_t i=0;i<ps.size();i++) {
+    const std::vector<unsigned char>& data = parameter_sets[ps[i]];
+
+    NAL_unit* nal = new NAL_unit;
+    nal->set_data(&data[0], data.size());
+    nal->remove_stuffing_bytes();
+
+    decctx->decode_NAL(nal);
+  }
+}
+
+
+int stream_index::find_entry(int32_t stream_POC) const
+{
+  int idx = -1;
+
+  for (size_t i=0;i<entries.size();i++) {
+    if (entries[i].stream_POC > stream_POC) {
+      break;
+    }
+
+    idx = i;
+  }
+
+  return idx;
+}
+
+
+/* Index file format (text):
+     libde265-stream-index 1
+     P <hex bytes of parameter set NAL>      (one line per distinct parameter set)
+     E <byte offset> <NAL type> <POC> <stream POC> <N> <N parameter set numbers>
+ */
+static const char* index_file_header = "libde265-stream-index 1";
+
+bool stream_index::save(const char* filename) const
+{
+  FILE* fh = fopen(filename, "w");
+  if (fh==NULL) {
+    return false;
+  }
+
+  fprintf(fh, "%s\n", index_file_header);
+
+  for (size_t i=0;i<parameter_sets.size();i++) {
+    fprintf(fh, "P ");
+    for (size_t k=0;k<parameter_sets[i].size();k++) {
+      fprintf(fh, "%02x", parameter_sets[i][k]);
+    }
+    fprintf(fh, "\n");
+  }
+
+  for (size_t i=0;i<entries.size();i++) {
+    const de265_index_entry& e = entries[i];
+    const std::vector<int>& ps = entry_parameter_sets[i];
+
+    fprintf(fh, "E %lld %d %d %d %d", (long long)e.byte_offset,
+            e.nal_unit_type, e.POC, e.stream_POC, (int)ps.size());
+
+    for (size_t k=0;k<ps.size();k++) {
+      fprintf(fh, " %d", ps[k]);
+    }
+    fprintf(fh, "\n");
+  }
+
+  bool success = !ferror(fh);
+  fclose(fh);
+
+  return success;
+}
+
+
+static int hex_value(int c)
+{
+  if (c>='0' && c<='9') return c-'0';
+  if (c>='a' && c<='f') return c-'a'+10;
+  if (c>='A' && c<='F') return c-'A'+10;
+  return -1;
+}
+
+// read hex bytes up to the end of the line
+static bool read_hex_line(FILE* fh, std::vector<unsigned char>* data)
+{
+  int c;
+  while ((c=fgetc(fh)) == ' ') { }
+
+  while (c != '\n' && c != EOF) {
+    int hi = hex_value(c);
+    int lo = hex_value(fgetc(fh));
+    if (hi<0 || lo<0) {
+      return false;
+    }
+
+    data->push_back((hi<<4) | lo);
+    c = fgetc(fh);
+  }
+
+  return !data->empty();
+}
+
+
+bool stream_index::load(const char* filename)
+{
+  FILE* fh = fopen(filename, "r");
+  if (fh==NULL) {
+    return false;
+  }
+
+  char line[100];
+  if (fgets(line, sizeof(line), fh)==NULL ||
+      strncmp(line, index_file_header, strlen(index_file_header)) != 0) {
+    fclose(fh);
+    return false;
+  }
+
+  entries.clear();
+  entry_parameter_sets.clear();
+  parameter_sets.clear();
+
+  bool success = true;
+
+  char type[2];
+  while (success && fscanf(fh, "%1s", type) == 1) {
+    if (type[0]=='P') {
+      std::vector<unsigned char> data;
+      if (!read_hex_line(fh, &data)) {
+        success = false;
+        break;
+      }
+
+      parameter_sets.push_back(data);
+    }
+    else if (type[0]=='E') {
+      long long byte_offset;
+      int nal_type, POC, stream_POC, n;
+      if (fscanf(fh, "%lld %d %d %d %d", &byte_offset, &nal_type, &POC, &stream_POC, &n) != 5) {
+        success = false;
+        break;
+      }
+
+      de265_index_entry e;
+      e.byte_offset = byte_offset;
+      e.nal_unit_type = nal_type;
+      e.POC = POC;
+      e.stream_POC = stream_POC;
+
+      std::vector<int> ps;
+      for (int k=0;k<n;k++) {
+        int idx;
+        if (fscanf(fh, "%d", &idx) != 1 ||
+            idx<0 || idx>=(int)parameter_sets.size()) {
+          success = false;
+          break;
+        }
+
+        ps.push_back(idx);
+      }
+
+      entries.push_back(e);
+      entry_parameter_sets.push_back(ps);
+    }
+    else {
+      success = false;
+    }
+  }
+
+  fclose(fh);
+
+  return success;
+}
@@ -0,0 +1,101 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DE265_STREAM_INDEX_H
+#define DE265_STREAM_INDEX_H
+
+#include "libde265/de265.h"
+#include "libde265/decctx.h"
+
+#include <vector>
+
+
+/* Scans a bytestream for IRAP pictures without decoding slice data.
+   Only parameter sets and the first slice segment header of each picture are
+   parsed, which is needed to derive the POCs.
+   The parameter sets that are active at each IRAP are kept, such that decoding
+   can start at any IRAP even if the parameter sets are not repeated there.
+   Since all slice segment headers are read anyway, the index also lists every
+   picture and coded video sequence for probing streams.
+ */
+class stream_index
+{
+ public:
+  stream_index();
+
+  void push_data(const unsigned char* data, int len);
+  void flush_data(); // end of stream, process the last NAL
+
+  // returns index of the last IRAP with stream_POC <= POC, -1 if none
+  int find_entry(int32_t stream_POC) const;
+
+  // reset decoder and send it the parameter sets for decoding from entry 'idx'
+  void seek(decoder_context* decctx, int idx, int32_t target_stream_POC) const;
+
+  bool save(const char* filename) const;
+  bool load(const char* filename);
+
+  std::vector<de265_index_entry> entries;
+
+  // probing information, not saved in index files
+  std::vector<de265_picture_info>  pictures;
+  std::vector<de265_sequence_info> sequences;
+
+ private:
+  std::vector< std::vector<unsigned char> > parameter_sets; // NAL data, each distinct NAL once
+  std::vector< std::vector<int> > entry_parameter_sets; // parameter sets to send, in stream order
+  std::vector<int> active_parameter_sets;
+
+  int64_t access_unit_start; // offset of the first NAL of the current access unit, -1 if none
+
+ private:
+  decoder_context ctx; // parameter sets and slice header parsing
+  NAL_unit slice_nal;
+  slice_segment_header previous_shdr; // for dependent slice segments
+
+  std::vector<unsigned char> buffer; // data of the current and following NALs
+  int     bufferStart;    // position of the first unprocessed byte in 'buffer'
+  int     scanPos;        // position in 'buffer' up to which we searched for start codes
+  int     nalStart;       // start of the current NAL payload in 'buffer', -1 if none
+  int64_t nalOffset;      // stream offset of the start code of the current NAL
+  int64_t bufferOffset;   // stream offset of buffer[0]
+
+  // POC derivation (8.3.1)
+
+  bool first_picture;
+  bool FirstAfterEndOfSequenceNAL;
+  int  prevPicOrderCntLsb;
+  int  prevPicOrderCntMsb;
+
+  int32_t stream_POC_offset;  // added to the POC of all pictures in the current CVS
+  int32_t max_stream_POC;
+
+  void process_NAL(const unsigned char* data, int len, int64_t offset);
+  void add_parameter_set(const unsigned char* data, int len);
+  void process_slice(const unsigned char* data, int len, int64_t offset);
+  bool read_slice_header(const unsigned char* data, int len,
+                         nal_header* nal_hdr, slice_segment_header* shdr, bool* complete);
+  void start_sequence(const seq_parameter_set* sps);
+
+  stream_index(const stream_index&); // not allowed
+  const stream_index& operator=(const stream_index&); // not allowed
+};
+
+#endif
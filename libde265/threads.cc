@@ -21,6 +21,19 @@
 #include "threads.h"
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+
+#ifdef __linux__
+# include <sched.h>
+# include <unistd.h>
+# include <sys/syscall.h>
+# include <linux/futex.h>
+# include <linux/mempolicy.h>
+# include <sys/mman.h>
+#endif
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
 # include <malloc.h>
@@ -79,7 +92,206 @@ void de265_cond_signal(de265_cond* c) { win32_cond_signal(c); }
 #endif // _WIN32
 
 
+bool de265_thread_set_affinity(de265_thread t, int cpu)
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(t, sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+  if (cpu >= (int)(8*sizeof(DWORD_PTR))) {
+    return false;
+  }
+  return SetThreadAffinityMask(t, ((DWORD_PTR)1)<<cpu) != 0;
+#else
+  return false;
+#endif
+}
+
+
+bool de265_numa_get_node_cpus(int node, std::vector<int>* cpus)
+{
+  cpus->clear();
+
+#ifdef __linux__
+  char path[100];
+  sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+
+  FILE* fh = fopen(path, "r");
+  if (fh==NULL) {
+    return false;
+  }
+
+  // list of ranges, e.g. "0-23,48-71"
+
+  int first,last;
+  for (;;) {
+    int n = fscanf(fh, "%d", &first);
+    if (n != 1) {
+      break;
+    }
+
+    last = first;
+
+    int c = fgetc(fh);
+    if (c=='-') {
+      if (fscanf(fh, "%d", &last) != 1) {
+        break;
+      }
+      c = fgetc(fh);
+    }
+
+    for (int i=first;i<=last;i++) {
+      cpus->push_back(i);
+    }
+
+    if (c != ',') {
+      break;
+    }
+  }
+
+  fclose(fh);
+#endif
+
+  return !cpus->empty();
+}
+
+
+bool de265_numa_bind_memory(void* mem, size_t size, int node)
+{
+#ifdef __linux__
+  const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+
+  uintptr_t start = ((uintptr_t)mem + pageSize-1) & ~(pageSize-1);
+  uintptr_t end   = ((uintptr_t)mem + size) & ~(pageSize-1);
+
+  if (end <= start) {
+    return true; // no full page to move
+  }
+
+  const int bitsPerLong = 8*sizeof(unsigned long);
+
+  std::vector<unsigned long> nodemask(node/bitsPerLong + 1);
+  nodemask[node/bitsPerLong] = 1UL << (node % bitsPerLong);
+
+  // pages that have already been touched are migrated to the node
+
+  return syscall(SYS_mbind, (void*)start, end-start, MPOL_PREFERRED,
+                 &nodemask[0], nodemask.size()*bitsPerLong + 1, MPOL_MF_MOVE) == 0;
+#else
+  return false;
+#endif
+}
+
+
+int64_t de265_get_time_usec()
+{
+#ifndef _WIN32
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+#else
+  LARGE_INTEGER count, freq;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
+  return (int64_t)(count.QuadPart * 1000000.0 / freq.QuadPart);
+#endif
+}
+
+
+bool de265_advise_huge_pages(void* mem, size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  const uintptr_t hugePageSize = DE265_HUGE_PAGE_SIZE;
+
+  uintptr_t start = ((uintptr_t)mem + hugePageSize-1) & ~(hugePageSize-1);
+  uintptr_t end   = ((uintptr_t)mem + size) & ~(hugePageSize-1);
+
+  if (end <= start) {
+    return false;
+  }
+
+  return madvise((void*)start, end-start, MADV_HUGEPAGE) == 0;
+#else
+  return false;
+#endif
+}
+
+
+
+
+#if DE265_PROGRESS_LOCK_FUTEX
+
+#define PROGRESS_WAITERS_FLAG  (1<<30)
+
+static inline void futex_wait(volatile int* addr, int value)
+{
+  syscall(SYS_futex, (int*)addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static inline void futex_wake_all(volatile int* addr)
+{
+  syscall(SYS_futex, (int*)addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+
+de265_progress_lock::de265_progress_lock()
+{
+  mProgress = 0;
+}
+
+de265_progress_lock::~de265_progress_lock()
+{
+}
+
+void de265_progress_lock::wait_for_progress(int progress)
+{
+  for (;;) {
+    int value = __atomic_load_n(&mProgress, __ATOMIC_ACQUIRE);
+
+    if ((value & ~PROGRESS_WAITERS_FLAG) >= progress) {
+      return;
+    }
+
+    // announce that there is a waiter, then sleep until the value changes
+
+    if ((value & PROGRESS_WAITERS_FLAG) == 0 &&
+        !__sync_bool_compare_and_swap(&mProgress, value, value | PROGRESS_WAITERS_FLAG)) {
+      continue;
+    }
+
+    futex_wait(&mProgress, value | PROGRESS_WAITERS_FLAG);
+  }
+}
+
+void de265_progress_lock::set_progress(int progress)
+{
+  for (;;) {
+    int value = mProgress;
+
+    if ((value & ~PROGRESS_WAITERS_FLAG) >= progress) {
+      return;
+    }
+
+    // setting the new value also clears the waiters flag
+
+    if (__sync_bool_compare_and_swap(&mProgress, value, progress)) {
+      if (value & PROGRESS_WAITERS_FLAG) {
+        futex_wake_all(&mProgress);
+      }
+
+      return;
+    }
+  }
+}
+
+int  de265_progress_lock::get_progress() const
+{
+  return __atomic_load_n(&mProgress, __ATOMIC_ACQUIRE) & ~PROGRESS_WAITERS_FLAG;
+}
 
+#else
 
 de265_progress_lock::de265_progress_lock()
 {
@@ -126,6 +338,7 @@ int  de265_progress_lock::get_progress() const
   return mProgress;
 }
 
+#endif
 
 
 
@@ -151,12 +364,6 @@ void printblks(const thread_pool* pool)
     p[y*w+x] = b+'0';
   }
 
-  for (int i=0;i<pool->num_threads_working;i++) {
-    int x = pool->ctbx[i];
-    int y = pool->ctby[i];
-    p[y*w+x] = '*';
-  }
-
   printf("+%s+\n",line+50-w);
   for (int y=0;y<h;y++)
     {
@@ -179,6 +386,8 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
 
   de265_mutex_lock(&pool->mutex);
 
+  const int workerID = pool->num_workers_started++;
+
   while(true) {
 
     // wait until we can pick a task or until the pool has been stopped
@@ -211,18 +420,41 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
 
     //printblks(pool);
 
+    const bool trace = pool->trace_tasks;
+    task_trace_event ev;
+    int64_t blocked = 0;
+
+    if (trace) {
+      task->describe(&ev);
+      ev.worker = workerID;
+      task->blocked_time = &blocked;
+    }
+
     de265_mutex_unlock(&pool->mutex);
 
 
     // execute the task
 
-    task->work();
+    if (trace) { ev.start = de265_get_time_usec(); }
+
+    task->work(); // 'task' may not be accessed after this
+
+    if (trace) { ev.end = de265_get_time_usec(); }
 
     // end processing and check if this was the last task to be processed
 
     de265_mutex_lock(&pool->mutex);
 
     pool->num_threads_working--;
+
+    if (trace) {
+      ev.blocked = blocked;
+      pool->trace_events.push_back(ev);
+
+      if (pool->num_threads_working==0) {
+        de265_cond_broadcast(&pool->idle_cond, &pool->mutex);
+      }
+    }
   }
   de265_mutex_unlock(&pool->mutex);
 
@@ -230,24 +462,21 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
 }
 
 
-de265_error start_thread_pool(thread_pool* pool, int num_threads)
+de265_error start_thread_pool(thread_pool* pool, int num_threads,
+                              const std::vector<int>& cpus)
 {
   de265_error err = DE265_OK;
 
-  // limit number of threads to maximum
-
-  if (num_threads > MAX_THREADS) {
-    num_threads = MAX_THREADS;
-    err = DE265_WARNING_NUMBER_OF_THREADS_LIMITED_TO_MAXIMUM;
-  }
-
+  pool->thread.resize(num_threads);
   pool->num_threads = 0; // will be increased below
 
   de265_mutex_init(&pool->mutex);
   de265_cond_init(&pool->cond_var);
+  de265_cond_init(&pool->idle_cond);
 
   de265_mutex_lock(&pool->mutex);
   pool->num_threads_working = 0;
+  pool->num_workers_started = 0;
   pool->stopped = false;
   de265_mutex_unlock(&pool->mutex);
 
@@ -257,9 +486,14 @@ de265_error start_thread_pool(thread_pool* pool, int num_threads)
     int ret = de265_thread_create(&pool->thread[i], worker_thread, pool);
     if (ret != 0) {
       // cerr << "pthread_create() failed: " << ret << endl;
+      pool->thread.resize(pool->num_threads);
       return DE265_ERROR_CANNOT_START_THREADPOOL;
     }
 
+    if (!cpus.empty()) {
+      de265_thread_set_affinity(pool->thread[i], cpus[i % cpus.size()]);
+    }
+
     pool->num_threads++;
   }
 
@@ -267,6 +501,136 @@ de265_error start_thread_pool(thread_pool* pool, int num_threads)
 }
 
 
+void thread_task::describe(task_trace_event* ev) const
+{
+  ev->name  = "task";
+  ev->index = -1;
+  ev->POC   = INT_MIN;
+}
+
+
+void get_task_trace(thread_pool* pool, std::vector<task_trace_event>* events, int* num_workers)
+{
+  de265_mutex_lock(&pool->mutex);
+
+  // nothing recorded, and the workers do not signal 'idle_cond'
+
+  if (!pool->trace_tasks) {
+    events->clear();
+    *num_workers = pool->num_workers_started;
+    de265_mutex_unlock(&pool->mutex);
+    return;
+  }
+
+  // A task signals its completion before the worker records it. Wait until it is recorded.
+
+  while (pool->num_threads_working>0) {
+    de265_cond_wait(&pool->idle_cond, &pool->mutex);
+  }
+
+  // hand over the recorded tasks, so that the trace does not grow without bound
+
+  events->clear();
+  events->swap(pool->trace_events);
+  *num_workers = pool->num_workers_started;
+  de265_mutex_unlock(&pool->mutex);
+}
+
+
+bool write_task_trace(const char* filename,
+                      const std::vector<task_trace_event>& events, int nWorkers)
+{
+  FILE* fh = fopen(filename, "w");
+  if (fh==NULL) {
+    return false;
+  }
+
+  int64_t t0 = events.empty() ? 0 : events[0].start;
+  for (size_t i=1;i<events.size();i++) {
+    t0 = std::min(t0, events[i].start);
+  }
+
+  fprintf(fh, "{\"traceEvents\":[\n");
+
+  for (int w=0;w<nWorkers;w++) {
+    fprintf(fh, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"worker %d\"}},\n", w, w);
+  }
+
+  for (size_t i=0;i<events.size();i++) {
+    const task_trace_event& ev = events[i];
+
+    fprintf(fh, "{\"name\":\"%s", ev.name);
+    if (ev.index>=0) { fprintf(fh, " %d", ev.index); }
+    fprintf(fh, "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%lld,\"dur\":%lld,\"args\":{",
+            ev.name, ev.worker, (long long)(ev.start-t0), (long long)(ev.end-ev.start));
+    if (ev.POC != INT_MIN) { fprintf(fh, "\"POC\":%d,", ev.POC); }
+    fprintf(fh, "\"blocked_us\":%lld}}%s\n", (long long)ev.blocked,
+            i+1<events.size() ? "," : "");
+  }
+
+  fprintf(fh, "]}\n");
+
+  bool success = !ferror(fh);
+  fclose(fh);
+
+  return success;
+}
+
+
+void thread_task::release()
+{
+  if (arena) {
+    arena->put(this);
+  }
+  else {
+    delete this;
+  }
+}
+
+
+thread_task_arena::~thread_task_arena()
+{
+  for (size_t l=0;l<free_lists.size();l++)
+    for (size_t i=0;i<free_lists[l].tasks.size();i++) {
+      delete free_lists[l].tasks[i];
+    }
+}
+
+
+thread_task* thread_task_arena::take(const void* tag)
+{
+  for (size_t l=0;l<free_lists.size();l++)
+    if (free_lists[l].tag == tag) {
+      std::vector<thread_task*>& tasks = free_lists[l].tasks;
+      if (tasks.empty()) {
+        return NULL;
+      }
+
+      thread_task* task = tasks.back();
+      tasks.pop_back();
+      return task;
+    }
+
+  return NULL;
+}
+
+
+void thread_task_arena::put(thread_task* task)
+{
+  for (size_t l=0;l<free_lists.size();l++)
+    if (free_lists[l].tag == task->arena_tag) {
+      free_lists[l].tasks.push_back(task);
+      return;
+    }
+
+  free_lists.push_back(free_list());
+  free_lists.back().tag = task->arena_tag;
+  free_lists.back().tasks.push_back(task);
+}
+
+
 void stop_thread_pool(thread_pool* pool)
 {
   de265_mutex_lock(&pool->mutex);
@@ -280,8 +644,11 @@ void stop_thread_pool(thread_pool* pool)
     de265_thread_destroy(&pool->thread[i]);
   }
 
+  pool->thread.clear();
+
   de265_mutex_destroy(&pool->mutex);
   de265_cond_destroy(&pool->cond_var);
+  de265_cond_destroy(&pool->idle_cond);
 }
 
 
@@ -32,6 +32,8 @@
 #endif
 
 #include <deque>
+#include <vector>
+#include <limits.h>
 
 #ifndef _WIN32
 #include <pthread.h>
@@ -67,6 +69,18 @@ void de265_cond_broadcast(de265_cond* c, de265_mutex* m);
 void de265_cond_wait(de265_cond* c,de265_mutex* m);
 void de265_cond_signal(de265_cond* c);
 
+// CPU and NUMA placement. These return false when not supported on this platform.
+bool de265_thread_set_affinity(de265_thread t, int cpu);
+bool de265_numa_get_node_cpus(int node, std::vector<int>* cpus);
+bool de265_numa_bind_memory(void* mem, size_t size, int node); // only whole pages inside the range
+
+// Monotonic wall-clock time in microseconds.
+int64_t de265_get_time_usec();
+
+// Request transparent huge pages for the whole huge pages inside the range (Linux THP).
+#define DE265_HUGE_PAGE_SIZE (2*1024*1024)
+bool de265_advise_huge_pages(void* mem, size_t size);
+
 typedef volatile long de265_sync_int;
 
 inline int de265_sync_sub_and_fetch(de265_sync_int* cnt, int n)
@@ -92,6 +106,15 @@ inline int de265_sync_add_and_fetch(de265_sync_int* cnt, int n)
 }
 
 
+/* On Linux, the progress lock is a single integer. Waiting threads sleep on a futex
+   and set a flag bit in the progress value, so that set_progress() only has to enter
+   the kernel when somebody is actually waiting.
+   Other platforms use a mutex / condition variable pair.
+ */
+#if defined(__linux__) && defined(__GNUC__)
+#define DE265_PROGRESS_LOCK_FUTEX 1
+#endif
+
 class de265_progress_lock
 {
 public:
@@ -104,29 +127,102 @@ public:
   void reset(int value=0) { mProgress=value; }
 
 private:
+#if DE265_PROGRESS_LOCK_FUTEX
+  volatile int mProgress; // progress value | PROGRESS_WAITERS_FLAG
+#else
   int mProgress;
 
   // private data
 
   de265_mutex mutex;
   de265_cond  cond;
+#endif
 };
 
 
 
+/* One executed task in the task trace (DE265_DECODER_PARAM_TRACE_TASKS).
+   Times are in microseconds of de265_get_time_usec().
+ */
+struct task_trace_event
+{
+  const char* name;  // static string, set by thread_task::describe()
+  int index;         // e.g. the CTB row, -1: none
+  int POC;           // picture the task works on, INT_MIN: none
+  int worker;
+  int64_t start, end;
+  int64_t blocked;   // time spent waiting for the progress of other tasks
+};
+
+
 class thread_task
 {
 public:
-  thread_task() : state(Queued) { }
+  thread_task() : state(Queued), blocked_time(NULL), arena(NULL), arena_tag(NULL) { }
   virtual ~thread_task() { }
 
   enum { Queued, Running, Blocked, Finished } state;
 
   virtual void work() = 0;
+
+  // fill in name, index and POC for the task trace, called before work()
+  virtual void describe(task_trace_event* ev) const;
+
+  /* While a traced task is running, time it spends blocked is added here.
+     Points into the worker thread, because the task may be released before work() returns. */
+  int64_t* blocked_time;
+
+  /* Give the task object back to the arena it was taken from.
+     Tasks that were allocated with 'new' are deleted. */
+  void release();
+
+private:
+  friend class thread_task_arena;
+
+  class thread_task_arena* arena;
+  const void* arena_tag;  // identifies the task type in the arena
 };
 
 
-#define MAX_THREADS 32
+/* Keeps finished task objects for reuse, such that the per-CTB-row tasks of
+   each picture do not have to be allocated again. There is one free list for
+   each task type. Not thread-safe, tasks are created and released by the
+   decoding thread only.
+ */
+class thread_task_arena
+{
+public:
+  ~thread_task_arena();
+
+  template <class T> T* get_task()
+  {
+    static const char type_tag = 0; // the address is unique for each task type
+
+    T* task = static_cast<T*>(take(&type_tag));
+    if (task==NULL) {
+      task = new T;
+      task->arena = this;
+      task->arena_tag = &type_tag;
+    }
+
+    task->state = thread_task::Queued;
+    task->blocked_time = NULL;
+    return task;
+  }
+
+  void put(thread_task* task);
+
+private:
+  thread_task* take(const void* tag);
+
+  struct free_list {
+    const void* tag;
+    std::vector<thread_task*> tasks;
+  };
+
+  std::vector<free_list> free_lists;
+};
+
 
 /* TODO NOTE: When unblocking a task, we have to check first
    if there are threads waiting because of the run-count limit.
@@ -141,22 +237,34 @@ class thread_pool
 
   std::deque<thread_task*> tasks;  // we are not the owner
 
-  de265_thread thread[MAX_THREADS];
+  std::vector<de265_thread> thread;
   int num_threads;
 
   int num_threads_working;
 
-  int ctbx[MAX_THREADS]; // the CTB the thread is working on
-  int ctby[MAX_THREADS];
-
   de265_mutex  mutex;
   de265_cond   cond_var;
+
+  // task tracing, 'trace_events' is protected by 'mutex'
+  bool trace_tasks;
+  int  num_workers_started;
+  std::vector<task_trace_event> trace_events;
+  de265_cond idle_cond; // broadcast when tracing and no worker is busy anymore
 };
 
 
-de265_error start_thread_pool(thread_pool* pool, int num_threads);
+/* If 'cpus' is not empty, worker i is pinned to cpus[i % cpus.size()]. */
+de265_error start_thread_pool(thread_pool* pool, int num_threads,
+                              const std::vector<int>& cpus = std::vector<int>());
 void        stop_thread_pool(thread_pool* pool); // do not process remaining tasks
 
 void        add_task(thread_pool* pool, thread_task* task); // TOCO: can make thread_task const
 
+// moves the recorded tasks out of the pool, waits until the running tasks have finished
+void        get_task_trace(thread_pool* pool, std::vector<task_trace_event>* events, int* num_workers);
+
+// write recorded tasks in the Chrome trace event format (chrome://tracing, Perfetto)
+bool        write_task_trace(const char* filename,
+                             const std::vector<task_trace_event>& events, int num_workers);
+
 #endif
@@ -196,8 +196,34 @@ void transform_coefficients(decoder_context* ctx,
 }
 
 
+void transform_coefficients_16(decoder_context* ctx,
+                               int16_t* coeff, int coeffStride, int nT, int trType,
+                               uint16_t* dst, int dstStride, int bit_depth)
+{
+  logtrace(LogTransform,"transform --- trType: %d nT: %d\n",trType,nT);
+
+  if (trType==1) {
+
+    ctx->acceleration.transform_4x4_luma_add_16(dst, coeff, dstStride, bit_depth);
+
+  } else {
+
+    /**/ if (nT==4)  { ctx->acceleration.transform_4x4_add_16(dst,coeff,dstStride,bit_depth); }
+    else if (nT==8)  { ctx->acceleration.transform_8x8_add_16(dst,coeff,dstStride,bit_depth); }
+    else if (nT==16) { ctx->acceleration.transform_16x16_add_16(dst,coeff,dstStride,bit_depth); }
+    else             { ctx->acceleration.transform_32x32_add_16(dst,coeff,dstStride,bit_depth); }
+  }
+}
+
+
 static const int levelScale[] = { 40,45,51,57,64,72 };
 
+/* Blocks with at least 1/DENSE_DEQUANT_RATIO of their coefficients being non-zero are
+   dequantized as a whole with the (SIMD) block functions. Sparser blocks are
+   dequantized coefficient by coefficient.
+ */
+#define DENSE_DEQUANT_RATIO 8
+
 // (8.6.2) and (8.6.3)
 void scale_coefficients(thread_context* tctx,
                         int xT,int yT, // position of TU in frame (chroma adapted)
@@ -236,6 +262,9 @@ void scale_coefficients(thread_context* tctx,
   pred = tctx->img->get_image_plane_at_pos(cIdx, xT,yT);
   stride = tctx->img->get_image_stride(cIdx);
 
+  const int bit_depth = tctx->img->get_bit_depth(cIdx);
+  const bool high_bit_depth = tctx->img->high_bit_depth(cIdx);
+
   //fprintf(stderr,"POC=%d pred: %p (%d;%d stride=%d)\n",ctx->img->PicOrderCntVal,pred,xT,yT,stride);
 
   /*
@@ -261,18 +290,40 @@ void scale_coefficients(thread_context* tctx,
       tctx->coeffBuf[ tctx->coeffPos[cIdx][i] ] = currCoeff;
     }
 
-    tctx->decctx->acceleration.transform_bypass_8(pred, coeff, nT, stride);
+    if (high_bit_depth) {
+      tctx->decctx->acceleration.transform_bypass_16((uint16_t*)pred, coeff, nT, stride,
+                                                     bit_depth);
+    }
+    else {
+      tctx->decctx->acceleration.transform_bypass_8(pred, coeff, nT, stride);
+    }
   }
   else {
     // (8.6.3)
 
-    int bdShift = (cIdx==0 ? sps->BitDepth_Y : sps->BitDepth_C) + Log2(nT) - 5;
+    int bdShift = bit_depth + Log2(nT) - 5;
 
     logtrace(LogTransform,"bdShift=%d\n",bdShift);
 
     logtrace(LogTransform,"dequant %d;%d cIdx=%d qp=%d\n",xT*(cIdx?2:1),yT*(cIdx?2:1),cIdx,qP);
 
-    if (sps->scaling_list_enable_flag==0) {
+    const bool dense = (tctx->nCoeff[cIdx] * DENSE_DEQUANT_RATIO >= nT*nT);
+
+    if (dense) {
+      // Place the coefficient levels into the block and scale all of them in place.
+      // The factor (m_x_y * levelScale) fits into 16 bit, the shift by qP/6 is merged
+      // into bdShift.
+
+      for (int i=0;i<tctx->nCoeff[cIdx];i++) {
+        tctx->coeffBuf[ tctx->coeffPos[cIdx][i] ] = tctx->coeffList[cIdx][i];
+      }
+    }
+
+    if (sps->scaling_list_enable_flag==0 && dense) {
+      tctx->decctx->acceleration.dequant_flat(coeff, nT*nT,
+                                              16*levelScale[qP%6], bdShift - qP/6);
+    }
+    else if (sps->scaling_list_enable_flag==0) {
 
       //const int m_x_y = 16;
       const int m_x_y = 1;
@@ -283,8 +334,9 @@ void scale_coefficients(thread_context* tctx,
 
       for (int i=0;i<tctx->nCoeff[cIdx];i++) {
 
-        // usually, this needs to be 64bit, but because we modify the shift above, we can use 16 bit
-        int32_t currCoeff  = tctx->coeffList[cIdx][i];
+        // 32 bit are sufficient for 8 bit video because of the modified shift above.
+        // With higher bit depths, qP/6 can reach 10 and the product needs 64 bit.
+        int64_t currCoeff  = tctx->coeffList[cIdx][i];
 
         currCoeff = Clip3(-32768,32767,
                           ( (currCoeff * fact + offset ) >> bdShift));
@@ -310,20 +362,24 @@ void scale_coefficients(thread_context* tctx,
       default: assert(0);
       }
 
-      for (int i=0;i<tctx->nCoeff[cIdx];i++) {
-        int pos = tctx->coeffPos[cIdx][i];
-        int x = pos%nT;
-        int y = pos/nT;
+      if (dense) {
+        tctx->decctx->acceleration.dequant_scaled(coeff, sclist, nT*nT,
+                                                  levelScale[qP%6], bdShift - qP/6);
+      }
+      else {
+        for (int i=0;i<tctx->nCoeff[cIdx];i++) {
+          int pos = tctx->coeffPos[cIdx][i];
 
-        const int m_x_y = sclist[x+y*nT];
-        const int fact = m_x_y * levelScale[qP%6] << (qP/6);
+          const int m_x_y = sclist[pos];
+          const int fact = m_x_y * levelScale[qP%6] << (qP/6);
 
-        int64_t currCoeff  = tctx->coeffList[cIdx][i];
+          int64_t currCoeff  = tctx->coeffList[cIdx][i];
 
-        currCoeff = Clip3(-32768,32767,
-                          ( (currCoeff * fact + offset ) >> bdShift));
+          currCoeff = Clip3(-32768,32767,
+                            ( (currCoeff * fact + offset ) >> bdShift));
 
-        tctx->coeffBuf[ tctx->coeffPos[cIdx][i] ] = currCoeff;
+          tctx->coeffBuf[ tctx->coeffPos[cIdx][i] ] = currCoeff;
+        }
       }
     }
 
@@ -336,7 +392,7 @@ void scale_coefficients(thread_context* tctx,
       logtrace(LogTransform,"*\n");
     }
 
-    int bdShift2 = (cIdx==0) ? 20-sps->BitDepth_Y : 20-sps->BitDepth_C;
+    int bdShift2 = 20-bit_depth;
 
     logtrace(LogTransform,"bdShift2=%d\n",bdShift2);
 
@@ -345,7 +401,12 @@ void scale_coefficients(thread_context* tctx,
 
     if (transform_skip_flag) {
 
-      tctx->decctx->acceleration.transform_skip_8(pred, coeff, stride);
+      if (high_bit_depth) {
+        tctx->decctx->acceleration.transform_skip_16((uint16_t*)pred, coeff, stride, bit_depth);
+      }
+      else {
+        tctx->decctx->acceleration.transform_skip_8(pred, coeff, stride);
+      }
     }
     else {
       int trType;
@@ -357,8 +418,14 @@ void scale_coefficients(thread_context* tctx,
         trType=0;
       }
 
-      transform_coefficients(tctx->decctx, coeff, coeffStride, nT, trType, bdShift2,
-                             pred, stride);
+      if (high_bit_depth) {
+        transform_coefficients_16(tctx->decctx, coeff, coeffStride, nT, trType,
+                                  (uint16_t*)pred, stride, bit_depth);
+      }
+      else {
+        transform_coefficients(tctx->decctx, coeff, coeffStride, nT, trType, bdShift2,
+                               pred, stride);
+      }
     }
   }
 
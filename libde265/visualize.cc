@@ -68,7 +68,8 @@ void write_picture_to_file(const de265_image* img, const char* filename)
 
   for (int c=0;c<3;c++)
     for (int y=0;y<de265_get_image_height(img,c);y++)
-      fwrite(img->get_image_plane_at_pos(c, 0,y), de265_get_image_width(img,c), 1, fh);
+      fwrite(img->get_image_plane_at_pos(c, 0,y),
+             de265_get_image_width(img,c) * img->get_bytes_per_pixel(c), 1, fh);
 
   fflush(fh);
   fclose(fh);
@@ -292,7 +293,10 @@ void draw_PB_block(const de265_image* srcimg,uint8_t* img,int stride,
     tint_rect(img,stride, x0,y0,w,h, cols[predMode], pixelSize);
   }
   else if (what == PBMotionVectors) {
-    const PredVectorInfo* mvi = srcimg->get_mv_info(x0,y0);
+    // after decoding, only the 16x16 motion field is available
+    const PredVectorInfo* mvi = (srcimg->has_mv_info() ?
+                                 srcimg->get_mv_info(x0,y0) :
+                                 &srcimg->get_collocated_mv_info(x0,y0)->mvi);
     int x = x0+w/2;
     int y = y0+h/2;
     if (mvi->predFlag[0]) {
@@ -0,0 +1,134 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "x86/sse-convert.h"
+#include "libde265/fallback-convert.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <emmintrin.h> // SSE2
+#include <tmmintrin.h> // SSSE3
+#include <smmintrin.h> // SSE4.1
+
+
+void interleave_chroma_8_sse4(uint8_t* dst, const uint8_t* u, const uint8_t* v, int width)
+{
+  int x=0;
+
+  for (;x+16<=width;x+=16) {
+    __m128i u16 = _mm_loadu_si128((const __m128i*)(u+x));
+    __m128i v16 = _mm_loadu_si128((const __m128i*)(v+x));
+
+    _mm_storeu_si128((__m128i*)(dst+2*x   ), _mm_unpacklo_epi8(u16,v16));
+    _mm_storeu_si128((__m128i*)(dst+2*x+16), _mm_unpackhi_epi8(u16,v16));
+  }
+
+  if (x<width) {
+    interleave_chroma_8_fallback(dst+2*x, u+x, v+x, width-x);
+  }
+}
+
+
+/* Converts 16 pixels per iteration. The arithmetic matches yuv420_to_rgb_8_fallback()
+   exactly (16 bit, saturating), so that the output does not depend on the CPU.
+ */
+void yuv420_to_rgb_8_sse4(uint8_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                          int width, const int16_t* coeffs, int bytes_per_pixel)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i c16  = _mm_set1_epi16(16);
+  const __m128i c128 = _mm_set1_epi16(128);
+  const __m128i rnd  = _mm_set1_epi16(32);
+  const __m128i cy   = _mm_set1_epi16(coeffs[0]);
+  const __m128i crv  = _mm_set1_epi16(coeffs[1]);
+  const __m128i cgu  = _mm_set1_epi16(coeffs[2]);
+  const __m128i cgv  = _mm_set1_epi16(coeffs[3]);
+  const __m128i cbu  = _mm_set1_epi16(coeffs[4]);
+  const __m128i alpha = _mm_set1_epi8((char)0xFF);
+  const __m128i rgba_to_rgb = _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+
+  int x=0;
+
+  for (;x+16<=width;x+=16) {
+    __m128i y16 = _mm_loadu_si128((const __m128i*)(y+x));
+    __m128i u8  = _mm_loadl_epi64((const __m128i*)(u+x/2));
+    __m128i v8  = _mm_loadl_epi64((const __m128i*)(v+x/2));
+
+    // upsample chroma horizontally
+    __m128i u16 = _mm_unpacklo_epi8(u8,u8);
+    __m128i v16 = _mm_unpacklo_epi8(v8,v8);
+
+    __m128i r[2],g[2],b[2];
+
+    for (int h=0;h<2;h++) {
+      __m128i Y = h ? _mm_unpackhi_epi8(y16,zero) : _mm_unpacklo_epi8(y16,zero);
+      __m128i U = h ? _mm_unpackhi_epi8(u16,zero) : _mm_unpacklo_epi8(u16,zero);
+      __m128i V = h ? _mm_unpackhi_epi8(v16,zero) : _mm_unpacklo_epi8(v16,zero);
+
+      Y = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(Y,c16), cy), rnd);
+      U = _mm_sub_epi16(U,c128);
+      V = _mm_sub_epi16(V,c128);
+
+      r[h] = _mm_srai_epi16(_mm_adds_epi16(Y, _mm_mullo_epi16(V,crv)), 6);
+      g[h] = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(Y, _mm_mullo_epi16(U,cgu)),
+                                           _mm_mullo_epi16(V,cgv)), 6);
+      b[h] = _mm_srai_epi16(_mm_adds_epi16(Y, _mm_mullo_epi16(U,cbu)), 6);
+    }
+
+    __m128i R = _mm_packus_epi16(r[0],r[1]);
+    __m128i G = _mm_packus_epi16(g[0],g[1]);
+    __m128i B = _mm_packus_epi16(b[0],b[1]);
+
+    __m128i rg_lo = _mm_unpacklo_epi8(R,G);
+    __m128i rg_hi = _mm_unpackhi_epi8(R,G);
+    __m128i ba_lo = _mm_unpacklo_epi8(B,alpha);
+    __m128i ba_hi = _mm_unpackhi_epi8(B,alpha);
+
+    __m128i p[4];
+    p[0] = _mm_unpacklo_epi16(rg_lo,ba_lo);
+    p[1] = _mm_unpackhi_epi16(rg_lo,ba_lo);
+    p[2] = _mm_unpacklo_epi16(rg_hi,ba_hi);
+    p[3] = _mm_unpackhi_epi16(rg_hi,ba_hi);
+
+    if (bytes_per_pixel==4) {
+      for (int i=0;i<4;i++) {
+        _mm_storeu_si128((__m128i*)(dst+16*i), p[i]);
+      }
+    }
+    else {
+      // each store writes 4 bytes too much, these are overwritten by the next store
+      for (int i=0;i<3;i++) {
+        _mm_storeu_si128((__m128i*)(dst+12*i), _mm_shuffle_epi8(p[i], rgba_to_rgb));
+      }
+
+      __m128i last = _mm_shuffle_epi8(p[3], rgba_to_rgb);
+      _mm_storel_epi64((__m128i*)(dst+36), last);
+      *(int32_t*)(dst+44) = _mm_extract_epi32(last, 2);
+    }
+
+    dst += 16*bytes_per_pixel;
+  }
+
+  if (x<width) {
+    yuv420_to_rgb_8_fallback(dst, y+x, u+x/2, v+x/2, width-x, coeffs, bytes_per_pixel);
+  }
+}
@@ -0,0 +1,32 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SSE_CONVERT_H
+#define SSE_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+void interleave_chroma_8_sse4(uint8_t* dst, const uint8_t* u, const uint8_t* v, int width);
+
+void yuv420_to_rgb_8_sse4(uint8_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                          int width, const int16_t* coeffs, int bytes_per_pixel);
+
+#endif
@@ -7092,3 +7092,331 @@ void ff_hevc_transform_32x32_add_10_sse4(uint8_t *_dst, int16_t *coeffs,
 }
 #endif
 
+
+#if HAVE_SSE4_1
+/* High bit-depth inverse DCT with the even/odd decomposition of the transform matrix:
+   the odd input rows of an n-point transform give O[k], the even rows are an n/2-point
+   transform E[k], and the outputs are E[k]+O[k] and (mirrored) E[k]-O[k]. The odd rows of
+   each size are taken from the coefficient tables above. Rounding and saturation are the
+   same as in transform_dct_add() of fallback-dct.cc, so the results are identical.
+ */
+
+// [n/4 pairs of odd rows][n/2 outputs][8]
+static inline const int16_t* idct_odd_pairs(int n)
+{
+  switch (n) {
+  case 4:  return &transform16x16_3[0][0][0];
+  case 8:  return &transform16x16_2[0][0][0];
+  case 16: return &transform16x16_1[0][0][0];
+  default: return &transform32x32[0][0][0];
+  }
+}
+
+
+/* n-point inverse DCT of 8 columns. Input row j is s[j*step], all rows from 'nRows' on are
+   zero. The 32 bit results of output row k are returned in lo[k] (columns 0-3) and
+   hi[k] (columns 4-7).
+ */
+template <int n>
+static inline void idct_columns_16(const __m128i* s, int step, int nRows,
+                                   __m128i* lo, __m128i* hi)
+{
+  const int half = n/2;
+
+  __m128i Elo[half], Ehi[half];
+  idct_columns_16<half>(s, 2*step, nRows, Elo, Ehi);
+
+  __m128i Olo[half], Ohi[half];
+  for (int k=0;k<half;k++) {
+    Olo[k] = Ohi[k] = _mm_setzero_si128();
+  }
+
+  const int16_t* pairs = idct_odd_pairs(n);
+
+  for (int p=0; p<n/4 && (4*p+1)*step<nRows; p++) {
+    __m128i l = _mm_unpacklo_epi16(s[(4*p+1)*step], s[(4*p+3)*step]);
+    __m128i h = _mm_unpackhi_epi16(s[(4*p+1)*step], s[(4*p+3)*step]);
+
+    for (int k=0;k<half;k++) {
+      __m128i c = _mm_load_si128((const __m128i*)(pairs + (p*half+k)*8));
+      Olo[k] = _mm_add_epi32(Olo[k], _mm_madd_epi16(l,c));
+      Ohi[k] = _mm_add_epi32(Ohi[k], _mm_madd_epi16(h,c));
+    }
+  }
+
+  for (int k=0;k<half;k++) {
+    lo[k]     = _mm_add_epi32(Elo[k], Olo[k]);
+    hi[k]     = _mm_add_epi32(Ehi[k], Ohi[k]);
+    lo[n-1-k] = _mm_sub_epi32(Elo[k], Olo[k]);
+    hi[n-1-k] = _mm_sub_epi32(Ehi[k], Ohi[k]);
+  }
+}
+
+// the 2-point transform (rows 0 and 16 of the 32-point matrix) ends the recursion
+template <>
+inline void idct_columns_16<2>(const __m128i* s, int step, int nRows,
+                               __m128i* lo, __m128i* hi)
+{
+  __m128i l = _mm_unpacklo_epi16(s[0], s[step]);
+  __m128i h = _mm_unpackhi_epi16(s[0], s[step]);
+
+  for (int k=0;k<2;k++) {
+    __m128i c = _mm_load_si128((const __m128i*)transform16x16_3[1][k]);
+    lo[k] = _mm_madd_epi16(l,c);
+    hi[k] = _mm_madd_epi16(h,c);
+  }
+}
+
+
+static inline void transpose_8x8_epi16(__m128i* r)
+{
+  __m128i a0 = _mm_unpacklo_epi16(r[0],r[1]);
+  __m128i a1 = _mm_unpackhi_epi16(r[0],r[1]);
+  __m128i a2 = _mm_unpacklo_epi16(r[2],r[3]);
+  __m128i a3 = _mm_unpackhi_epi16(r[2],r[3]);
+  __m128i a4 = _mm_unpacklo_epi16(r[4],r[5]);
+  __m128i a5 = _mm_unpackhi_epi16(r[4],r[5]);
+  __m128i a6 = _mm_unpacklo_epi16(r[6],r[7]);
+  __m128i a7 = _mm_unpackhi_epi16(r[6],r[7]);
+
+  __m128i b0 = _mm_unpacklo_epi32(a0,a2);
+  __m128i b1 = _mm_unpackhi_epi32(a0,a2);
+  __m128i b2 = _mm_unpacklo_epi32(a1,a3);
+  __m128i b3 = _mm_unpackhi_epi32(a1,a3);
+  __m128i b4 = _mm_unpacklo_epi32(a4,a6);
+  __m128i b5 = _mm_unpackhi_epi32(a4,a6);
+  __m128i b6 = _mm_unpacklo_epi32(a5,a7);
+  __m128i b7 = _mm_unpackhi_epi32(a5,a7);
+
+  r[0] = _mm_unpacklo_epi64(b0,b4);
+  r[1] = _mm_unpackhi_epi64(b0,b4);
+  r[2] = _mm_unpacklo_epi64(b1,b5);
+  r[3] = _mm_unpackhi_epi64(b1,b5);
+  r[4] = _mm_unpacklo_epi64(b2,b6);
+  r[5] = _mm_unpackhi_epi64(b2,b6);
+  r[6] = _mm_unpacklo_epi64(b3,b7);
+  r[7] = _mm_unpackhi_epi64(b3,b7);
+}
+
+// transposes the 4x4 blocks in the lower halves
+static inline void transpose_4x4_epi16(__m128i* r)
+{
+  __m128i a0 = _mm_unpacklo_epi16(r[0],r[1]);
+  __m128i a1 = _mm_unpacklo_epi16(r[2],r[3]);
+
+  __m128i b0 = _mm_unpacklo_epi32(a0,a1);
+  __m128i b1 = _mm_unpackhi_epi32(a0,a1);
+
+  r[0] = b0;
+  r[1] = _mm_srli_si128(b0,8);
+  r[2] = b1;
+  r[3] = _mm_srli_si128(b1,8);
+}
+
+
+/* Both passes transform columns, 8 at a time (4 for 4x4 blocks). The result of the first
+   pass is stored transposed, such that the rows of the second pass become columns.
+ */
+template <int nT>
+static void transform_dct_add_16(uint16_t *dst, ptrdiff_t stride,
+                                 const int16_t *coeffs, int bit_depth)
+{
+  const int vecW = (nT<8 ? nT : 8);
+  const __m128i zero = _mm_setzero_si128();
+
+#define LOAD_16(p)    (vecW==8 ? _mm_loadu_si128((const __m128i*)(p)) : \
+                                 _mm_loadl_epi64((const __m128i*)(p)))
+#define STORE_16(p,v) (vecW==8 ? _mm_storeu_si128((__m128i*)(p),v) : \
+                                 _mm_storel_epi64((__m128i*)(p),v))
+
+  // number of rows and columns up to the last non-zero coefficient
+
+  __m128i colNonZero[nT/vecW];
+  for (int c=0;c<nT/vecW;c++) {
+    colNonZero[c] = zero;
+  }
+
+  int nRows = 0;
+  for (int j=0;j<nT;j++) {
+    __m128i rowNonZero = zero;
+    for (int c=0;c<nT;c+=vecW) {
+      __m128i v = LOAD_16(coeffs + j*nT + c);
+      colNonZero[c/vecW] = _mm_or_si128(colNonZero[c/vecW], v);
+      rowNonZero = _mm_or_si128(rowNonZero, v);
+    }
+
+    if (!_mm_testz_si128(rowNonZero,rowNonZero)) {
+      nRows = j+1;
+    }
+  }
+
+  if (nRows==0) {
+    return;
+  }
+
+  ALIGNED_16(int16_t) colFlags[nT];
+  for (int c=0;c<nT;c+=vecW) {
+    STORE_16(colFlags+c, colNonZero[c/vecW]);
+  }
+
+  int nCols = nT;
+  while (colFlags[nCols-1]==0) {
+    nCols--;
+  }
+
+
+  // first pass (columns), result stored transposed in tmp[x*nT+y]
+
+  ALIGNED_16(int16_t) tmp[nT*nT];
+
+  const __m128i rnd1 = _mm_set1_epi32(1<<(7-1));
+
+  for (int c=0;c<nCols;c+=vecW) {
+    __m128i s[nT], lo[nT], hi[nT];
+
+    for (int j=0;j<nT;j++) {
+      s[j] = (j<nRows ? LOAD_16(coeffs + j*nT + c) : zero);
+    }
+
+    idct_columns_16<nT>(s,1,nRows, lo,hi);
+
+    for (int y=0;y<nT;y+=vecW) {
+      __m128i r[8];
+      for (int i=0;i<vecW;i++) {
+        r[i] = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(lo[y+i],rnd1), 7),
+                               _mm_srai_epi32(_mm_add_epi32(hi[y+i],rnd1), 7));
+      }
+
+      if (vecW==8) { transpose_8x8_epi16(r); }
+      else         { transpose_4x4_epi16(r); }
+
+      for (int i=0;i<vecW;i++) {
+        STORE_16(tmp + (c+i)*nT + y, r[i]);
+      }
+    }
+  }
+
+
+  // second pass (rows), add to the prediction
+
+  const int postShift = 20-bit_depth;
+  const __m128i rnd2  = _mm_set1_epi32(1<<(postShift-1));
+  const __m128i shift = _mm_cvtsi32_si128(postShift);
+  const __m128i maxval = _mm_set1_epi16((1<<bit_depth)-1);
+
+  for (int y=0;y<nT;y+=vecW) {
+    __m128i s[nT], lo[nT], hi[nT];
+
+    for (int j=0;j<nT;j++) {
+      s[j] = (j<nCols ? LOAD_16(tmp + j*nT + y) : zero);
+    }
+
+    idct_columns_16<nT>(s,1,nCols, lo,hi);
+
+    for (int x=0;x<nT;x+=vecW) {
+      __m128i r[8];
+      for (int i=0;i<vecW;i++) {
+        r[i] = _mm_packs_epi32(_mm_sra_epi32(_mm_add_epi32(lo[x+i],rnd2), shift),
+                               _mm_sra_epi32(_mm_add_epi32(hi[x+i],rnd2), shift));
+      }
+
+      if (vecW==8) { transpose_8x8_epi16(r); }
+      else         { transpose_4x4_epi16(r); }
+
+      /* The residual was saturated to 16 bit and the addition saturates as well. Both only
+         happen when the result is clipped to 0 or 'maxval' anyway. */
+
+      for (int i=0;i<vecW;i++) {
+        uint16_t* d = dst + (y+i)*stride + x;
+        __m128i v = _mm_adds_epi16(LOAD_16(d), r[i]);
+        v = _mm_min_epi16(_mm_max_epi16(v,zero), maxval);
+        STORE_16(d, v);
+      }
+    }
+  }
+
+#undef LOAD_16
+#undef STORE_16
+}
+
+
+void transform_4x4_add_16_sse4(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_dct_add_16<4>(dst,stride, coeffs, bit_depth);
+}
+
+void transform_8x8_add_16_sse4(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_dct_add_16<8>(dst,stride, coeffs, bit_depth);
+}
+
+void transform_16x16_add_16_sse4(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_dct_add_16<16>(dst,stride, coeffs, bit_depth);
+}
+
+void transform_32x32_add_16_sse4(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_dct_add_16<32>(dst,stride, coeffs, bit_depth);
+}
+#endif
+
+
+#if HAVE_SSE4_1
+/* Scale 8 coefficients by 8 factors (all products fit into 32 bit) and
+   round, shift and saturate them back to 16 bit. */
+static inline __m128i dequant_8(__m128i c, __m128i f, int shift)
+{
+  __m128i lo = _mm_mullo_epi16(c, f);
+  __m128i hi = _mm_mulhi_epi16(c, f);
+
+  __m128i p0 = _mm_unpacklo_epi16(lo, hi);
+  __m128i p1 = _mm_unpackhi_epi16(lo, hi);
+
+  if (shift>0) {
+    __m128i rnd   = _mm_set1_epi32(1<<(shift-1));
+    __m128i count = _mm_cvtsi32_si128(shift);
+
+    p0 = _mm_sra_epi32(_mm_add_epi32(p0, rnd), count);
+    p1 = _mm_sra_epi32(_mm_add_epi32(p1, rnd), count);
+
+    return _mm_packs_epi32(p0, p1);
+  }
+  else {
+    __m128i count = _mm_cvtsi32_si128(-shift);
+
+    // saturate before shifting, such that the shift cannot overflow
+
+    __m128i s = _mm_packs_epi32(p0, p1);
+
+    p0 = _mm_sll_epi32(_mm_cvtepi16_epi32(s), count);
+    p1 = _mm_sll_epi32(_mm_cvtepi16_epi32(_mm_srli_si128(s, 8)), count);
+
+    return _mm_packs_epi32(p0, p1);
+  }
+}
+
+
+void dequant_flat_sse4(int16_t *coeffs, int n, int fact, int shift)
+{
+  __m128i f = _mm_set1_epi16(fact);
+
+  for (int i=0;i<n;i+=8) {
+    __m128i c = _mm_load_si128((__m128i*)(coeffs+i));
+    _mm_store_si128((__m128i*)(coeffs+i), dequant_8(c, f, shift));
+  }
+}
+
+
+void dequant_scaled_sse4(int16_t *coeffs, const uint8_t *m, int n, int fact, int shift)
+{
+  __m128i f = _mm_set1_epi16(fact);
+
+  for (int i=0;i<n;i+=8) {
+    __m128i mi = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(m+i)));
+    __m128i c  = _mm_load_si128((__m128i*)(coeffs+i));
+
+    _mm_store_si128((__m128i*)(coeffs+i), dequant_8(c, _mm_mullo_epi16(mi, f), shift));
+  }
+}
+#endif
@@ -32,4 +32,12 @@ void ff_hevc_transform_8x8_add_8_sse4(uint8_t *dst, int16_t *coeffs, ptrdiff_t s
 void ff_hevc_transform_16x16_add_8_sse4(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride);
 void ff_hevc_transform_32x32_add_8_sse4(uint8_t *dst, int16_t *coeffs, ptrdiff_t stride);
 
+void transform_4x4_add_16_sse4(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_8x8_add_16_sse4(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_16x16_add_16_sse4(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_32x32_add_16_sse4(uint16_t *dst, int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+
+void dequant_flat_sse4(int16_t *coeffs, int n, int fact, int shift);
+void dequant_scaled_sse4(int16_t *coeffs, const uint8_t *m, int n, int fact, int shift);
+
 #endif
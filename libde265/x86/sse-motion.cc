@@ -26,8 +26,11 @@
 #include <smmintrin.h>
 #endif
 
+#include <assert.h>
+
 #include "sse-motion.h"
 #include "libde265/util.h"
+#include "libde265/fallback-motion.h"
 
 
 ALIGNED_16(const int8_t) epel_filters[7][16] = {
@@ -4954,3 +4957,464 @@ void ff_hevc_put_hevc_qpel_h_3_v_3_sse(int16_t *dst, ptrdiff_t dststride,
         dst += dststride;
     }
 }
+
+
+// --- high bit-depth (16 bit samples) ---
+
+/* The filters multiply pairs of samples with _mm_madd_epi16() and sum in 32 bit. Columns
+   beyond the last multiple of 4 are left to the fallback functions. The results are
+   identical to those of fallback-motion.cc, including the truncation of intermediate
+   values to 16 bit.
+ */
+
+static const int16_t qpel_filter_16[4][8] = {
+  {  0 },
+  { -1, 4,-10, 58, 17, -5, 1 },
+  { -1, 4,-11, 40, 40,-11, 4,-1 },
+  {  1,-5, 17, 58,-10,  4,-1 }
+};
+
+static const int16_t epel_filter_16[8][4] = {
+  {  0 },
+  { -2, 58, 10, -2 },
+  { -4, 54, 16, -2 },
+  { -6, 46, 28, -4 },
+  { -4, 36, 36, -4 },
+  { -4, 28, 46, -6 },
+  { -2, 16, 54, -4 },
+  { -2, 10, 58, -2 }
+};
+
+typedef void (*qpel_16_func)(int16_t *out, ptrdiff_t out_stride,
+                             uint16_t *src, ptrdiff_t srcstride,
+                             int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+
+static const qpel_16_func qpel_16_fallback[4][4] = {
+  { put_qpel_0_0_16_fallback, put_qpel_0_1_16_fallback, put_qpel_0_2_16_fallback, put_qpel_0_3_16_fallback },
+  { put_qpel_1_0_16_fallback, put_qpel_1_1_16_fallback, put_qpel_1_2_16_fallback, put_qpel_1_3_16_fallback },
+  { put_qpel_2_0_16_fallback, put_qpel_2_1_16_fallback, put_qpel_2_2_16_fallback, put_qpel_2_3_16_fallback },
+  { put_qpel_3_0_16_fallback, put_qpel_3_1_16_fallback, put_qpel_3_2_16_fallback, put_qpel_3_3_16_fallback }
+};
+
+
+// (w1,w2) in each 32 bit lane, the multipliers of _mm_madd_epi16()
+
+static inline __m128i weight_pair(int w1, int w2)
+{
+  return _mm_set1_epi32((uint16_t)w1 | ((uint32_t)(uint16_t)w2 << 16));
+}
+
+
+// filter taps as (c[2i], c[2i+1]) pairs, zero-padded to an even number
+
+static inline void filter_tap_pairs(__m128i* pairs, const int16_t* taps, int nTaps)
+{
+  for (int i=0;2*i<nTaps;i++) {
+    pairs[i] = weight_pair(taps[2*i], (2*i+1<nTaps) ? taps[2*i+1] : 0);
+  }
+}
+
+
+// 32 -> 16 bit, keeping the lower 16 bits like an int16_t assignment
+
+static inline __m128i pack_truncate_epi32(__m128i lo, __m128i hi)
+{
+  lo = _mm_srai_epi32(_mm_slli_epi32(lo,16),16);
+  hi = _mm_srai_epi32(_mm_slli_epi32(hi,16),16);
+  return _mm_packs_epi32(lo,hi);
+}
+
+
+/* Filters 8 (or in the lower half 4) consecutive outputs. Tap i of output x is read from
+   p[x+i*step]. An odd last tap is paired with zero, so that no sample beyond it is read.
+ */
+template <int nTaps, bool half>
+static inline void filter_taps_16(const int16_t* p, ptrdiff_t step, const __m128i* pairs,
+                                  __m128i* lo, __m128i* hi)
+{
+  const __m128i zero = _mm_setzero_si128();
+
+  __m128i sumLo = zero;
+  __m128i sumHi = zero;
+
+  for (int i=0;2*i<nTaps;i++) {
+    __m128i a = (half ? _mm_loadl_epi64((const __m128i*)(p+2*i*step)) :
+                        _mm_loadu_si128((const __m128i*)(p+2*i*step)));
+    __m128i b = zero;
+    if (2*i+1<nTaps) {
+      b = (half ? _mm_loadl_epi64((const __m128i*)(p+(2*i+1)*step)) :
+                  _mm_loadu_si128((const __m128i*)(p+(2*i+1)*step)));
+    }
+
+    sumLo = _mm_add_epi32(sumLo, _mm_madd_epi16(_mm_unpacklo_epi16(a,b), pairs[i]));
+    if (!half) {
+      sumHi = _mm_add_epi32(sumHi, _mm_madd_epi16(_mm_unpackhi_epi16(a,b), pairs[i]));
+    }
+  }
+
+  *lo = sumLo;
+  *hi = sumHi;
+}
+
+
+/* Horizontal filter of 16 bit samples, (sum >> shift). 'src' points to the first tap of the
+   first output sample. Returns the number of columns processed (width rounded down to 4).
+ */
+template <int nTaps>
+static int filter_h_16(int16_t* dst, ptrdiff_t dststride,
+                       const uint16_t* src, ptrdiff_t srcstride,
+                       int width, int height, const __m128i* pairs, int shift)
+{
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  const int w4 = width & ~3;
+
+  for (int y=0;y<height;y++) {
+    const int16_t* p = (const int16_t*)(src + y*srcstride);
+    int16_t* o = dst + y*dststride;
+    __m128i lo,hi;
+
+    int x=0;
+    for (;x+8<=w4;x+=8) {
+      filter_taps_16<nTaps,false>(p+x, 1, pairs, &lo,&hi);
+      _mm_storeu_si128((__m128i*)(o+x),
+                       _mm_packs_epi32(_mm_sra_epi32(lo,sh), _mm_sra_epi32(hi,sh)));
+    }
+
+    if (x<w4) {
+      filter_taps_16<nTaps,true>(p+x, 1, pairs, &lo,&hi);
+      _mm_storel_epi64((__m128i*)(o+x), _mm_packs_epi32(_mm_sra_epi32(lo,sh), lo));
+    }
+  }
+
+  return w4;
+}
+
+
+/* Vertical filter of 16 bit values, (sum >> shift). 'src' points to the first tap of the
+   first output sample. Returns the number of columns processed (width rounded down to 4).
+ */
+template <int nTaps>
+static int filter_v_16(int16_t* dst, ptrdiff_t dststride,
+                       const int16_t* src, ptrdiff_t srcstride,
+                       int width, int height, const __m128i* pairs, int shift)
+{
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  const int w4 = width & ~3;
+
+  for (int y=0;y<height;y++) {
+    const int16_t* p = src + y*srcstride;
+    int16_t* o = dst + y*dststride;
+    __m128i lo,hi;
+
+    int x=0;
+    for (;x+8<=w4;x+=8) {
+      filter_taps_16<nTaps,false>(p+x, srcstride, pairs, &lo,&hi);
+      _mm_storeu_si128((__m128i*)(o+x),
+                       pack_truncate_epi32(_mm_sra_epi32(lo,sh), _mm_sra_epi32(hi,sh)));
+    }
+
+    if (x<w4) {
+      filter_taps_16<nTaps,true>(p+x, srcstride, pairs, &lo,&hi);
+      _mm_storel_epi64((__m128i*)(o+x), pack_truncate_epi32(_mm_sra_epi32(lo,sh), lo));
+    }
+  }
+
+  return w4;
+}
+
+
+// sample << shift, returns the number of columns processed
+
+static int copy_shift_16(int16_t* dst, ptrdiff_t dststride,
+                         const uint16_t* src, ptrdiff_t srcstride,
+                         int width, int height, int shift)
+{
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  const int w4 = width & ~3;
+
+  for (int y=0;y<height;y++) {
+    const uint16_t* p = src + y*srcstride;
+    int16_t* o = dst + y*dststride;
+
+    int x=0;
+    for (;x+8<=w4;x+=8) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(p+x));
+      _mm_storeu_si128((__m128i*)(o+x), _mm_sll_epi16(v,sh));
+    }
+
+    if (x<w4) {
+      __m128i v = _mm_loadl_epi64((const __m128i*)(p+x));
+      _mm_storel_epi64((__m128i*)(o+x), _mm_sll_epi16(v,sh));
+    }
+  }
+
+  return w4;
+}
+
+
+static void put_qpel_16(int16_t *out, ptrdiff_t out_stride,
+                        uint16_t *src, ptrdiff_t srcstride,
+                        int nPbW, int nPbH, int16_t* mcbuffer,
+                        int xFrac, int yFrac, int bit_depth)
+{
+  const int shift1 = bit_depth-8;
+  const int shift2 = 6;
+
+  __m128i hpairs[4], vpairs[4];
+  filter_tap_pairs(hpairs, qpel_filter_16[xFrac], 8);
+  filter_tap_pairs(vpairs, qpel_filter_16[yFrac], 8);
+
+  const uint16_t* p = src - qpel_extra_before[xFrac] - qpel_extra_before[yFrac]*srcstride;
+  int done;
+
+  if (yFrac==0) {
+    done = (xFrac==2 ?
+            filter_h_16<8>(out,out_stride, p,srcstride, nPbW,nPbH, hpairs, shift1) :
+            filter_h_16<7>(out,out_stride, p,srcstride, nPbW,nPbH, hpairs, shift1));
+  }
+  else if (xFrac==0) {
+    done = (yFrac==2 ?
+            filter_v_16<8>(out,out_stride, (const int16_t*)p,srcstride, nPbW,nPbH, vpairs, shift1) :
+            filter_v_16<7>(out,out_stride, (const int16_t*)p,srcstride, nPbW,nPbH, vpairs, shift1));
+  }
+  else {
+    // horizontal filter into 'mcbuffer' (row-major), including the rows of the vertical taps
+
+    const int nRows = nPbH + qpel_extra[yFrac];
+    const int w4 = nPbW & ~3;
+
+    if (xFrac==2) { filter_h_16<8>(mcbuffer,w4, p,srcstride, w4,nRows, hpairs, shift1); }
+    else          { filter_h_16<7>(mcbuffer,w4, p,srcstride, w4,nRows, hpairs, shift1); }
+
+    done = (yFrac==2 ?
+            filter_v_16<8>(out,out_stride, mcbuffer,w4, w4,nPbH, vpairs, shift2) :
+            filter_v_16<7>(out,out_stride, mcbuffer,w4, w4,nPbH, vpairs, shift2));
+  }
+
+  if (done<nPbW) {
+    qpel_16_fallback[xFrac][yFrac](out+done,out_stride, src+done,srcstride,
+                                   nPbW-done,nPbH, mcbuffer, bit_depth);
+  }
+}
+
+
+void put_qpel_0_0_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth)
+{
+  int done = copy_shift_16(out,out_stride, src,srcstride, nPbW,nPbH, 14-bit_depth);
+
+  if (done<nPbW) {
+    put_qpel_0_0_16_fallback(out+done,out_stride, src+done,srcstride,
+                             nPbW-done,nPbH, mcbuffer, bit_depth);
+  }
+}
+
+
+#define QPEL16_SSE4(x,y) void put_qpel_ ## x ## _ ## y ## _16_sse4(int16_t *out, ptrdiff_t out_stride, \
+                                             uint16_t *src, ptrdiff_t srcstride,    \
+                                             int nPbW, int nPbH, int16_t* mcbuffer, \
+                                             int bit_depth)                         \
+{ put_qpel_16(out,out_stride, src,srcstride, nPbW,nPbH,mcbuffer,x,y, bit_depth); }
+
+/*            */ QPEL16_SSE4(0,1) QPEL16_SSE4(0,2) QPEL16_SSE4(0,3)
+QPEL16_SSE4(1,0) QPEL16_SSE4(1,1) QPEL16_SSE4(1,2) QPEL16_SSE4(1,3)
+QPEL16_SSE4(2,0) QPEL16_SSE4(2,1) QPEL16_SSE4(2,2) QPEL16_SSE4(2,3)
+QPEL16_SSE4(3,0) QPEL16_SSE4(3,1) QPEL16_SSE4(3,2) QPEL16_SSE4(3,3)
+
+
+void put_epel_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                      uint16_t *src, ptrdiff_t srcstride,
+                      int width, int height,
+                      int mx, int my, int16_t* mcbuffer, int bit_depth)
+{
+  int done = copy_shift_16(out,out_stride, src,srcstride, width,height, 14-bit_depth);
+
+  if (done<width) {
+    put_epel_16_fallback(out+done,out_stride, src+done,srcstride,
+                         width-done,height, mx,my, mcbuffer, bit_depth);
+  }
+}
+
+
+// used for the h, v and hv cases, like put_epel_hv_16_fallback()
+
+void put_epel_hv_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                         uint16_t *src, ptrdiff_t srcstride,
+                         int width, int height,
+                         int mx, int my, int16_t* mcbuffer, int bit_depth)
+{
+  const int shift1 = bit_depth-8;
+  const int shift2 = 6;
+
+  __m128i hpairs[2], vpairs[2];
+  filter_tap_pairs(hpairs, epel_filter_16[mx], 4);
+  filter_tap_pairs(vpairs, epel_filter_16[my], 4);
+
+  int done;
+
+  if (my==0) {
+    done = filter_h_16<4>(out,out_stride, src-epel_extra_before,srcstride,
+                          width,height, hpairs, shift1);
+  }
+  else if (mx==0) {
+    done = filter_v_16<4>(out,out_stride,
+                          (const int16_t*)(src-epel_extra_before*srcstride),srcstride,
+                          width,height, vpairs, shift1);
+  }
+  else {
+    const int nRows = height + epel_extra;
+    const int w4 = width & ~3;
+
+    filter_h_16<4>(mcbuffer,w4, src-epel_extra_before*(srcstride+1),srcstride,
+                   w4,nRows, hpairs, shift1);
+    done = filter_v_16<4>(out,out_stride, mcbuffer,w4, w4,height, vpairs, shift2);
+  }
+
+  if (done<width) {
+    put_epel_hv_16_fallback(out+done,out_stride, src+done,srcstride,
+                            width-done,height, mx,my, mcbuffer, bit_depth);
+  }
+}
+
+
+void put_unweighted_pred_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                                 int16_t *src, ptrdiff_t srcstride,
+                                 int width, int height, int bit_depth)
+{
+  const int shift1 = 14-bit_depth;
+  const __m128i sh = _mm_cvtsi32_si128(shift1);
+  const __m128i offset = _mm_set1_epi16(1<<(shift1-1));
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i maxval = _mm_set1_epi16((1<<bit_depth)-1);
+  const int w4 = width & ~3;
+
+  // The additions saturate. This only happens when the result is clipped to 'maxval' anyway.
+
+  for (int y=0;y<height;y++) {
+    const int16_t* in = src + y*srcstride;
+    uint16_t* out = dst + y*dststride;
+
+    int x=0;
+    for (;x+8<=w4;x+=8) {
+      __m128i v = _mm_sra_epi16(_mm_adds_epi16(_mm_loadu_si128((const __m128i*)(in+x)), offset), sh);
+      v = _mm_min_epi16(_mm_max_epi16(v,zero), maxval);
+      _mm_storeu_si128((__m128i*)(out+x), v);
+    }
+
+    if (x<w4) {
+      __m128i v = _mm_sra_epi16(_mm_adds_epi16(_mm_loadl_epi64((const __m128i*)(in+x)), offset), sh);
+      v = _mm_min_epi16(_mm_max_epi16(v,zero), maxval);
+      _mm_storel_epi64((__m128i*)(out+x), v);
+    }
+  }
+
+  if (w4<width) {
+    put_unweighted_pred_16_fallback(dst+w4,dststride, src+w4,srcstride,
+                                    width-w4,height, bit_depth);
+  }
+}
+
+
+/* Weighted sums of two sources, or of one source and a constant 1 if 'src2' is NULL.
+   'pairs' holds the weights, the 32 bit sums are (sum + offset) >> shift, packed with
+   saturation and clipped to [0;maxval]. Returns the number of columns processed.
+ */
+template <bool bipred>
+static int weighted_sum_16(uint16_t *dst, ptrdiff_t dststride,
+                           const int16_t *src1, const int16_t *src2, ptrdiff_t srcstride,
+                           int width, int height,
+                           __m128i pairs, int offset, int shift, int bit_depth)
+{
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  const __m128i ofs = _mm_set1_epi32(offset);
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i maxval = _mm_set1_epi16((1<<bit_depth)-1);
+  const int w4 = width & ~3;
+
+  for (int y=0;y<height;y++) {
+    const int16_t* in1 = src1 + y*srcstride;
+    const int16_t* in2 = (bipred ? src2 + y*srcstride : NULL);
+    uint16_t* out = dst + y*dststride;
+
+    int x=0;
+    for (;x+8<=w4;x+=8) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(in1+x));
+      __m128i b = (bipred ? _mm_loadu_si128((const __m128i*)(in2+x)) : one);
+      __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a,b), pairs), ofs);
+      __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a,b), pairs), ofs);
+      __m128i v = _mm_packs_epi32(_mm_sra_epi32(lo,sh), _mm_sra_epi32(hi,sh));
+      v = _mm_min_epi16(_mm_max_epi16(v,zero), maxval);
+      _mm_storeu_si128((__m128i*)(out+x), v);
+    }
+
+    if (x<w4) {
+      __m128i a = _mm_loadl_epi64((const __m128i*)(in1+x));
+      __m128i b = (bipred ? _mm_loadl_epi64((const __m128i*)(in2+x)) : one);
+      __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a,b), pairs), ofs);
+      __m128i v = _mm_packs_epi32(_mm_sra_epi32(lo,sh), lo);
+      v = _mm_min_epi16(_mm_max_epi16(v,zero), maxval);
+      _mm_storel_epi64((__m128i*)(out+x), v);
+    }
+  }
+
+  return w4;
+}
+
+
+void put_weighted_pred_avg_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                                   int16_t *src1, int16_t *src2, ptrdiff_t srcstride,
+                                   int width, int height, int bit_depth)
+{
+  const int shift2 = 15-bit_depth;
+
+  int done = weighted_sum_16<true>(dst,dststride, src1,src2,srcstride, width,height,
+                                   _mm_set1_epi16(1), 1<<(shift2-1), shift2, bit_depth);
+
+  if (done<width) {
+    put_weighted_pred_avg_16_fallback(dst+done,dststride, src1+done,src2+done,srcstride,
+                                      width-done,height, bit_depth);
+  }
+}
+
+
+
+void put_weighted_pred_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                               int16_t *src, ptrdiff_t srcstride,
+                               int width, int height,
+                               int w,int o,int log2WD, int bit_depth)
+{
+  assert(log2WD>=1);
+
+  // ((in*w + rnd) >> log2WD) + o  ==  (in*w + 1*rnd + o*2^log2WD) >> log2WD
+
+  const int rnd = (1<<(log2WD-1));
+
+  int done = weighted_sum_16<false>(dst,dststride, src,NULL,srcstride, width,height,
+                                    weight_pair(w,rnd), o*(1<<log2WD), log2WD, bit_depth);
+
+  if (done<width) {
+    put_weighted_pred_16_fallback(dst+done,dststride, src+done,srcstride,
+                                  width-done,height, w,o,log2WD, bit_depth);
+  }
+}
+
+
+void put_weighted_bipred_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                                 int16_t *src1, int16_t *src2, ptrdiff_t srcstride,
+                                 int width, int height,
+                                 int w1,int o1, int w2,int o2, int log2WD, int bit_depth)
+{
+  assert(log2WD>=1);
+
+  const int rnd = ((o1+o2+1) * (1<<log2WD));
+
+  int done = weighted_sum_16<true>(dst,dststride, src1,src2,srcstride, width,height,
+                                   weight_pair(w1,w2), rnd, log2WD+1, bit_depth);
+
+  if (done<width) {
+    put_weighted_bipred_16_fallback(dst+done,dststride, src1+done,src2+done,srcstride,
+                                    width-done,height, w1,o1,w2,o2,log2WD, bit_depth);
+  }
+}
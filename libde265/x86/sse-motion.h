@@ -101,4 +101,80 @@ void ff_hevc_put_hevc_qpel_h_3_v_3_sse(int16_t *dst, ptrdiff_t dststride,
                                          uint8_t *src, ptrdiff_t srcstride,
                                          int width, int height, int16_t* mcbuffer);
 
+
+// high bit-depth (16 bit samples)
+
+void put_unweighted_pred_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                                 int16_t *src, ptrdiff_t srcstride,
+                                 int width, int height, int bit_depth);
+void put_weighted_pred_avg_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                                   int16_t *src1, int16_t *src2, ptrdiff_t srcstride,
+                                   int width, int height, int bit_depth);
+void put_weighted_pred_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                               int16_t *src, ptrdiff_t srcstride,
+                               int width, int height,
+                               int w,int o,int log2WD, int bit_depth);
+void put_weighted_bipred_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                                 int16_t *src1, int16_t *src2, ptrdiff_t srcstride,
+                                 int width, int height,
+                                 int w1,int o1, int w2,int o2, int log2WD, int bit_depth);
+
+void put_epel_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                      uint16_t *src, ptrdiff_t srcstride,
+                      int width, int height,
+                      int mx, int my, int16_t* mcbuffer, int bit_depth);
+void put_epel_hv_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                         uint16_t *src, ptrdiff_t srcstride,
+                         int width, int height,
+                         int mx, int my, int16_t* mcbuffer, int bit_depth);
+
+void put_qpel_0_0_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_0_1_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_0_2_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_0_3_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_1_0_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_1_1_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_1_2_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_1_3_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_2_0_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_2_1_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_2_2_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_2_3_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_3_0_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_3_1_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_3_2_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+void put_qpel_3_3_16_sse4(int16_t *out, ptrdiff_t out_stride,
+                          uint16_t *src, ptrdiff_t srcstride,
+                          int nPbW, int nPbH, int16_t* mcbuffer, int bit_depth);
+
 #endif
@@ -25,6 +25,7 @@
 #include "x86/sse.h"
 #include "x86/sse-motion.h"
 #include "x86/sse-dct.h"
+#include "x86/sse-convert.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -89,6 +90,33 @@ void init_acceleration_functions_sse(struct acceleration_functions* accel)
     accel->put_hevc_qpel_8[3][2] = ff_hevc_put_hevc_qpel_h_3_v_2_sse;
     accel->put_hevc_qpel_8[3][3] = ff_hevc_put_hevc_qpel_h_3_v_3_sse;
 
+    accel->put_unweighted_pred_16   = put_unweighted_pred_16_sse4;
+    accel->put_weighted_pred_avg_16 = put_weighted_pred_avg_16_sse4;
+    accel->put_weighted_pred_16     = put_weighted_pred_16_sse4;
+    accel->put_weighted_bipred_16   = put_weighted_bipred_16_sse4;
+
+    accel->put_hevc_epel_16    = put_epel_16_sse4;
+    accel->put_hevc_epel_h_16  = put_epel_hv_16_sse4;
+    accel->put_hevc_epel_v_16  = put_epel_hv_16_sse4;
+    accel->put_hevc_epel_hv_16 = put_epel_hv_16_sse4;
+
+    accel->put_hevc_qpel_16[0][0] = put_qpel_0_0_16_sse4;
+    accel->put_hevc_qpel_16[0][1] = put_qpel_0_1_16_sse4;
+    accel->put_hevc_qpel_16[0][2] = put_qpel_0_2_16_sse4;
+    accel->put_hevc_qpel_16[0][3] = put_qpel_0_3_16_sse4;
+    accel->put_hevc_qpel_16[1][0] = put_qpel_1_0_16_sse4;
+    accel->put_hevc_qpel_16[1][1] = put_qpel_1_1_16_sse4;
+    accel->put_hevc_qpel_16[1][2] = put_qpel_1_2_16_sse4;
+    accel->put_hevc_qpel_16[1][3] = put_qpel_1_3_16_sse4;
+    accel->put_hevc_qpel_16[2][0] = put_qpel_2_0_16_sse4;
+    accel->put_hevc_qpel_16[2][1] = put_qpel_2_1_16_sse4;
+    accel->put_hevc_qpel_16[2][2] = put_qpel_2_2_16_sse4;
+    accel->put_hevc_qpel_16[2][3] = put_qpel_2_3_16_sse4;
+    accel->put_hevc_qpel_16[3][0] = put_qpel_3_0_16_sse4;
+    accel->put_hevc_qpel_16[3][1] = put_qpel_3_1_16_sse4;
+    accel->put_hevc_qpel_16[3][2] = put_qpel_3_2_16_sse4;
+    accel->put_hevc_qpel_16[3][3] = put_qpel_3_3_16_sse4;
+
     accel->transform_skip_8 = ff_hevc_transform_skip_8_sse;
 
     // actually, for these two functions, the scalar fallback seems to be faster than the SSE code
@@ -98,6 +126,17 @@ void init_acceleration_functions_sse(struct acceleration_functions* accel)
     accel->transform_8x8_add_8   = ff_hevc_transform_8x8_add_8_sse4;
     accel->transform_16x16_add_8 = ff_hevc_transform_16x16_add_8_sse4;
     accel->transform_32x32_add_8 = ff_hevc_transform_32x32_add_8_sse4;
+
+    accel->transform_4x4_add_16   = transform_4x4_add_16_sse4;
+    accel->transform_8x8_add_16   = transform_8x8_add_16_sse4;
+    accel->transform_16x16_add_16 = transform_16x16_add_16_sse4;
+    accel->transform_32x32_add_16 = transform_32x32_add_16_sse4;
+
+    accel->dequant_flat   = dequant_flat_sse4;
+    accel->dequant_scaled = dequant_scaled_sse4;
+
+    accel->interleave_chroma_8 = interleave_chroma_8_sse4;
+    accel->yuv420_to_rgb_8     = yuv420_to_rgb_8_sse4;
   }
 #endif
 }